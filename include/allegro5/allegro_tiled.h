@@ -29,14 +29,47 @@ enum LayerType {
 	OBJECT_LAYER
 };
 
+// flags for al_set_new_map_flags()
+enum {
+	ALLEGRO_MAP_DOM_PARSER    = 1 << 0,  // load the whole XML tree instead of streaming it
+	ALLEGRO_MAP_LAZY_TILES    = 1 << 1,  // create tiles and their bitmaps on first use
+	ALLEGRO_MAP_ATLAS         = 1 << 2,  // pack all tileset images into shared atlas bitmaps
+	ALLEGRO_MAP_RENDER_CACHE  = 1 << 3,  // draw tile layers from pre-rendered chunk bitmaps
+	ALLEGRO_MAP_VERTEX_ARRAYS = 1 << 4   // draw tile layers with one al_draw_prim call per texture
+};
+
 typedef struct _ALLEGRO_MAP                ALLEGRO_MAP;
 typedef struct _ALLEGRO_MAP_LAYER          ALLEGRO_MAP_LAYER;
 typedef struct _ALLEGRO_MAP_TILESET        ALLEGRO_MAP_TILESET;
 typedef struct _ALLEGRO_MAP_TILE           ALLEGRO_MAP_TILE;
 typedef struct _ALLEGRO_MAP_OBJECT_GROUP   ALLEGRO_MAP_OBJECT_GROUP;
 typedef struct _ALLEGRO_MAP_OBJECT         ALLEGRO_MAP_OBJECT;
+typedef struct _ALLEGRO_MAP_PROPERTY_KEY   ALLEGRO_MAP_PROPERTY_KEY;
+typedef struct _ALLEGRO_MAP_TILE_QUERY     ALLEGRO_MAP_TILE_QUERY;
+typedef struct _ALLEGRO_MAP_SCROLL_SURFACE ALLEGRO_MAP_SCROLL_SURFACE;
 
 ALLEGRO_MAP *al_open_map(const char *dir, const char *filename);
+void al_set_new_map_flags(int flags);
+int al_get_new_map_flags(void);
+void al_set_new_map_decode_threads(int threads);
+int al_get_new_map_decode_threads(void);
+void al_set_new_map_render_chunk_size(int size);
+int al_get_new_map_render_chunk_size(void);
+
+// compiled maps
+bool al_compile_map(ALLEGRO_MAP *map, const char *filename);
+ALLEGRO_MAP *al_open_compiled_map(const char *dir, const char *filename, const char *cache);
+
+// tileset image cache
+bool al_pin_tileset_image(const char *filename);
+void al_unpin_tileset_image(const char *filename);
+
+// infinite maps
+void al_stream_map_chunks(ALLEGRO_MAP *map, float sx, float sy, float sw, float sh);
+int al_get_map_resident_chunks(ALLEGRO_MAP *map);
+
+// animated tiles
+void al_update_map(ALLEGRO_MAP *map, double seconds);
 
 // drawing methods
 void al_draw_tinted_map(ALLEGRO_MAP *map, ALLEGRO_COLOR tint, float dx, float dy, int flags);
@@ -46,17 +79,56 @@ void al_draw_map_region(ALLEGRO_MAP *map, float sx, float sy, float sw, float sh
 void al_draw_layer_for_name(ALLEGRO_MAP *map, char *name, float dx, float dy, int flags);
 void al_draw_tinted_layer_region_for_name(ALLEGRO_MAP *map, char *name, ALLEGRO_COLOR tint, float sx, float sy, float sw, float sh, float dx, float dy, int flags);
 void al_draw_layer_region_for_name(ALLEGRO_MAP *map, char *name, float sx, float sy, float sw, float sh, float dx, float dy, int flags);
+void al_clear_map_render_cache(ALLEGRO_MAP *map);
+
+// scroll surfaces, which redraw only what scrolls into view
+ALLEGRO_MAP_SCROLL_SURFACE *al_create_map_scroll_surface(ALLEGRO_MAP *map, int width, int height, int margin);
+void al_draw_tinted_map_scroll_surface(ALLEGRO_MAP_SCROLL_SURFACE *surface, ALLEGRO_COLOR tint, float sx, float sy, float dx, float dy);
+void al_draw_map_scroll_surface(ALLEGRO_MAP_SCROLL_SURFACE *surface, float sx, float sy, float dx, float dy);
+void al_destroy_map_scroll_surface(ALLEGRO_MAP_SCROLL_SURFACE *surface);
+
+// coordinates
+int al_map_get_pixel_width(ALLEGRO_MAP *map);
+int al_map_get_pixel_height(ALLEGRO_MAP *map);
+void al_map_tile_to_pixel(ALLEGRO_MAP *map, float tx, float ty, float *px, float *py);
+void al_map_pixel_to_tile(ALLEGRO_MAP *map, float px, float py, float *tx, float *ty);
+bool al_map_pixel_to_cell(ALLEGRO_MAP *map, float px, float py, int *tx, int *ty);
 
 // tile and object methods
 ALLEGRO_MAP_TILE *al_get_tile_for_id(ALLEGRO_MAP *map, int id);
 int al_get_single_tile_id(ALLEGRO_MAP_LAYER *layer, int x, int y);
+bool al_set_single_tile_id(ALLEGRO_MAP *map, ALLEGRO_MAP_LAYER *layer, int x, int y, int id);
 ALLEGRO_MAP_TILE *al_get_single_tile(ALLEGRO_MAP *map, ALLEGRO_MAP_LAYER *layer, int x, int y);
 ALLEGRO_MAP_TILE **al_get_tiles(ALLEGRO_MAP *map, int x, int y, int *length);
 ALLEGRO_MAP_OBJECT **al_get_objects(ALLEGRO_MAP_LAYER *layer, int *length);
 ALLEGRO_MAP_OBJECT **al_get_objects_for_name(ALLEGRO_MAP_LAYER *layer, char *name, int *length);
+int al_get_objects_in_rect(ALLEGRO_MAP_LAYER *layer, float x, float y, float width, float height, ALLEGRO_MAP_OBJECT **results, int max);
+void al_set_object_pos(ALLEGRO_MAP_OBJECT *object, int x, int y);
 char *al_get_tile_property(ALLEGRO_MAP_TILE *tile, char *name, char *def);
 char *al_get_object_property(ALLEGRO_MAP_OBJECT *object, char *name, char *def);
 
+// typed property methods
+int al_get_tile_property_int(ALLEGRO_MAP_TILE *tile, char *name, int def);
+float al_get_tile_property_float(ALLEGRO_MAP_TILE *tile, char *name, float def);
+bool al_get_tile_property_bool(ALLEGRO_MAP_TILE *tile, char *name, bool def);
+int al_get_object_property_int(ALLEGRO_MAP_OBJECT *object, char *name, int def);
+float al_get_object_property_float(ALLEGRO_MAP_OBJECT *object, char *name, float def);
+bool al_get_object_property_bool(ALLEGRO_MAP_OBJECT *object, char *name, bool def);
+
+// property key handles, which skip looking up the name
+ALLEGRO_MAP_PROPERTY_KEY *al_get_map_property_key(const char *name);
+char *al_get_tile_property_for_key(ALLEGRO_MAP_TILE *tile, ALLEGRO_MAP_PROPERTY_KEY *key, char *def);
+int al_get_tile_property_int_for_key(ALLEGRO_MAP_TILE *tile, ALLEGRO_MAP_PROPERTY_KEY *key, int def);
+float al_get_tile_property_float_for_key(ALLEGRO_MAP_TILE *tile, ALLEGRO_MAP_PROPERTY_KEY *key, float def);
+bool al_get_tile_property_bool_for_key(ALLEGRO_MAP_TILE *tile, ALLEGRO_MAP_PROPERTY_KEY *key, bool def);
+
+// compiled tile queries
+ALLEGRO_MAP_TILE_QUERY *al_create_tile_query(ALLEGRO_MAP *map, const char *name);
+bool al_index_tile_query(ALLEGRO_MAP_TILE_QUERY *query, ALLEGRO_MAP_LAYER *layer);
+bool al_query_tile_id(ALLEGRO_MAP_TILE_QUERY *query, int id);
+bool al_query_tile(ALLEGRO_MAP_TILE_QUERY *query, ALLEGRO_MAP_LAYER *layer, int x, int y);
+void al_destroy_tile_query(ALLEGRO_MAP_TILE_QUERY *query);
+
 // accessors
 int al_get_map_width(ALLEGRO_MAP *map);
 int al_get_map_height(ALLEGRO_MAP *map);
@@ -64,6 +136,8 @@ int al_get_map_height(ALLEGRO_MAP *map);
 int al_get_tile_width(ALLEGRO_MAP *map);
 int al_get_tile_height(ALLEGRO_MAP *map);
 char *al_get_map_orientation(ALLEGRO_MAP *map);
+bool al_get_map_infinite(ALLEGRO_MAP *map);
+int al_get_map_materialized_tiles(ALLEGRO_MAP *map);
 ALLEGRO_MAP_LAYER *al_get_map_layer(ALLEGRO_MAP *map, char *name);
 
 // destructors
@@ -0,0 +1,402 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ *
+ *                               ---
+ *
+ * Animated tiles.
+ *
+ * Tiled gives a tile an animation as a list of other tiles of its
+ * tileset to show, each for some milliseconds. al_update_map moves a
+ * map's clock on, and every animated tile whose next frame has come
+ * due is taken off the front of a queue ordered by that time, so a
+ * step only costs as much as the frames that actually change.
+ *
+ * Changing a tile's frame points its gid's entries in the draw bitmap
+ * and vertex tile tables at the frame, which is all that drawing a
+ * layer directly needs. Render caches and vertex arrays hold the old
+ * frame, so when either is in use the map also keeps, for each layer,
+ * the cells showing each animated tile, and only those cells are
+ * patched or have their chunks redrawn.
+ */
+
+#include "anim.h"
+#include "map.h"
+
+/*
+ * Gives a tile the animation frames read from its <animation> node.
+ */
+void set_tile_frames(ARENA *arena, ALLEGRO_MAP_TILE *tile, GArray *frames)
+{
+	if (!frames->len) {
+		return;
+	}
+
+	tile->frames = (ANIMATION_FRAME *)arena_alloc(arena, frames->len * sizeof(ANIMATION_FRAME));
+	memcpy(tile->frames, frames->data, frames->len * sizeof(ANIMATION_FRAME));
+	tile->frame_count = frames->len;
+}
+
+/*
+ * Gets the length of one pass through a tile's frames, or 0 if it
+ * can't be animated.
+ */
+static int get_animation_cycle(ALLEGRO_MAP *map, ALLEGRO_MAP_TILE *tile)
+{
+	int i, cycle = 0;
+	for (i = 0; i<tile->frame_count; i++) {
+		int gid = tile->tileset->firstgid + tile->frames[i].tile_id;
+		if (tile->frames[i].tile_id < 0 || gid >= map->tiles_length || tile->frames[i].duration < 0) {
+			fprintf(stderr, "Error: invalid animation frame for tile %d\n", tile->id);
+			return 0;
+		}
+		cycle += tile->frames[i].duration;
+	}
+
+	return cycle;
+}
+
+/*
+ * Moves the animated tile at position i of the queue back until no
+ * later tile is due before it.
+ */
+static void sift_animation(MAP_ANIMATIONS *animations, int i)
+{
+	int *queue = animations->queue;
+	for (;;) {
+		int first = i, left = i * 2 + 1, right = left + 1;
+		if (left < animations->count && animations->tiles[queue[left]].next_change < animations->tiles[queue[first]].next_change) {
+			first = left;
+		}
+		if (right < animations->count && animations->tiles[queue[right]].next_change < animations->tiles[queue[first]].next_change) {
+			first = right;
+		}
+		if (first == i) {
+			return;
+		}
+
+		int swap = queue[i];
+		queue[i] = queue[first];
+		queue[first] = swap;
+		i = first;
+	}
+}
+
+/*
+ * Finds the position of the first of the cells at or after cell i.
+ */
+static int find_animated_cell(const ANIMATED_CELLS *cells, int i)
+{
+	int lo = 0, hi = cells->count;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (cells->cells[mid] < i) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return lo;
+}
+
+/*
+ * Gets the cells of a layer showing an animated tile, optionally
+ * starting a list for the layer if it has none.
+ */
+static ANIMATED_CELLS *get_animated_cells(ANIMATED_TILE *anim, ALLEGRO_MAP_LAYER *layer, bool create)
+{
+	int i;
+	for (i = 0; i<anim->layer_count; i++) {
+		if (anim->layers[i].layer == layer) {
+			return &anim->layers[i];
+		}
+	}
+
+	if (!create) {
+		return NULL;
+	}
+
+	anim->layers = (ANIMATED_CELLS *)al_realloc(anim->layers, (anim->layer_count + 1) * sizeof(ANIMATED_CELLS));
+	ANIMATED_CELLS *cells = &anim->layers[anim->layer_count++];
+	cells->layer = layer;
+	cells->cells = NULL;
+	cells->count = cells->capacity = 0;
+	return cells;
+}
+
+/*
+ * Puts cell i in a list, at the given position.
+ */
+static void insert_animated_cell(ANIMATED_CELLS *cells, int at, int i)
+{
+	if (cells->count == cells->capacity) {
+		cells->capacity = MAX(cells->capacity * 2, 16);
+		cells->cells = (int *)al_realloc(cells->cells, cells->capacity * sizeof(int));
+	}
+
+	memmove(cells->cells + at + 1, cells->cells + at, (cells->count - at) * sizeof(int));
+	cells->cells[at] = i;
+	cells->count++;
+}
+
+/*
+ * Brings the caches of the cells showing an animated tile up to date
+ * with its frame: the render cache chunks they reach are redrawn, and
+ * those in the rows covered by the vertex arrays are patched.
+ */
+static void refresh_animated_cells(ALLEGRO_MAP *map, ANIMATED_CELLS *cells)
+{
+	ALLEGRO_MAP_LAYER *layer = cells->layer;
+	int i;
+
+	if (layer->render_cache || map->scroll_surfaces) {
+		for (i = 0; i<cells->count; i++) {
+			int x = cells->cells[i] % layer->width, y = cells->cells[i] / layer->width;
+			invalidate_render_cache(layer, x, y);
+			invalidate_scroll_surfaces(map, x, y);
+		}
+	}
+
+	VERTEX_CACHE *cache = layer->vertices;
+	if (cache && !cache->dirty) {
+		int end = (cache->y2 + 1) * layer->width;
+		for (i = find_animated_cell(cells, cache->y1 * layer->width); i < cells->count && cells->cells[i] < end; i++) {
+			patch_vertex_cache(map, layer, cells->cells[i] % layer->width, cells->cells[i] / layer->width);
+		}
+	}
+}
+
+/*
+ * Shows an animated tile's current frame everywhere the tile is drawn.
+ */
+static void show_animation_frame(ALLEGRO_MAP *map, ANIMATED_TILE *anim)
+{
+	int gid = anim->firstgid + anim->frames[anim->frame].tile_id;
+	if (gid == anim->shown_gid) {
+		return;
+	}
+	anim->shown_gid = gid;
+
+	ALLEGRO_MAP_TILE *tile = al_get_tile_for_id(map, gid);
+	map->draw_bitmaps[anim->gid] = tile ? tile->bitmap : NULL;
+	if (map->vertex_tiles) {
+		// looked up again through get_shown_gid
+		map->vertex_tiles[anim->gid].resolved = false;
+	}
+
+	int i;
+	for (i = 0; i<anim->layer_count; i++) {
+		refresh_animated_cells(map, &anim->layers[i]);
+	}
+
+	// the cells of chunked layers aren't kept
+	if (map->infinite) {
+		dirty_scroll_surfaces(map);
+	}
+}
+
+/*
+ * Finds the map's animated tiles and shows their first frames. If the
+ * map has render caches or vertex arrays, the cells showing them are
+ * collected as well.
+ */
+void index_map_animations(ALLEGRO_MAP *map)
+{
+	int gid, count = 0;
+	for (gid = 1; gid<map->tiles_length; gid++) {
+		ALLEGRO_MAP_TILE *tile = map->tiles[gid];
+		if (tile && tile->frame_count) {
+			count++;
+		}
+	}
+
+	if (!count) {
+		return;
+	}
+
+	MAP_ANIMATIONS *animations = MALLOC(MAP_ANIMATIONS);
+	animations->tiles = (ANIMATED_TILE *)al_calloc(count, sizeof(ANIMATED_TILE));
+	animations->lookup = (int *)al_calloc(map->tiles_length, sizeof(int));
+	animations->queue = (int *)al_malloc(count * sizeof(int));
+	map->animations = animations;
+
+	for (gid = 1; gid<map->tiles_length; gid++) {
+		ALLEGRO_MAP_TILE *tile = map->tiles[gid];
+		int cycle = tile && tile->frame_count ? get_animation_cycle(map, tile) : 0;
+		if (cycle <= 0) {
+			// never changes frame, so it's drawn as it is
+			continue;
+		}
+
+		ANIMATED_TILE *anim = &animations->tiles[animations->count];
+		anim->gid = gid;
+		anim->frames = tile->frames;
+		anim->frame_count = tile->frame_count;
+		anim->firstgid = tile->tileset->firstgid;
+		anim->cycle = cycle;
+		anim->next_change = tile->frames[0].duration;
+
+		// frames lasting no time are skipped from the start too
+		while (anim->next_change <= 0) {
+			anim->frame++;
+			anim->next_change += tile->frames[anim->frame].duration;
+		}
+		show_animation_frame(map, anim);
+
+		animations->queue[animations->count] = animations->count;
+		animations->lookup[gid] = ++animations->count;
+	}
+
+	if (!animations->count) {
+		free_map_animations(map);
+		return;
+	}
+
+	int i;
+	for (i = animations->count / 2 - 1; i >= 0; i--) {
+		sift_animation(animations, i);
+	}
+
+	if (map->render_chunk_size || map->vertex_arrays) {
+		track_animated_cells(map);
+	}
+}
+
+/*
+ * Starts keeping the cells of each tile layer that show animated tiles,
+ * for the caches drawn from them to refresh when a frame changes.
+ * Chunked layers stream their cells in and out, so they're left out.
+ */
+void track_animated_cells(ALLEGRO_MAP *map)
+{
+	MAP_ANIMATIONS *animations = map->animations;
+	if (!animations || animations->track_cells) {
+		return;
+	}
+	animations->track_cells = true;
+
+	// cells are walked in order, so each list comes out sorted
+	GSList *layers = map->tile_layers;
+	while (layers) {
+		ALLEGRO_MAP_LAYER *layer = (ALLEGRO_MAP_LAYER*)layers->data;
+		layers = g_slist_next(layers);
+		if (layer->chunks || !layer->spans) {
+			continue;
+		}
+
+		LAYER_SPANS *spans = layer->spans;
+		int s, x, y;
+		for (y = 0; y<layer->height; y++) {
+			for (s = spans->rows[y]; s < spans->rows[y + 1]; s++) {
+				for (x = spans->spans[s * 2]; x <= spans->spans[s * 2 + 1]; x++) {
+					int cell = x + y * layer->width;
+					int gid = get_layer_gid(layer, cell);
+					if (gid > 0 && gid < map->tiles_length && animations->lookup[gid]) {
+						ANIMATED_CELLS *cells = get_animated_cells(&animations->tiles[animations->lookup[gid] - 1], layer, true);
+						insert_animated_cell(cells, cells->count, cell);
+					}
+				}
+			}
+		}
+	}
+}
+
+/*
+ * Keeps the lists of cells showing animated tiles up to date when cell i
+ * of a layer changes from one gid to another.
+ */
+void update_animated_cell(ALLEGRO_MAP *map, ALLEGRO_MAP_LAYER *layer, int i, int old_gid, int gid)
+{
+	MAP_ANIMATIONS *animations = map->animations;
+	if (!animations || !animations->track_cells || old_gid == gid) {
+		return;
+	}
+
+	if (old_gid > 0 && old_gid < map->tiles_length && animations->lookup[old_gid]) {
+		ANIMATED_CELLS *cells = get_animated_cells(&animations->tiles[animations->lookup[old_gid] - 1], layer, false);
+		int at = cells ? find_animated_cell(cells, i) : 0;
+		if (cells && at < cells->count && cells->cells[at] == i) {
+			memmove(cells->cells + at, cells->cells + at + 1, (cells->count - at - 1) * sizeof(int));
+			cells->count--;
+		}
+	}
+
+	if (gid > 0 && gid < map->tiles_length && animations->lookup[gid]) {
+		ANIMATED_CELLS *cells = get_animated_cells(&animations->tiles[animations->lookup[gid] - 1], layer, true);
+		int at = find_animated_cell(cells, i);
+		if (at == cells->count || cells->cells[at] != i) {
+			insert_animated_cell(cells, at, i);
+		}
+	}
+}
+
+/*
+ * Frees the map's animation schedule and cell lists.
+ */
+void free_map_animations(ALLEGRO_MAP *map)
+{
+	MAP_ANIMATIONS *animations = map->animations;
+	if (!animations) {
+		return;
+	}
+
+	int i, j;
+	for (i = 0; i<animations->count; i++) {
+		ANIMATED_TILE *anim = &animations->tiles[i];
+		for (j = 0; j<anim->layer_count; j++) {
+			al_free(anim->layers[j].cells);
+		}
+		al_free(anim->layers);
+	}
+
+	al_free(animations->tiles);
+	al_free(animations->lookup);
+	al_free(animations->queue);
+	al_free(animations);
+	map->animations = NULL;
+}
+
+/*
+ * Moves the map's animations on by the given number of seconds,
+ * usually the time since the last call. Only the tiles whose frame
+ * changes are touched.
+ */
+void al_update_map(ALLEGRO_MAP *map, double seconds)
+{
+	MAP_ANIMATIONS *animations = map->animations;
+	if (!animations || seconds <= 0) {
+		return;
+	}
+
+	animations->time += seconds * 1000.0;
+	while (animations->tiles[animations->queue[0]].next_change <= animations->time) {
+		ANIMATED_TILE *anim = &animations->tiles[animations->queue[0]];
+
+		// whole passes through the frames end where they started
+		double behind = animations->time - anim->next_change;
+		if (behind >= anim->cycle) {
+			anim->next_change += floor(behind / anim->cycle) * anim->cycle;
+		}
+
+		while (anim->next_change <= animations->time) {
+			anim->frame = (anim->frame + 1) % anim->frame_count;
+			anim->next_change += anim->frames[anim->frame].duration;
+		}
+
+		show_animation_frame(map, anim);
+		sift_animation(animations, 0);
+	}
+}
@@ -0,0 +1,84 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ */
+
+#ifndef _ANIM_H
+#define _ANIM_H
+
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_tiled.h>
+#include <glib.h>
+#include <math.h>
+#include "data.h"
+
+struct _ANIMATION_FRAME
+{
+	int tile_id;                // tile shown, numbered from its tileset's firstgid
+	int duration;               // time it's shown for, in milliseconds
+};
+
+// Cells of one layer showing an animated tile
+typedef struct {
+	ALLEGRO_MAP_LAYER *layer;
+	int *cells;                 // indexes of the cells, in ascending order
+	int count;                  // number of cells
+	int capacity;               // number of cells there's room for
+} ANIMATED_CELLS;
+
+typedef struct {
+	int gid;                    // gid of the animated tile
+	ANIMATION_FRAME *frames;    // its frames, from the tile
+	int frame_count;            // number of frames
+	int firstgid;               // firstgid of its tileset
+	int cycle;                  // length of one pass through the frames, in milliseconds
+	int frame;                  // index of the frame showing
+	int shown_gid;              // gid of the frame showing
+	double next_change;         // map time the next frame is due, in milliseconds
+	ANIMATED_CELLS *layers;     // cells showing it, for each layer it's on
+	int layer_count;            // number of layers it's on
+} ANIMATED_TILE;
+
+struct _MAP_ANIMATIONS
+{
+	ANIMATED_TILE *tiles;       // every animated tile on the map
+	int count;                  // number of animated tiles
+	int *lookup;                // one more than the index in tiles of each gid, or 0 if it doesn't animate
+	int *queue;                 // indexes in tiles, a heap ordered by next_change
+	double time;                // time the map has been updated by, in milliseconds
+	bool track_cells;           // keep the cells showing each tile, for the caches to patch
+};
+
+void set_tile_frames(ARENA *arena, ALLEGRO_MAP_TILE *tile, GArray *frames);
+void index_map_animations(ALLEGRO_MAP *map);
+void track_animated_cells(ALLEGRO_MAP *map);
+void update_animated_cell(ALLEGRO_MAP *map, ALLEGRO_MAP_LAYER *layer, int i, int old_gid, int gid);
+void free_map_animations(ALLEGRO_MAP *map);
+
+/*
+ * Gets the gid whose image is shown for the given one: the frame
+ * showing if it animates, else the gid itself.
+ */
+static inline int get_shown_gid(ALLEGRO_MAP *map, int gid)
+{
+	MAP_ANIMATIONS *animations = map->animations;
+	if (!animations || !animations->lookup[gid]) {
+		return gid;
+	}
+
+	return animations->tiles[animations->lookup[gid] - 1].shown_gid;
+}
+
+#endif
@@ -0,0 +1,156 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ *
+ *                               ---
+ *
+ * A bump allocator for memory that lives exactly as long as a map.
+ *
+ * Everything parsed out of a map file (its structs, strings, list
+ * nodes, gid-to-tile table and packed chunk ids) is carved out of a
+ * few large blocks, so freeing the map frees a handful of blocks
+ * instead of walking every object. Arenas are refcounted so a parsed
+ * tileset file can share its strings with the maps that use it.
+ *
+ * The cells of finite tile layers aren't kept here: their planes are
+ * reallocated whenever a cell is set that they can't hold, and an
+ * arena can't give the old ones back. They're allocated with al_malloc
+ * and freed by free_layer_planes.
+ */
+
+#include "arena.h"
+
+/*
+ * A block of memory, followed by its contents.
+ */
+typedef struct _ARENA_BLOCK ARENA_BLOCK;
+struct _ARENA_BLOCK
+{
+	ARENA_BLOCK *next;          // the previously filled block
+	size_t size;                // bytes available after the header
+	size_t used;                // bytes handed out so far
+};
+
+struct _ARENA
+{
+	ARENA_BLOCK *blocks;        // the current block, then older ones
+	int refs;                   // owners of the arena
+};
+
+// Every allocation is aligned for any type
+#define ARENA_ALIGN(n) (((n) + 15) & ~(size_t)15)
+#define BLOCK_HEADER ARENA_ALIGN(sizeof(ARENA_BLOCK))
+
+static ARENA_BLOCK *new_block(size_t size)
+{
+	ARENA_BLOCK *block = (ARENA_BLOCK *)al_calloc(1, BLOCK_HEADER + size);
+	block->size = size;
+	return block;
+}
+
+/*
+ * Creates an empty arena with a single reference.
+ */
+ARENA *create_arena(void)
+{
+	ARENA *arena = (ARENA *)al_calloc(1, sizeof(ARENA));
+	arena->refs = 1;
+	return arena;
+}
+
+ARENA *ref_arena(ARENA *arena)
+{
+	arena->refs++;
+	return arena;
+}
+
+/*
+ * Drops a reference, freeing every block once the last one is gone.
+ */
+void unref_arena(ARENA *arena)
+{
+	if (!arena || --arena->refs > 0) {
+		return;
+	}
+
+	ARENA_BLOCK *block = arena->blocks;
+	while (block) {
+		ARENA_BLOCK *next = block->next;
+		al_free(block);
+		block = next;
+	}
+
+	al_free(arena);
+}
+
+/*
+ * Allocates zeroed memory that's freed along with the arena.
+ * Large requests get a block of their own, behind the current one,
+ * so they don't waste what's left of it.
+ */
+void *arena_alloc(ARENA *arena, size_t size)
+{
+	size = ARENA_ALIGN(MAX(size, 1));
+
+	if (size > ARENA_BLOCK_SIZE / 4) {
+		ARENA_BLOCK *block = new_block(size);
+		block->used = size;
+		if (arena->blocks) {
+			block->next = arena->blocks->next;
+			arena->blocks->next = block;
+		} else {
+			arena->blocks = block;
+		}
+		return (char *)block + BLOCK_HEADER;
+	}
+
+	ARENA_BLOCK *block = arena->blocks;
+	if (!block || block->size - block->used < size) {
+		block = new_block(ARENA_BLOCK_SIZE);
+		block->next = arena->blocks;
+		arena->blocks = block;
+	}
+
+	void *ptr = (char *)block + BLOCK_HEADER + block->used;
+	block->used += size;
+	return ptr;
+}
+
+/*
+ * Copies a string into the arena. Returns NULL for NULL.
+ */
+char *arena_strdup(ARENA *arena, const char *str)
+{
+	if (!str) {
+		return NULL;
+	}
+
+	size_t length = strlen(str) + 1;
+	char *copy = (char *)arena_alloc(arena, length);
+	memcpy(copy, str, length);
+	return copy;
+}
+
+/*
+ * Like g_slist_prepend(), but the new node lives in the arena.
+ * Lists built this way must never be freed with g_slist_free().
+ */
+GSList *arena_slist_prepend(ARENA *arena, GSList *list, gpointer data)
+{
+	GSList *node = ARENA_NEW(arena, GSList);
+	node->data = data;
+	node->next = list;
+	return node;
+}
@@ -0,0 +1,40 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ */
+
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include <allegro5/allegro.h>
+#include <glib.h>
+#include <string.h>
+
+// Size of each block an arena hands out memory from
+#define ARENA_BLOCK_SIZE 65536
+
+typedef struct _ARENA ARENA;
+
+// Allocates a zeroed struct of the given type from an arena
+#define ARENA_NEW(arena, x) (x *)arena_alloc(arena, sizeof(x))
+
+ARENA *create_arena(void);
+ARENA *ref_arena(ARENA *arena);
+void unref_arena(ARENA *arena);
+void *arena_alloc(ARENA *arena, size_t size);
+char *arena_strdup(ARENA *arena, const char *str);
+GSList *arena_slist_prepend(ARENA *arena, GSList *list, gpointer data);
+
+#endif
@@ -0,0 +1,296 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ *
+ *                               ---
+ *
+ * Packing a map's tilesets into atlas bitmaps.
+ *
+ * Allegro flushes a held drawing batch whenever the texture changes,
+ * so a layer that mixes tilesets draws in many small batches. With
+ * ALLEGRO_MAP_ATLAS, every tile is copied into one or a few shared
+ * bitmaps and tile bitmaps become sub-bitmaps of those. Each tile
+ * gets a border that repeats its edge pixels, so filtering doesn't
+ * bleed its neighbours in when drawn scaled or at fractional positions.
+ */
+
+#include "atlas.h"
+
+/*
+ * A tile's place in its tileset image and in the atlas.
+ */
+typedef struct {
+	int gid;                        // global id of the tile
+	ALLEGRO_MAP_TILESET *tileset;   // tileset it's cut from
+	int sx, sy;                     // position in the tileset image
+	int atlas;                      // index of its atlas, or -1 if it didn't fit
+	int x, y;                       // position of its padded cell in the atlas
+} ATLAS_CELL;
+
+/*
+ * Orders cells tallest first, so shelves waste less space.
+ */
+static int compare_cells(const void *a, const void *b)
+{
+	const ATLAS_CELL *first = (const ATLAS_CELL*)a;
+	const ATLAS_CELL *second = (const ATLAS_CELL*)b;
+	if (first->tileset->tileheight != second->tileset->tileheight) {
+		return second->tileset->tileheight - first->tileset->tileheight;
+	}
+
+	return first->gid - second->gid;
+}
+
+/*
+ * Gets the first gid past the end of the tileset's range: the next
+ * tileset's firstgid, or the end of the map's tile list.
+ */
+static int tileset_end(ALLEGRO_MAP *map, ALLEGRO_MAP_TILESET *tileset)
+{
+	int end = map->tiles_length;
+	GSList *tilesets = map->tilesets;
+	while (tilesets) {
+		ALLEGRO_MAP_TILESET *other = (ALLEGRO_MAP_TILESET*)tilesets->data;
+		tilesets = g_slist_next(tilesets);
+		if (other->firstgid > tileset->firstgid) {
+			end = MIN(end, other->firstgid);
+		}
+	}
+
+	return end;
+}
+
+/*
+ * Lists every tile of every loaded tileset image.
+ * If cells is NULL, only counts them.
+ */
+static int collect_cells(ALLEGRO_MAP *map, ATLAS_CELL *cells)
+{
+	int count = 0;
+	GSList *tilesets = map->tilesets;
+	while (tilesets) {
+		ALLEGRO_MAP_TILESET *tileset = (ALLEGRO_MAP_TILESET*)tilesets->data;
+		tilesets = g_slist_next(tilesets);
+		if (!tileset->bitmap || tileset->tilewidth <= 0 || tileset->tileheight <= 0) {
+			continue;
+		}
+
+		int columns = al_get_bitmap_width(tileset->bitmap) / tileset->tilewidth;
+		int rows = al_get_bitmap_height(tileset->bitmap) / tileset->tileheight;
+		int end = tileset_end(map, tileset);
+		int i;
+		for (i = 0; i<columns*rows && tileset->firstgid + i < end; i++) {
+			if (cells) {
+				ATLAS_CELL *cell = &cells[count];
+				cell->gid = tileset->firstgid + i;
+				cell->tileset = tileset;
+				cell->sx = (i % columns) * tileset->tilewidth;
+				cell->sy = (i / columns) * tileset->tileheight;
+				cell->atlas = -1;
+			}
+			count++;
+		}
+	}
+
+	return count;
+}
+
+/*
+ * Lays the cells out on shelves across as many atlases as it takes.
+ * Returns the number of atlases and sets the width they all share.
+ */
+static int layout_cells(ATLAS_CELL *cells, int count, int max_size, int *width)
+{
+	int i, area = 0, widest = 0;
+	for (i = 0; i<count; i++) {
+		int w = cells[i].tileset->tilewidth + 2*ATLAS_PADDING;
+		int h = cells[i].tileset->tileheight + 2*ATLAS_PADDING;
+		area += w * h;
+		widest = MAX(widest, w);
+	}
+
+	// the smallest power of two that would hold everything in a square
+	(*width) = 64;
+	while ((*width) * (*width) < area && (*width) < max_size) {
+		(*width) *= 2;
+	}
+	(*width) = MIN(MAX(*width, widest), max_size);
+
+	int atlas = 0, x = 0, y = 0, shelf = 0;
+	for (i = 0; i<count; i++) {
+		ATLAS_CELL *cell = &cells[i];
+		int w = cell->tileset->tilewidth + 2*ATLAS_PADDING;
+		int h = cell->tileset->tileheight + 2*ATLAS_PADDING;
+		if (w > max_size || h > max_size) {
+			continue;
+		}
+
+		if (x + w > (*width)) {
+			x = 0;
+			y += shelf;
+			shelf = 0;
+		}
+
+		if (y + h > max_size) {
+			atlas++;
+			x = y = shelf = 0;
+		}
+
+		cell->atlas = atlas;
+		cell->x = x;
+		cell->y = y;
+		x += w;
+		shelf = MAX(shelf, h);
+	}
+
+	return (count ? atlas + 1 : 0);
+}
+
+/*
+ * Copies a tile into its cell, then repeats its outermost rows and
+ * columns of pixels into the border around it.
+ */
+static void copy_cell(ATLAS_CELL *cell)
+{
+	ALLEGRO_BITMAP *src = cell->tileset->bitmap;
+	int w = cell->tileset->tilewidth;
+	int h = cell->tileset->tileheight;
+	int sx = cell->sx, sy = cell->sy;
+	int x = cell->x + ATLAS_PADDING, y = cell->y + ATLAS_PADDING;
+	int i;
+
+	al_draw_bitmap_region(src, sx, sy, w, h, x, y, 0);
+
+	for (i = 1; i<=ATLAS_PADDING; i++) {
+		// edges
+		al_draw_bitmap_region(src, sx, sy, w, 1, x, y - i, 0);
+		al_draw_bitmap_region(src, sx, sy + h - 1, w, 1, x, y + h - 1 + i, 0);
+		al_draw_bitmap_region(src, sx, sy, 1, h, x - i, y, 0);
+		al_draw_bitmap_region(src, sx + w - 1, sy, 1, h, x + w - 1 + i, y, 0);
+	}
+
+	for (i = 1; i<=ATLAS_PADDING; i++) {
+		int j;
+		for (j = 1; j<=ATLAS_PADDING; j++) {
+			// corners
+			al_draw_bitmap_region(src, sx, sy, 1, 1, x - i, y - j, 0);
+			al_draw_bitmap_region(src, sx + w - 1, sy, 1, 1, x + w - 1 + i, y - j, 0);
+			al_draw_bitmap_region(src, sx, sy + h - 1, 1, 1, x - i, y + h - 1 + j, 0);
+			al_draw_bitmap_region(src, sx + w - 1, sy + h - 1, 1, 1, x + w - 1 + i, y + h - 1 + j, 0);
+		}
+	}
+}
+
+/*
+ * Packs every tile of the map's tilesets into atlas bitmaps, and
+ * fills in map->atlas_tiles with their sub-bitmaps, indexed by gid.
+ * Tiles that couldn't be packed keep using their tileset's image.
+ */
+void pack_map_atlas(ALLEGRO_MAP *map)
+{
+	int count = collect_cells(map, NULL);
+	if (!count) {
+		return;
+	}
+
+	ATLAS_CELL *cells = (ATLAS_CELL *)al_malloc(count * sizeof(ATLAS_CELL));
+	collect_cells(map, cells);
+	qsort(cells, count, sizeof(ATLAS_CELL), &compare_cells);
+
+	ALLEGRO_DISPLAY *display = al_get_current_display();
+	int max_size = (display ? al_get_display_option(display, ALLEGRO_MAX_BITMAP_SIZE) : 0);
+	if (max_size <= 0) {
+		max_size = DEFAULT_ATLAS_SIZE;
+	}
+
+	int width, i;
+	int atlas_count = layout_cells(cells, count, max_size, &width);
+	int *heights = (int *)al_calloc(MAX(atlas_count, 1), sizeof(int));
+	for (i = 0; i<count; i++) {
+		if (cells[i].atlas >= 0) {
+			int h = cells[i].tileset->tileheight + 2*ATLAS_PADDING;
+			heights[cells[i].atlas] = MAX(heights[cells[i].atlas], cells[i].y + h);
+		}
+	}
+
+	ALLEGRO_STATE state;
+	al_store_state(&state, ALLEGRO_STATE_TARGET_BITMAP | ALLEGRO_STATE_BLENDER);
+	al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_ZERO);
+
+	map->atlas_tiles = (ALLEGRO_BITMAP **)al_calloc(map->tiles_length, sizeof(ALLEGRO_BITMAP *));
+	map->atlas_origins = (int *)al_calloc(map->tiles_length * 2, sizeof(int));
+
+	ALLEGRO_BITMAP *atlas = NULL;
+	int current = -1;
+	for (i = 0; i<count; i++) {
+		ATLAS_CELL *cell = &cells[i];
+		if (cell->atlas < 0) {
+			continue;
+		}
+
+		if (cell->atlas != current) {
+			al_hold_bitmap_drawing(false);
+			current = cell->atlas;
+			atlas = al_create_bitmap(width, heights[current]);
+			if (!atlas) {
+				fprintf(stderr, "Error: failed to create %dx%d tile atlas\n", width, heights[current]);
+				break;
+			}
+
+			map->atlases = g_slist_prepend(map->atlases, atlas);
+			al_set_target_bitmap(atlas);
+			al_clear_to_color(al_map_rgba(0, 0, 0, 0));
+			al_hold_bitmap_drawing(true);
+		}
+
+		copy_cell(cell);
+		map->atlas_tiles[cell->gid] = al_create_sub_bitmap(atlas,
+				cell->x + ATLAS_PADDING,
+				cell->y + ATLAS_PADDING,
+				cell->tileset->tilewidth,
+				cell->tileset->tileheight);
+		map->atlas_origins[cell->gid * 2] = cell->x + ATLAS_PADDING;
+		map->atlas_origins[cell->gid * 2 + 1] = cell->y + ATLAS_PADDING;
+	}
+
+	al_hold_bitmap_drawing(false);
+	al_restore_state(&state);
+
+	al_free(heights);
+	al_free(cells);
+}
+
+/*
+ * Destroys the map's atlases and the tile bitmaps cut from them.
+ */
+void free_map_atlas(ALLEGRO_MAP *map)
+{
+	if (map->atlas_tiles) {
+		int i;
+		for (i = 0; i<map->tiles_length; i++) {
+			al_destroy_bitmap(map->atlas_tiles[i]);
+		}
+		al_free(map->atlas_tiles);
+	}
+	al_free(map->atlas_origins);
+
+	GSList *atlases = map->atlases;
+	while (atlases) {
+		al_destroy_bitmap((ALLEGRO_BITMAP*)atlases->data);
+		atlases = g_slist_next(atlases);
+	}
+
+	g_slist_free(map->atlases);
+}
@@ -0,0 +1,35 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ */
+
+#ifndef _ATLAS_H
+#define _ATLAS_H
+
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_tiled.h>
+#include <glib.h>
+#include "data.h"
+
+// Pixels of extruded edge around each tile in an atlas
+#define ATLAS_PADDING 1
+
+// Atlas size used when there's no display to ask for its limit
+#define DEFAULT_ATLAS_SIZE 2048
+
+void pack_map_atlas(ALLEGRO_MAP *map);
+void free_map_atlas(ALLEGRO_MAP *map);
+
+#endif
@@ -0,0 +1,268 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ *
+ *                               ---
+ *
+ * Process-wide cache of tileset images.
+ *
+ * Tileset images are keyed by their resolved path and shared between
+ * every open map that uses them, along with the tile sub-bitmaps cut
+ * from them. Each tileset holds a reference, and an image is destroyed
+ * once the last map using it is freed, unless it's been pinned.
+ * Like bitmap loading itself, none of this is thread-safe.
+ */
+
+#include <sys/stat.h>
+#include "cache.h"
+#include "parser.h"
+
+/*
+ * Sub-bitmaps of an image cut into tiles of one size.
+ */
+typedef struct {
+	int tilewidth, tileheight;  // size of each tile
+	int count;                  // number of tiles that fit in the image
+	ALLEGRO_BITMAP **bitmaps;   // tile bitmaps, created as they're asked for
+} TILE_GRID;
+
+struct _TILESET_IMAGE
+{
+	char *path;                 // resolved path, used as the cache key
+	time_t mtime;               // the file's modification time when loaded
+	ALLEGRO_BITMAP *bitmap;     // the whole image
+	GSList *grids;              // tile sub-bitmaps, one grid per tile size
+	int refs;                   // tilesets and pins holding the image
+	bool stale;                 // replaced in the cache by a newer copy
+};
+
+/*
+ * Loaded images by path, and the images pinned by al_pin_tileset_image().
+ */
+static GHashTable *images = NULL;
+static GHashTable *pins = NULL;
+
+/*
+ * Gets the modification time of a file, or 0 if it can't be read.
+ */
+time_t get_file_mtime(const char *path)
+{
+	struct stat st;
+	if (stat(path, &st)) {
+		return 0;
+	}
+
+	return st.st_mtime;
+}
+
+/*
+ * Returns a new reference to the image at the given path, loading it
+ * if it isn't cached or its file has changed since it was.
+ */
+static TILESET_IMAGE *acquire_tileset_image(const char *filename)
+{
+	if (!images) {
+		images = g_hash_table_new(&g_str_hash, &g_str_equal);
+	}
+
+	char *path = resolve_map_path(filename);
+	time_t mtime = get_file_mtime(path);
+
+	TILESET_IMAGE *image = (TILESET_IMAGE*)g_hash_table_lookup(images, path);
+	if (image && image->mtime == mtime) {
+		image->refs++;
+		g_free(path);
+		return image;
+	}
+
+	ALLEGRO_BITMAP *bitmap = al_load_bitmap(path);
+	if (!bitmap) {
+		fprintf(stderr, "Error: failed to load tileset image: %s\n", path);
+		g_free(path);
+		return NULL;
+	}
+
+	if (image) {
+		// the file changed; maps still using the old copy keep it until they're freed
+		g_hash_table_remove(images, image->path);
+		image->stale = true;
+	}
+
+	image = MALLOC(TILESET_IMAGE);
+	image->path = path;
+	image->mtime = mtime;
+	image->bitmap = bitmap;
+	image->refs = 1;
+	g_hash_table_insert(images, image->path, image);
+	return image;
+}
+
+/*
+ * Loads a tileset's image through the cache.
+ */
+void attach_tileset_image(ALLEGRO_MAP_TILESET *tileset)
+{
+	tileset->image = acquire_tileset_image(tileset->source);
+	tileset->bitmap = (tileset->image ? tileset->image->bitmap : NULL);
+}
+
+/*
+ * Number of tiles cut from the tileset's image.
+ */
+int tileset_tile_count(ALLEGRO_MAP_TILESET *tileset)
+{
+	if (tileset->tilewidth <= 0 || tileset->tileheight <= 0) {
+		return 0;
+	}
+
+	return (tileset->width / tileset->tilewidth) * (tileset->height / tileset->tileheight);
+}
+
+/*
+ * Returns true if the local tile id is one of the tiles cut from the
+ * tileset's image.
+ */
+bool tileset_has_tile(ALLEGRO_MAP_TILESET *tileset, int id)
+{
+	return id >= 0 && id < tileset_tile_count(tileset);
+}
+
+/*
+ * Drops a reference to an image, destroying it and its tile bitmaps
+ * once nothing holds it anymore.
+ */
+void release_tileset_image(TILESET_IMAGE *image)
+{
+	if (!image || --image->refs > 0) {
+		return;
+	}
+
+	if (!image->stale) {
+		g_hash_table_remove(images, image->path);
+	}
+
+	GSList *grids = image->grids;
+	while (grids) {
+		TILE_GRID *grid = (TILE_GRID*)grids->data;
+		grids = g_slist_next(grids);
+
+		int i;
+		for (i = 0; i<grid->count; i++) {
+			al_destroy_bitmap(grid->bitmaps[i]);
+		}
+		al_free(grid->bitmaps);
+		al_free(grid);
+	}
+
+	g_slist_free(image->grids);
+	al_destroy_bitmap(image->bitmap);
+	g_free(image->path);
+	al_free(image);
+}
+
+/*
+ * Gets the bitmap of the index-th tile of the given size, counting
+ * left to right, top to bottom. Returns NULL if it's outside the image.
+ */
+ALLEGRO_BITMAP *get_tileset_image_tile(TILESET_IMAGE *image, int index, int tilewidth, int tileheight)
+{
+	if (!image || tilewidth <= 0 || tileheight <= 0) {
+		return NULL;
+	}
+
+	TILE_GRID *grid = NULL;
+	GSList *grids = image->grids;
+	while (grids && !grid) {
+		TILE_GRID *candidate = (TILE_GRID*)grids->data;
+		grids = g_slist_next(grids);
+		if (candidate->tilewidth == tilewidth && candidate->tileheight == tileheight) {
+			grid = candidate;
+		}
+	}
+
+	int columns = al_get_bitmap_width(image->bitmap) / tilewidth;
+	if (!grid) {
+		int rows = al_get_bitmap_height(image->bitmap) / tileheight;
+		grid = MALLOC(TILE_GRID);
+		grid->tilewidth = tilewidth;
+		grid->tileheight = tileheight;
+		grid->count = columns * rows;
+		grid->bitmaps = (ALLEGRO_BITMAP **)al_calloc(MAX(grid->count, 1), sizeof(ALLEGRO_BITMAP *));
+		image->grids = g_slist_prepend(image->grids, grid);
+	}
+
+	if (index < 0 || index >= grid->count) {
+		return NULL;
+	}
+
+	if (!grid->bitmaps[index]) {
+		grid->bitmaps[index] = al_create_sub_bitmap(
+				image->bitmap,
+				(index % columns) * tilewidth,
+				(index / columns) * tileheight,
+				tilewidth,
+				tileheight);
+	}
+
+	return grid->bitmaps[index];
+}
+
+/*
+ * Loads a tileset image into the cache and keeps it there, even while
+ * no open map uses it, until it's unpinned. Use this to preload images
+ * for the next level, or to keep them across a level change.
+ * The filename is relative to the current directory.
+ */
+bool al_pin_tileset_image(const char *filename)
+{
+	if (!pins) {
+		pins = g_hash_table_new(&g_str_hash, &g_str_equal);
+	}
+
+	char *path = resolve_map_path(filename);
+	if (g_hash_table_lookup(pins, path)) {
+		g_free(path);
+		return true;
+	}
+
+	TILESET_IMAGE *image = acquire_tileset_image(path);
+	if (!image) {
+		g_free(path);
+		return false;
+	}
+
+	g_hash_table_insert(pins, path, image);
+	return true;
+}
+
+/*
+ * Releases an image pinned with al_pin_tileset_image().
+ */
+void al_unpin_tileset_image(const char *filename)
+{
+	if (!pins) {
+		return;
+	}
+
+	char *path = resolve_map_path(filename);
+	gpointer key, value;
+	if (g_hash_table_lookup_extended(pins, path, &key, &value)) {
+		g_hash_table_remove(pins, path);
+		g_free(key);
+		release_tileset_image((TILESET_IMAGE*)value);
+	}
+
+	g_free(path);
+}
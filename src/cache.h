@@ -0,0 +1,33 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ */
+
+#ifndef _CACHE_H
+#define _CACHE_H
+
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_tiled.h>
+#include <glib.h>
+#include "data.h"
+
+time_t get_file_mtime(const char *path);
+void attach_tileset_image(ALLEGRO_MAP_TILESET *tileset);
+int tileset_tile_count(ALLEGRO_MAP_TILESET *tileset);
+bool tileset_has_tile(ALLEGRO_MAP_TILESET *tileset, int id);
+void release_tileset_image(TILESET_IMAGE *image);
+ALLEGRO_BITMAP *get_tileset_image_tile(TILESET_IMAGE *image, int index, int tilewidth, int tileheight);
+
+#endif
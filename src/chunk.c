@@ -0,0 +1,336 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ *
+ *
+ *                               ---
+ *
+ * Sparse storage for the tile layers of infinite maps.
+ *
+ * Tiled writes an infinite layer as a set of fixed-size <chunk> nodes
+ * rather than one block covering the whole layer. Every chunk is kept
+ * compressed in the map's arena, and a table indexed by chunk position
+ * points at them. Only the chunks around the camera are inflated (see
+ * al_stream_map_chunks), so resident memory follows the viewport
+ * instead of the size of the world. Tiles set in a resident chunk are
+ * packed again when it's dropped.
+ */
+
+#include "chunk.h"
+#include "map.h"
+
+/*
+ * Packs a decoded chunk of width*height ids into the arena.
+ * The chunk starts out not resident.
+ */
+LAYER_CHUNK *create_layer_chunk(ARENA *arena, int x, int y, int width, int height, const int *data)
+{
+	size_t size;
+	unsigned char *packed = def((const unsigned char *)data, width * height * sizeof(int), &size);
+	if (!packed) {
+		return NULL;
+	}
+
+	LAYER_CHUNK *chunk = ARENA_NEW(arena, LAYER_CHUNK);
+	chunk->x = x;
+	chunk->y = y;
+	chunk->width = width;
+	chunk->height = height;
+	chunk->packed = (unsigned char *)arena_alloc(arena, size);
+	chunk->packed_size = size;
+	memcpy(chunk->packed, packed, size);
+	al_free(packed);
+
+	int i;
+	for (i = 0; i<width * height; i++) {
+		chunk->occupied += data[i] != 0;
+	}
+
+	return chunk;
+}
+
+/*
+ * Builds the table of a layer's chunks. Every chunk must share the size
+ * of the first one and sit on its grid; any that don't are dropped.
+ * The name is only used for error messages.
+ */
+CHUNK_TABLE *create_chunk_table(ARENA *arena, const char *name, GSList *chunks)
+{
+	CHUNK_TABLE *table = ARENA_NEW(arena, CHUNK_TABLE);
+	if (!chunks) {
+		// an empty layer; any size will do
+		table->chunk_width = table->chunk_height = 1;
+		return table;
+	}
+
+	// the size is stored with the chunks, so peek at the first one
+	LAYER_CHUNK *first = (LAYER_CHUNK*)chunks->data;
+	table->chunk_width = first->width;
+	table->chunk_height = first->height;
+
+	int x1 = first->x, y1 = first->y, x2 = first->x, y2 = first->y;
+	GSList *chunk_item = chunks;
+	while (chunk_item) {
+		LAYER_CHUNK *chunk = (LAYER_CHUNK*)chunk_item->data;
+		chunk_item = g_slist_next(chunk_item);
+		x1 = MIN(x1, chunk->x);
+		y1 = MIN(y1, chunk->y);
+		x2 = MAX(x2, chunk->x);
+		y2 = MAX(y2, chunk->y);
+	}
+
+	table->x = x1;
+	table->y = y1;
+	table->columns = (x2 - x1) / table->chunk_width + 1;
+	table->rows = (y2 - y1) / table->chunk_height + 1;
+	table->chunks = (LAYER_CHUNK **)arena_alloc(arena, table->columns * table->rows * sizeof(LAYER_CHUNK*));
+
+	chunk_item = chunks;
+	while (chunk_item) {
+		LAYER_CHUNK *chunk = (LAYER_CHUNK*)chunk_item->data;
+		chunk_item = g_slist_next(chunk_item);
+
+		int dx = chunk->x - x1, dy = chunk->y - y1;
+		if (chunk->width != table->chunk_width || chunk->height != table->chunk_height
+				|| dx % table->chunk_width || dy % table->chunk_height) {
+			fprintf(stderr, "Error: chunk at %d,%d in layer \"%s\" doesn't fit the chunk grid\n", chunk->x, chunk->y, name);
+			continue;
+		}
+
+		table->chunks[dx / table->chunk_width + (dy / table->chunk_height) * table->columns] = chunk;
+	}
+
+	return table;
+}
+
+/*
+ * Inflates a chunk's ids so its tiles can be looked up and drawn.
+ * Empty chunks are just zeroed, so tiles can still be set in them.
+ */
+static bool load_chunk(CHUNK_TABLE *table, LAYER_CHUNK *chunk)
+{
+	size_t datasize = chunk->width * chunk->height * sizeof(int);
+	int *data = (int *)(chunk->occupied ? al_malloc(datasize) : al_calloc(1, datasize));
+	if (!data) {
+		return false;
+	}
+
+	int status = chunk->occupied ? inf(chunk->packed, chunk->packed_size, (unsigned char *)data, datasize) : 0;
+	if (status) {
+		zerr(status);
+		al_free(data);
+		return false;
+	}
+
+	chunk->data = data;
+	table->resident = g_slist_prepend(table->resident, chunk);
+	table->resident_count++;
+	return true;
+}
+
+/*
+ * Drops a chunk's decoded ids, packing them again first if any were set.
+ */
+static void unload_chunk(LAYER_CHUNK *chunk)
+{
+	if (chunk->dirty) {
+		size_t size;
+		unsigned char *packed = def((const unsigned char *)chunk->data, chunk->width * chunk->height * sizeof(int), &size);
+		if (packed) {
+			if (chunk->packed_owned) {
+				al_free(chunk->packed);
+			}
+			chunk->packed = packed;
+			chunk->packed_size = size;
+			chunk->packed_owned = true;
+		} else {
+			fprintf(stderr, "Error: couldn't pack chunk at %d,%d; its changes are lost\n", chunk->x, chunk->y);
+		}
+		chunk->dirty = false;
+	}
+
+	al_free(chunk->data);
+	chunk->data = NULL;
+}
+
+/*
+ * Has the scroll surfaces of the map redraw a chunk that was brought in
+ * or dropped, unless it holds no tiles and so looks the same either way.
+ */
+static void invalidate_chunk(ALLEGRO_MAP *map, LAYER_CHUNK *chunk)
+{
+	if (chunk->occupied) {
+		invalidate_scroll_surface_cells(map, chunk->x, chunk->y, chunk->x + chunk->width - 1, chunk->y + chunk->height - 1);
+	}
+}
+
+/*
+ * Brings in the chunks of a table that overlap the given tile range,
+ * and drops the resident ones that don't.
+ */
+static void stream_chunk_table(ALLEGRO_MAP *map, CHUNK_TABLE *table, int x1, int y1, int x2, int y2)
+{
+	// the range in chunks, which may fall partly or wholly off the table
+	int c1 = x1 - table->x, r1 = y1 - table->y, c2 = x2 - table->x, r2 = y2 - table->y;
+	c1 = c1 < 0 ? -1 : c1 / table->chunk_width;
+	r1 = r1 < 0 ? -1 : r1 / table->chunk_height;
+	c2 = c2 < 0 ? -1 : c2 / table->chunk_width;
+	r2 = r2 < 0 ? -1 : r2 / table->chunk_height;
+
+	// only the resident chunks are visited, so this doesn't grow with the world
+	GSList *chunk_item = table->resident;
+	while (chunk_item) {
+		LAYER_CHUNK *chunk = (LAYER_CHUNK*)chunk_item->data;
+		GSList *next = g_slist_next(chunk_item);
+
+		int column = (chunk->x - table->x) / table->chunk_width;
+		int row = (chunk->y - table->y) / table->chunk_height;
+		if (column < c1 || column > c2 || row < r1 || row > r2) {
+			unload_chunk(chunk);
+			invalidate_chunk(map, chunk);
+			table->resident = g_slist_delete_link(table->resident, chunk_item);
+			table->resident_count--;
+		}
+
+		chunk_item = next;
+	}
+
+	c1 = MAX(c1, 0);
+	r1 = MAX(r1, 0);
+	c2 = MIN(c2, table->columns - 1);
+	r2 = MIN(r2, table->rows - 1);
+
+	int column, row;
+	for (row = r1; row <= r2; row++) {
+		for (column = c1; column <= c2; column++) {
+			LAYER_CHUNK *chunk = table->chunks[column + row * table->columns];
+			if (chunk && !chunk->data) {
+				if (load_chunk(table, chunk)) {
+					invalidate_chunk(map, chunk);
+				}
+			}
+		}
+	}
+}
+
+/*
+ * Frees the decoded ids of every resident chunk, and the packed ids of
+ * those that were packed again. The table itself lives in the map's arena.
+ */
+void free_chunk_table(CHUNK_TABLE *table)
+{
+	int i;
+	for (i = 0; i<table->columns * table->rows; i++) {
+		LAYER_CHUNK *chunk = table->chunks[i];
+		if (!chunk) {
+			continue;
+		}
+		al_free(chunk->data);
+		chunk->data = NULL;
+		if (chunk->packed_owned) {
+			al_free(chunk->packed);
+			chunk->packed = NULL;
+			chunk->packed_owned = false;
+		}
+	}
+
+	g_slist_free(table->resident);
+	table->resident = NULL;
+	table->resident_count = 0;
+}
+
+/*
+ * Stores a raw id at the given tile position of a chunked layer.
+ * Only resident chunks can be written to.
+ * Returns false if no resident chunk covers the position.
+ */
+bool set_chunk_tile(CHUNK_TABLE *table, int x, int y, int raw)
+{
+	int i;
+	LAYER_CHUNK *chunk = find_resident_chunk(table, x, y, &i);
+	if (!chunk) {
+		return false;
+	}
+
+	chunk->occupied += (raw != 0) - (chunk->data[i] != 0);
+	chunk->data[i] = raw;
+	chunk->dirty = true;
+	return true;
+}
+
+/*
+ * Makes the chunks of an infinite map holding the cells drawn in the
+ * given region (in pixels) resident, and releases the rest. Call it whenever the
+ * camera moves, with a margin around the screen so chunks are ready
+ * before they scroll into view; tiles in chunks that aren't resident
+ * read as empty. Does nothing for maps that aren't infinite.
+ */
+void al_stream_map_chunks(ALLEGRO_MAP *map, float sx, float sy, float sw, float sh)
+{
+	if (map->tile_width <= 0 || map->tile_height <= 0) {
+		return;
+	}
+
+	// the cells the region's drawn from, as each orientation culls them
+	int x1, y1, x2, y2, d1, d2, e1, e2;
+	switch (map->orientation_kind) {
+		case ORIENTATION_ISOMETRIC:
+			get_isometric_diagonals(map, sx, sy, sw, sh, &d1, &d2, &e1, &e2);
+			x1 = ceilf((d1 + e1) / 2.0f);
+			x2 = floorf((d2 + e2) / 2.0f);
+			y1 = ceilf((d1 - e2) / 2.0f);
+			y2 = floorf((d2 - e1) / 2.0f);
+			break;
+		case ORIENTATION_STAGGERED:
+		case ORIENTATION_HEXAGONAL:
+			get_staggered_bounds(map, sx, sy, sw, sh, &x1, &y1, &x2, &y2);
+			break;
+		default:
+			x1 = (int)floorf(sx / map->tile_width);
+			y1 = (int)floorf(sy / map->tile_height);
+			x2 = (int)floorf((sx + sw) / map->tile_width);
+			y2 = (int)floorf((sy + sh) / map->tile_height);
+			break;
+	}
+
+	GSList *layers = map->tile_layers;
+	while (layers) {
+		ALLEGRO_MAP_LAYER *layer = (ALLEGRO_MAP_LAYER*)layers->data;
+		layers = g_slist_next(layers);
+		if (layer->chunks) {
+			stream_chunk_table(map, layer->chunks, x1, y1, x2, y2);
+		}
+	}
+}
+
+/*
+ * Gets the number of chunks currently inflated across all of the
+ * map's layers.
+ */
+int al_get_map_resident_chunks(ALLEGRO_MAP *map)
+{
+	int count = 0;
+
+	GSList *layers = map->tile_layers;
+	while (layers) {
+		ALLEGRO_MAP_LAYER *layer = (ALLEGRO_MAP_LAYER*)layers->data;
+		layers = g_slist_next(layers);
+		if (layer->chunks) {
+			count += layer->chunks->resident_count;
+		}
+	}
+
+	return count;
+}
@@ -0,0 +1,93 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ */
+
+#ifndef _CHUNK_H
+#define _CHUNK_H
+
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_tiled.h>
+#include <glib.h>
+#include <math.h>
+#include "data.h"
+#include "zpipe.h"
+
+struct _LAYER_CHUNK
+{
+	int x, y;                   // position of the first tile, in tiles
+	int width, height;          // size in tiles
+	int *data;                  // decoded ids, or NULL if it isn't resident
+	unsigned char *packed;      // compressed ids, always present
+	size_t packed_size;         // size of the compressed ids
+	bool packed_owned;          // packed was allocated for the chunk rather than from the arena
+	bool dirty;                 // ids were set since the chunk was inflated
+	int occupied;               // number of cells holding a tile
+};
+
+struct _CHUNK_TABLE
+{
+	int x, y;                   // tile position of the table's first chunk
+	int chunk_width;            // width of every chunk, in tiles
+	int chunk_height;           // height of every chunk, in tiles
+	int columns, rows;          // size of the table, in chunks
+	LAYER_CHUNK **chunks;       // chunks by position, NULL where there's none
+	GSList *resident;           // chunks whose ids are decoded
+	int resident_count;         // length of the resident list
+};
+
+LAYER_CHUNK *create_layer_chunk(ARENA *arena, int x, int y, int width, int height, const int *data);
+CHUNK_TABLE *create_chunk_table(ARENA *arena, const char *name, GSList *chunks);
+void free_chunk_table(CHUNK_TABLE *table);
+bool set_chunk_tile(CHUNK_TABLE *table, int x, int y, int raw);
+
+/*
+ * Finds the resident chunk holding the given tile position, and the
+ * index of the position within it. Returns NULL if there's none.
+ */
+static inline LAYER_CHUNK *find_resident_chunk(CHUNK_TABLE *table, int x, int y, int *i)
+{
+	x -= table->x;
+	y -= table->y;
+	if (x < 0 || y < 0) {
+		return NULL;
+	}
+
+	int column = x / table->chunk_width, row = y / table->chunk_height;
+	if (column >= table->columns || row >= table->rows) {
+		return NULL;
+	}
+
+	LAYER_CHUNK *chunk = table->chunks[column + row * table->columns];
+	if (!chunk || !chunk->data) {
+		return NULL;
+	}
+
+	*i = (x % table->chunk_width) + (y % table->chunk_height) * table->chunk_width;
+	return chunk;
+}
+
+/*
+ * Look up the raw id at the given tile position of a chunked layer.
+ * Cells outside every chunk, or in a chunk that isn't resident, read as 0.
+ */
+static inline int lookup_chunk_tile(CHUNK_TABLE *table, int x, int y)
+{
+	int i;
+	LAYER_CHUNK *chunk = find_resident_chunk(table, x, y, &i);
+	return chunk ? chunk->data[i] : 0;
+}
+
+#endif
@@ -0,0 +1,749 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ *
+ *                               ---
+ *
+ * Reading and writing compiled map images.
+ *
+ * A compiled image is a binary snapshot of a parsed map: the header,
+ * a stream of 32-bit records describing tilesets, tiles, layers and
+ * objects, the gid and flip planes of every tile layer, and a table
+ * of unique strings. Loading one maps the file into memory and points
+ * each layer straight at its planes.
+ */
+
+#include "compiled.h"
+
+/*
+ * State used while building an image.
+ */
+typedef struct {
+	GArray *records;            // guint32 records, already little-endian
+	GString *strings;           // NUL-separated string table
+	GHashTable *string_offsets; // string -> offset in the table
+	guint32 data_size;          // bytes of layer planes laid out so far
+} IMAGE_WRITER;
+
+/*
+ * State used while reading an image.
+ */
+typedef struct {
+	const guint32 *pos;         // next record
+	const guint32 *end;         // end of the records
+	const char *data;           // start of the layer planes
+	guint32 data_size;
+	const char *strings;        // start of the string table
+	guint32 strings_size;
+	bool error;                 // set once anything is out of bounds
+} IMAGE_READER;
+
+/*
+ * Gets the size and modification time of a source file.
+ * Returns false if it doesn't exist.
+ */
+static bool stat_source(const char *filename, SOURCE_STAMP *stamp)
+{
+	ALLEGRO_FS_ENTRY *entry = al_create_fs_entry(filename);
+	if (!entry || !al_fs_entry_exists(entry)) {
+		al_destroy_fs_entry(entry);
+		return false;
+	}
+
+	guint64 mtime = al_get_fs_entry_mtime(entry);
+	stamp->size = GUINT32_TO_LE((guint32)al_get_fs_entry_size(entry));
+	stamp->mtime_low = GUINT32_TO_LE((guint32)mtime);
+	stamp->mtime_high = GUINT32_TO_LE((guint32)(mtime >> 32));
+	al_destroy_fs_entry(entry);
+	return true;
+}
+
+/*
+ * Gets the checksum of a source file.
+ * Returns false if it can't be read.
+ */
+static bool checksum_source(const char *filename, SOURCE_STAMP *stamp)
+{
+	ALLEGRO_FILE *file = al_fopen(filename, "rb");
+	if (!file) {
+		return false;
+	}
+
+	unsigned char buffer[16384];
+	uLong crc = crc32(0L, Z_NULL, 0);
+	size_t len;
+	while ((len = al_fread(file, buffer, sizeof(buffer))) > 0) {
+		crc = crc32(crc, buffer, len);
+	}
+
+	al_fclose(file);
+	stamp->crc = GUINT32_TO_LE((guint32)crc);
+	return true;
+}
+
+/*
+ * Gets the stamp of a source file, as stored in an image.
+ * Returns false if it can't be read.
+ */
+static bool stamp_source(const char *filename, SOURCE_STAMP *stamp)
+{
+	return stat_source(filename, stamp) && checksum_source(filename, stamp);
+}
+
+/*
+ * Returns true if a stamp still describes the source file.
+ * An untouched file is trusted as is; one with a new modification time
+ * must still match the checksum.
+ */
+static bool is_fresh(const SOURCE_STAMP *stamp, const char *filename)
+{
+	SOURCE_STAMP source;
+	if (!stat_source(filename, &source) || source.size != stamp->size) {
+		return false;
+	}
+
+	if (source.mtime_low == stamp->mtime_low && source.mtime_high == stamp->mtime_high) {
+		return true;
+	}
+
+	return checksum_source(filename, &source) && source.crc == stamp->crc;
+}
+
+static void put_u32(IMAGE_WRITER *writer, guint32 value)
+{
+	value = GUINT32_TO_LE(value);
+	g_array_append_val(writer->records, value);
+}
+
+static void put_float(IMAGE_WRITER *writer, float value)
+{
+	union { float f; guint32 u; } bits;
+	bits.f = value;
+	put_u32(writer, bits.u);
+}
+
+/*
+ * Writes a reference to the string, adding it to the table the first
+ * time it's seen.
+ */
+static void put_string(IMAGE_WRITER *writer, const char *str)
+{
+	if (!str) {
+		put_u32(writer, NO_STRING);
+		return;
+	}
+
+	gpointer offset;
+	if (!g_hash_table_lookup_extended(writer->string_offsets, str, NULL, &offset)) {
+		offset = GUINT_TO_POINTER(writer->strings->len);
+		g_string_append_len(writer->strings, str, strlen(str) + 1);
+		g_hash_table_insert(writer->string_offsets, (gpointer)str, offset);
+	}
+
+	put_u32(writer, GPOINTER_TO_UINT(offset));
+}
+
+static void put_properties(IMAGE_WRITER *writer, PROPERTY_LIST *properties)
+{
+	if (!properties) {
+		put_u32(writer, 0);
+		return;
+	}
+
+	put_u32(writer, properties->count);
+
+	int i;
+	for (i = 0; i<properties->count; i++) {
+		put_string(writer, properties->items[i].key);
+		put_string(writer, properties->items[i].value);
+	}
+}
+
+static void put_tileset(IMAGE_WRITER *writer, ALLEGRO_MAP_TILESET *tileset)
+{
+	put_u32(writer, tileset->firstgid);
+	put_u32(writer, tileset->tilewidth);
+	put_u32(writer, tileset->tileheight);
+	put_u32(writer, tileset->width);
+	put_u32(writer, tileset->height);
+	put_string(writer, tileset->name);
+	put_string(writer, tileset->source);
+	put_string(writer, tileset->file);
+
+	put_u32(writer, g_slist_length(tileset->tiles));
+	GSList *tiles = tileset->tiles;
+	while (tiles) {
+		ALLEGRO_MAP_TILE *tile = (ALLEGRO_MAP_TILE*)tiles->data;
+		tiles = g_slist_next(tiles);
+		put_u32(writer, tile->id);
+		put_properties(writer, tile->properties);
+		put_u32(writer, tile->frame_count);
+		int i;
+		for (i = 0; i<tile->frame_count; i++) {
+			put_u32(writer, tile->frames[i].tile_id);
+			put_u32(writer, tile->frames[i].duration);
+		}
+	}
+}
+
+static void put_layer(IMAGE_WRITER *writer, ALLEGRO_MAP_LAYER *layer)
+{
+	put_u32(writer, layer->type);
+	put_string(writer, layer->name);
+	put_u32(writer, layer->visible);
+	put_float(writer, layer->opacity);
+	put_properties(writer, layer->properties);
+
+	if (layer->type == TILE_LAYER) {
+		put_u32(writer, layer->width);
+		put_u32(writer, layer->height);
+		put_u32(writer, layer->gid_size);
+		put_u32(writer, writer->data_size);
+		writer->data_size += PLANE_ALIGN(gid_plane_size(layer));
+		if (layer->flips) {
+			put_u32(writer, writer->data_size);
+			writer->data_size += PLANE_ALIGN(flip_plane_size(layer));
+		} else {
+			put_u32(writer, NO_PLANE);
+		}
+	} else {
+		put_u32(writer, layer->object_count);
+		GSList *objects = layer->objects;
+		while (objects) {
+			ALLEGRO_MAP_OBJECT *object = (ALLEGRO_MAP_OBJECT*)objects->data;
+			objects = g_slist_next(objects);
+			put_string(writer, object->name);
+			put_string(writer, object->type);
+			put_u32(writer, object->gid);
+			put_u32(writer, object->x);
+			put_u32(writer, object->y);
+			put_u32(writer, object->width);
+			put_u32(writer, object->height);
+			put_u32(writer, object->visible);
+			put_properties(writer, object->properties);
+		}
+	}
+}
+
+/*
+ * Writes a layer plane of the given element size, little-endian and
+ * padded to a multiple of 4 bytes.
+ */
+static void write_plane(ALLEGRO_FILE *file, const void *plane, size_t size, int element_size)
+{
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+	al_fwrite(file, plane, size);
+#else
+	size_t i;
+	for (i = 0; i<size; i += element_size) {
+		if (element_size == 4) {
+			al_fwrite32le(file, *(const guint32 *)((const char *)plane + i));
+		} else if (element_size == 2) {
+			al_fwrite16le(file, *(const guint16 *)((const char *)plane + i));
+		} else {
+			al_fputc(file, ((const guint8 *)plane)[i]);
+		}
+	}
+#endif
+
+	for (; size % 4; size++) {
+		al_fputc(file, 0);
+	}
+}
+
+/*
+ * Writes the path and stamp of every external tileset the map uses.
+ * Returns false if one of them can't be read.
+ */
+static bool put_tileset_files(IMAGE_WRITER *writer, ALLEGRO_MAP *map)
+{
+	guint32 count = 0;
+	GSList *tilesets = map->tilesets;
+	while (tilesets) {
+		count += ((ALLEGRO_MAP_TILESET*)tilesets->data)->file != NULL;
+		tilesets = g_slist_next(tilesets);
+	}
+	put_u32(writer, count);
+
+	tilesets = map->tilesets;
+	while (tilesets) {
+		ALLEGRO_MAP_TILESET *tileset = (ALLEGRO_MAP_TILESET*)tilesets->data;
+		tilesets = g_slist_next(tilesets);
+		if (!tileset->file) {
+			continue;
+		}
+
+		SOURCE_STAMP stamp;
+		if (!stamp_source(tileset->file, &stamp)) {
+			fprintf(stderr, "Error: can't read tileset file: %s\n", tileset->file);
+			return false;
+		}
+
+		// already little-endian
+		put_string(writer, tileset->file);
+		g_array_append_vals(writer->records, &stamp, sizeof(stamp) / sizeof(guint32));
+	}
+
+	return true;
+}
+
+/*
+ * Writes a compiled image of the map to the given file, stamped with
+ * the size, modification time and checksum of the map file it was read
+ * from, and of every external tileset it uses, so that
+ * al_open_compiled_map() can tell when it's out of date.
+ * Returns false if the image couldn't be written.
+ */
+bool al_compile_map(ALLEGRO_MAP *map, const char *filename)
+{
+	COMPILED_HEADER header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, COMPILED_MAGIC, sizeof(header.magic));
+	header.version = GUINT32_TO_LE(COMPILED_VERSION);
+	if (!map->source || !stamp_source(map->source, &header.source)) {
+		fprintf(stderr, "Error: can't compile a map without its source file\n");
+		return false;
+	}
+	if (map->infinite) {
+		// chunks are already packed in memory, so there'd be little to gain
+		fprintf(stderr, "Error: can't compile an infinite map\n");
+		return false;
+	}
+
+	IMAGE_WRITER writer;
+	writer.records = g_array_new(FALSE, FALSE, sizeof(guint32));
+	writer.strings = g_string_new(NULL);
+	writer.string_offsets = g_hash_table_new(&g_str_hash, &g_str_equal);
+	writer.data_size = 0;
+
+	if (!put_tileset_files(&writer, map)) {
+		g_array_free(writer.records, TRUE);
+		g_string_free(writer.strings, TRUE);
+		g_hash_table_unref(writer.string_offsets);
+		return false;
+	}
+
+	put_u32(&writer, map->width);
+	put_u32(&writer, map->height);
+	put_u32(&writer, map->tile_width);
+	put_u32(&writer, map->tile_height);
+	put_string(&writer, map->orientation);
+	put_u32(&writer, map->stagger_x);
+	put_u32(&writer, map->stagger_even);
+	put_u32(&writer, map->hex_side_length);
+
+	put_u32(&writer, g_slist_length(map->tilesets));
+	GSList *tilesets = map->tilesets;
+	while (tilesets) {
+		put_tileset(&writer, (ALLEGRO_MAP_TILESET*)tilesets->data);
+		tilesets = g_slist_next(tilesets);
+	}
+
+	put_u32(&writer, g_slist_length(map->layers));
+	GSList *layers = map->layers;
+	while (layers) {
+		put_layer(&writer, (ALLEGRO_MAP_LAYER*)layers->data);
+		layers = g_slist_next(layers);
+	}
+
+	// pad the string table so the image stays a multiple of 4 bytes
+	while (writer.strings->len % 4) {
+		g_string_append_c(writer.strings, '\0');
+	}
+
+	header.records_size = GUINT32_TO_LE(writer.records->len * sizeof(guint32));
+	header.data_size = GUINT32_TO_LE(writer.data_size);
+	header.strings_size = GUINT32_TO_LE(writer.strings->len);
+
+	// written beside the image and renamed over it, so maps that still
+	// have the old one mapped never see it truncated, and a failed write
+	// never leaves half an image behind
+	bool success = false;
+	char *temp = g_strdup_printf("%s.XXXXXX", filename);
+	int fd = g_mkstemp(temp);
+	ALLEGRO_FILE *file = NULL;
+	if (fd != -1) {
+		close(fd);
+		file = al_fopen(temp, "wb");
+	}
+	if (file) {
+		al_fwrite(file, &header, sizeof(header));
+		al_fwrite(file, writer.records->data, writer.records->len * sizeof(guint32));
+
+		layers = map->tile_layers;
+		while (layers) {
+			ALLEGRO_MAP_LAYER *layer = (ALLEGRO_MAP_LAYER*)layers->data;
+			layers = g_slist_next(layers);
+			write_plane(file, layer->gids, gid_plane_size(layer), layer->gid_size);
+			if (layer->flips) {
+				write_plane(file, layer->flips, flip_plane_size(layer), 1);
+			}
+		}
+
+		al_fwrite(file, writer.strings->str, writer.strings->len);
+		success = !al_ferror(file);
+		al_fclose(file);
+		success = success && g_rename(temp, filename) == 0;
+	}
+
+	if (!success) {
+		fprintf(stderr, "Error: failed to write compiled map: %s\n", filename);
+		if (fd != -1) {
+			g_remove(temp);
+		}
+	}
+	g_free(temp);
+
+	g_array_free(writer.records, TRUE);
+	g_string_free(writer.strings, TRUE);
+	g_hash_table_unref(writer.string_offsets);
+	return success;
+}
+
+static guint32 get_u32(IMAGE_READER *reader)
+{
+	if (reader->pos >= reader->end) {
+		reader->error = true;
+		return 0;
+	}
+
+	return GUINT32_FROM_LE(*reader->pos++);
+}
+
+static float get_float(IMAGE_READER *reader)
+{
+	union { float f; guint32 u; } bits;
+	bits.u = get_u32(reader);
+	return bits.f;
+}
+
+/*
+ * Reads a string reference and returns the string where it lies in
+ * the image, which stays mapped for as long as the map is open.
+ */
+static char *get_string(IMAGE_READER *reader)
+{
+	guint32 offset = get_u32(reader);
+	if (offset == NO_STRING) {
+		return NULL;
+	}
+	if (offset >= reader->strings_size) {
+		reader->error = true;
+		return NULL;
+	}
+
+	return (char *)reader->strings + offset;
+}
+
+/*
+ * Reads a property list. Values point into the image; names are interned.
+ */
+static PROPERTY_LIST *get_properties(IMAGE_READER *reader, ALLEGRO_MAP *map)
+{
+	guint32 i, count = get_u32(reader);
+	if (count == 0) {
+		return NULL;
+	}
+
+	GArray *properties = g_array_sized_new(FALSE, FALSE, sizeof(PROPERTY), MIN(count, 64));
+	for (i = 0; i<count && !reader->error; i++) {
+		char *key = get_string(reader);
+		char *value = get_string(reader);
+		if (key) {
+			add_property(properties, key, value ? value : "");
+		}
+	}
+
+	PROPERTY_LIST *list = create_property_list(map->arena, properties);
+	g_array_free(properties, TRUE);
+	return list;
+}
+
+static ALLEGRO_MAP_TILESET *get_tileset(IMAGE_READER *reader, ALLEGRO_MAP *map)
+{
+	ALLEGRO_MAP_TILESET *tileset = ARENA_NEW(map->arena, ALLEGRO_MAP_TILESET);
+	tileset->firstgid = get_u32(reader);
+	tileset->tilewidth = get_u32(reader);
+	tileset->tileheight = get_u32(reader);
+	tileset->width = get_u32(reader);
+	tileset->height = get_u32(reader);
+	tileset->name = get_string(reader);
+	tileset->source = get_string(reader);
+	tileset->file = get_string(reader);
+	if (tileset->source) {
+		attach_tileset_image(tileset);
+	}
+
+	guint32 i, count = get_u32(reader);
+	for (i = 0; i<count && !reader->error; i++) {
+		ALLEGRO_MAP_TILE *tile = ARENA_NEW(map->arena, ALLEGRO_MAP_TILE);
+		guint32 id = get_u32(reader);
+		tile->id = id;
+		tile->tileset = tileset;
+		if (!tileset_has_tile(tileset, (int)(id - (guint32)tileset->firstgid))) {
+			// the tile list is indexed by id, so it can't be out of range
+			reader->error = true;
+		}
+		tile->properties = get_properties(reader, map);
+		guint32 j, frame_count = get_u32(reader);
+		if (frame_count > (guint32)(reader->end - reader->pos) / 2) {
+			// more frames than there are records left
+			reader->error = true;
+		} else if (frame_count) {
+			tile->frames = (ANIMATION_FRAME *)arena_alloc(map->arena, frame_count * sizeof(ANIMATION_FRAME));
+			tile->frame_count = frame_count;
+			for (j = 0; j<frame_count; j++) {
+				tile->frames[j].tile_id = get_u32(reader);
+				tile->frames[j].duration = get_u32(reader);
+			}
+		}
+		tileset->tiles = arena_slist_prepend(map->arena, tileset->tiles, tile);
+	}
+
+	return tileset;
+}
+
+/*
+ * Returns true if a plane of the given size lies inside the image.
+ */
+static bool plane_in_image(IMAGE_READER *reader, guint32 offset, size_t size)
+{
+	return offset <= reader->data_size && size <= reader->data_size - offset;
+}
+
+/*
+ * Gets a plane of the given element size out of the image.
+ */
+static void *get_plane(IMAGE_READER *reader, ALLEGRO_MAP *map, guint32 offset, size_t size, int element_size)
+{
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+	// the image is already in our byte order, so use it where it lies
+	return (void *)(reader->data + offset);
+#else
+	if (element_size == 1) {
+		return (void *)(reader->data + offset);
+	}
+
+	void *plane = arena_alloc(map->arena, size);
+	size_t i;
+	for (i = 0; i<size; i += element_size) {
+		if (element_size == 4) {
+			*(guint32 *)((char *)plane + i) = GUINT32_FROM_LE(*(const guint32 *)(reader->data + offset + i));
+		} else {
+			*(guint16 *)((char *)plane + i) = GUINT16_FROM_LE(*(const guint16 *)(reader->data + offset + i));
+		}
+	}
+	return plane;
+#endif
+}
+
+static ALLEGRO_MAP_LAYER *get_layer(IMAGE_READER *reader, ALLEGRO_MAP *map)
+{
+	ALLEGRO_MAP_LAYER *layer = ARENA_NEW(map->arena, ALLEGRO_MAP_LAYER);
+	layer->type = get_u32(reader) == TILE_LAYER ? TILE_LAYER : OBJECT_LAYER;
+	layer->name = get_string(reader);
+	layer->visible = get_u32(reader);
+	layer->opacity = get_float(reader);
+	layer->properties = get_properties(reader, map);
+
+	if (layer->type == TILE_LAYER) {
+		layer->width = get_u32(reader);
+		layer->height = get_u32(reader);
+		layer->gid_size = get_u32(reader);
+		guint32 gids_offset = get_u32(reader);
+		guint32 flips_offset = get_u32(reader);
+		if ((layer->gid_size != 1 && layer->gid_size != 2 && layer->gid_size != 4)
+				|| !plane_in_image(reader, gids_offset, gid_plane_size(layer))
+				|| (flips_offset != NO_PLANE && !plane_in_image(reader, flips_offset, flip_plane_size(layer)))) {
+			reader->error = true;
+			layer->width = layer->height = 0;
+			layer->gid_size = 1;
+			gids_offset = 0;
+			flips_offset = NO_PLANE;
+		}
+
+		// the flip plane is bytes, so it can always be used where it lies
+		layer->gids = get_plane(reader, map, gids_offset, gid_plane_size(layer), layer->gid_size);
+		if (flips_offset != NO_PLANE) {
+			layer->flips = (guint8 *)(reader->data + flips_offset);
+		}
+
+		map->tile_layer_count++;
+		map->tile_layers = arena_slist_prepend(map->arena, map->tile_layers, layer);
+	} else {
+		guint32 i, count = get_u32(reader);
+		for (i = 0; i<count && !reader->error; i++) {
+			ALLEGRO_MAP_OBJECT *object = ARENA_NEW(map->arena, ALLEGRO_MAP_OBJECT);
+			object->layer = layer;
+			object->name = get_string(reader);
+			object->type = get_string(reader);
+			object->gid = get_u32(reader);
+			object->x = get_u32(reader);
+			object->y = get_u32(reader);
+			object->width = get_u32(reader);
+			object->height = get_u32(reader);
+			object->visible = get_u32(reader);
+			object->properties = get_properties(reader, map);
+			layer->objects = arena_slist_prepend(map->arena, layer->objects, object);
+			layer->object_count++;
+		}
+		layer->objects = g_slist_reverse(layer->objects);
+
+		map->object_layer_count++;
+		map->object_layers = arena_slist_prepend(map->arena, map->object_layers, layer);
+	}
+
+	return layer;
+}
+
+/*
+ * Reads the external tilesets an image was compiled with, and returns
+ * true if they're all as they were. A stale or corrupt list gives false.
+ */
+static bool tileset_files_fresh(IMAGE_READER *reader)
+{
+	guint32 i, count = get_u32(reader);
+	for (i = 0; i<count && !reader->error; i++) {
+		const char *file = get_string(reader);
+		SOURCE_STAMP stamp;
+		stamp.size = GUINT32_TO_LE(get_u32(reader));
+		stamp.mtime_low = GUINT32_TO_LE(get_u32(reader));
+		stamp.mtime_high = GUINT32_TO_LE(get_u32(reader));
+		stamp.crc = GUINT32_TO_LE(get_u32(reader));
+		if (!file || reader->error || !is_fresh(&stamp, file)) {
+			return false;
+		}
+	}
+
+	return !reader->error;
+}
+
+/*
+ * Loads a compiled image, provided it was compiled from the given map
+ * file and external tilesets as they are now.
+ * Returns NULL if the image is missing, stale or corrupt.
+ */
+static ALLEGRO_MAP *load_compiled_map(const char *cache, const char *filename)
+{
+	if (!al_filename_exists(cache)) {
+		return NULL;
+	}
+
+	// writable mappings are private, so edits to layer data never reach the file
+	GMappedFile *image = g_mapped_file_new(cache, TRUE, NULL);
+	if (!image) {
+		return NULL;
+	}
+
+	const char *contents = g_mapped_file_get_contents(image);
+	gsize length = g_mapped_file_get_length(image);
+	const COMPILED_HEADER *header = (const COMPILED_HEADER *)contents;
+	if (length < sizeof(COMPILED_HEADER)
+			|| memcmp(header->magic, COMPILED_MAGIC, sizeof(header->magic))
+			|| GUINT32_FROM_LE(header->version) != COMPILED_VERSION) {
+		g_mapped_file_unref(image);
+		return NULL;
+	}
+
+	guint64 records_size = GUINT32_FROM_LE(header->records_size);
+	guint64 data_size = GUINT32_FROM_LE(header->data_size);
+	guint64 strings_size = GUINT32_FROM_LE(header->strings_size);
+	if (!is_fresh(&header->source, filename) || sizeof(COMPILED_HEADER) + records_size + data_size + strings_size != length
+			|| strings_size == 0 || contents[length - 1] != '\0') {
+		g_mapped_file_unref(image);
+		return NULL;
+	}
+
+	IMAGE_READER reader;
+	reader.pos = (const guint32 *)(contents + sizeof(COMPILED_HEADER));
+	reader.end = reader.pos + records_size / sizeof(guint32);
+	reader.data = (const char *)reader.end;
+	reader.data_size = data_size;
+	reader.strings = reader.data + data_size;
+	reader.strings_size = strings_size;
+	reader.error = false;
+
+	if (!tileset_files_fresh(&reader)) {
+		g_mapped_file_unref(image);
+		return NULL;
+	}
+
+	ALLEGRO_MAP *map = create_map();
+	map->image = image;
+	map->width = get_u32(&reader);
+	map->height = get_u32(&reader);
+	map->tile_width = get_u32(&reader);
+	map->tile_height = get_u32(&reader);
+	map->orientation = get_string(&reader);
+	map->stagger_x = get_u32(&reader);
+	map->stagger_even = get_u32(&reader);
+	map->hex_side_length = get_u32(&reader);
+
+	guint32 i, count = get_u32(&reader);
+	for (i = 0; i<count && !reader.error; i++) {
+		map->tilesets = arena_slist_prepend(map->arena, map->tilesets, get_tileset(&reader, map));
+	}
+
+	count = get_u32(&reader);
+	for (i = 0; i<count && !reader.error; i++) {
+		map->layers = arena_slist_prepend(map->arena, map->layers, get_layer(&reader, map));
+	}
+
+	map->tilesets = g_slist_reverse(map->tilesets);
+	map->layers = g_slist_reverse(map->layers);
+	map->tile_layers = g_slist_reverse(map->tile_layers);
+	map->object_layers = g_slist_reverse(map->object_layers);
+
+	if (reader.error) {
+		fprintf(stderr, "Error: corrupt compiled map: %s\n", cache);
+		al_free_map(map);
+		return NULL;
+	}
+
+	return map;
+}
+
+/*
+ * Opens a map through its compiled image. If the image is missing or
+ * was compiled from an older version of the map file or of one of its
+ * external tilesets, the map is parsed normally and the image is
+ * rewritten.
+ * Both filename and cache are relative to dir, as with al_open_map().
+ */
+ALLEGRO_MAP *al_open_compiled_map(const char *dir, const char *filename, const char *cache)
+{
+	ALLEGRO_PATH *cwd = enter_map_directory(dir);
+	char *cache_path = resolve_map_path(cache);
+
+	ALLEGRO_MAP *map = load_compiled_map(cache, filename);
+	if (map) {
+		char *source = resolve_map_path(filename);
+		map->source = arena_strdup(map->arena, source);
+		g_free(source);
+		finish_map(map);
+	}
+
+	leave_map_directory(cwd);
+
+	if (!map) {
+		map = al_open_map(dir, filename);
+		if (map && !map->infinite) {
+			al_compile_map(map, cache_path);
+		}
+	}
+
+	g_free(cache_path);
+	return map;
+}
@@ -0,0 +1,73 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ */
+
+#ifndef _COMPILED_H
+#define _COMPILED_H
+
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_tiled.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <unistd.h>
+#include <zlib.h>
+#include "data.h"
+#include "parser.h"
+#include "plane.h"
+
+// "ATMC" followed by the format version
+#define COMPILED_MAGIC "ATMC"
+#define COMPILED_VERSION 5
+
+// string reference used for NULL strings
+#define NO_STRING 0xFFFFFFFFu
+
+// plane reference used for layers without a flip plane
+#define NO_PLANE 0xFFFFFFFFu
+
+// rounds a plane's size up so the next one starts 4-byte aligned
+#define PLANE_ALIGN(size) (((size) + 3) & ~(size_t)3)
+
+/*
+ * What a source file looked like when an image was compiled from it.
+ */
+typedef struct {
+	guint32 size;               // size of the file in bytes
+	guint32 mtime_low;          // modification time of the file
+	guint32 mtime_high;
+	guint32 crc;                // crc32 of the file
+} SOURCE_STAMP;
+
+/*
+ * Fixed header at the start of a compiled map image.
+ * Every field is stored little-endian, and every section that follows
+ * is a multiple of 4 bytes so the layer planes can be used in place.
+ * The records start with the path and stamp of every external tileset
+ * the map uses.
+ */
+typedef struct {
+	char magic[4];
+	guint32 version;
+	SOURCE_STAMP source;        // the map file
+	guint32 records_size;       // bytes of records after the header
+	guint32 data_size;          // bytes of layer planes after the records
+	guint32 strings_size;       // bytes of string table after the layer planes
+} COMPILED_HEADER;
+
+bool al_compile_map(ALLEGRO_MAP *map, const char *filename);
+ALLEGRO_MAP *al_open_compiled_map(const char *dir, const char *filename, const char *cache);
+
+#endif
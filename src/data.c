@@ -20,6 +20,17 @@
  */
 
 #include "data.h"
+#include "cache.h"
+#include "atlas.h"
+#include "chunk.h"
+#include "plane.h"
+#include "span.h"
+#include "grid.h"
+#include "anim.h"
+#include "query.h"
+#include "render.h"
+#include "scroll.h"
+#include "vertex.h"
 
 /*
  * Get the map's width in tiles.
@@ -55,13 +66,31 @@ int al_get_tile_height(ALLEGRO_MAP *map)
 
 /*
  * Get the map's orientation.
- * Should be either "orthogonal" or "isometric".
+ * One of "orthogonal", "isometric", "staggered" or "hexagonal".
  */
 char *al_get_map_orientation(ALLEGRO_MAP *map)
 {
 	return map->orientation;
 }
 
+/*
+ * Get whether the map is infinite, in which case its tile layers are
+ * stored as chunks that must be streamed in with al_stream_map_chunks.
+ */
+bool al_get_map_infinite(ALLEGRO_MAP *map)
+{
+	return map->infinite;
+}
+
+/*
+ * Get the number of tiles whose bitmaps have been created so far.
+ * With ALLEGRO_MAP_LAZY_TILES this grows as tiles are first drawn or looked up.
+ */
+int al_get_map_materialized_tiles(ALLEGRO_MAP *map)
+{
+	return map->materialized_tiles;
+}
+
 /*
  * Get the map's layer corresponding to the given name.
  */
@@ -176,57 +205,68 @@ bool al_get_object_visible(ALLEGRO_MAP_OBJECT *object)
 	return object->visible;
 }
 
-void _al_free_tile(gpointer data)
+/*
+ * Creates an empty map, along with the arena that everything parsed
+ * into it is allocated from.
+ */
+ALLEGRO_MAP *create_map(void)
 {
-	ALLEGRO_MAP_TILE *tile = (ALLEGRO_MAP_TILE*)data;
-	g_hash_table_unref(tile->properties);
-	al_destroy_bitmap(tile->bitmap);
-	al_free(tile);
+	ARENA *arena = create_arena();
+	ALLEGRO_MAP *map = ARENA_NEW(arena, ALLEGRO_MAP);
+	map->arena = arena;
+	return map;
 }
 
-void _al_free_tileset(gpointer data)
+/*
+ * Frees a map struct from memory
+ * Nearly everything in it lives in its arena, so only what's held
+ * outside of it needs walking: tileset images, layer planes, chunks,
+ * tile queries, render caches, scroll surfaces, vertex arrays, the draw
+ * bitmap table, animations and atlas bitmaps.
+ */
+void al_free_map(ALLEGRO_MAP *map)
 {
-	ALLEGRO_MAP_TILESET *tileset = (ALLEGRO_MAP_TILESET*)data;
-	al_free(tileset->name);
-	al_free(tileset->source);
-	g_slist_free_full(tileset->tiles, &_al_free_tile);
-	al_destroy_bitmap(tileset->bitmap);
-	al_free(tileset);
-}
+	free_tile_queries(map);
+	free_scroll_surfaces(map);
 
-void _al_free_object(gpointer data)
-{
-	ALLEGRO_MAP_OBJECT *object = (ALLEGRO_MAP_OBJECT*)data;
-	if (!object) {
-		return;
+	GSList *tilesets = map->tilesets;
+	while (tilesets) {
+		ALLEGRO_MAP_TILESET *tileset = (ALLEGRO_MAP_TILESET*)tilesets->data;
+		tilesets = g_slist_next(tilesets);
+		release_tileset_image(tileset->image);
 	}
-	al_free(object->name);
-	al_free(object->type);
-	g_hash_table_unref(object->properties);
-	al_free(object);
-}
 
-void _al_free_layer(gpointer data)
-{
-	ALLEGRO_MAP_LAYER *layer = (ALLEGRO_MAP_LAYER*)data;
-	al_free(layer->name);
-	if (layer->type == TILE_LAYER) {
+	GSList *layers = map->layers;
+	while (layers) {
+		ALLEGRO_MAP_LAYER *layer = (ALLEGRO_MAP_LAYER*)layers->data;
+		layers = g_slist_next(layers);
+		if (layer->chunks) {
+			free_chunk_table(layer->chunks);
+		}
+		// only set if the map failed to load before its layers were packed
 		al_free(layer->data);
-	} else if (layer->type == OBJECT_LAYER) {
-		g_slist_free_full(layer->objects, &_al_free_object);
+		free_layer_planes(layer);
+		free_layer_spans(layer);
+		free_object_grid(layer);
+		free_render_cache(layer);
+		free_vertex_cache(layer);
 	}
-	g_hash_table_unref(layer->properties);
-	al_free(layer);
-}
 
-/*
- * Frees a map struct from memory
- */
-void al_free_map(ALLEGRO_MAP *map)
-{
-	al_free(map->orientation);
-	g_slist_free_full(map->tilesets, &_al_free_tileset);
-	g_slist_free_full(map->layers, &_al_free_layer);
-	g_hash_table_unref(map->tiles);
-	al_free(map);
+	free_vertex_tiles(map);
+	al_free(map->draw_bitmaps);
+	free_map_animations(map);
+
+	free_map_atlas(map);
+	if (map->image) {
+		g_mapped_file_unref(map->image);
+	}
+
+	GSList *arenas = map->shared_arenas;
+	while (arenas) {
+		unref_arena((ARENA*)arenas->data);
+		arenas = g_slist_next(arenas);
+	}
+
+	// the map itself lives in its arena
+	unref_arena(map->arena);
 }
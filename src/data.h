@@ -4,20 +4,66 @@
 #include <allegro5/allegro.h>
 #include <allegro5/allegro_tiled.h>
 #include <glib.h>
+#include "arena.h"
+
+typedef struct _TILESET_IMAGE TILESET_IMAGE;
+typedef struct _LAYER_CHUNK LAYER_CHUNK;
+typedef struct _CHUNK_TABLE CHUNK_TABLE;
+typedef struct _PROPERTY_LIST PROPERTY_LIST;
+typedef struct _RENDER_CACHE RENDER_CACHE;
+typedef struct _VERTEX_TILE VERTEX_TILE;
+typedef struct _VERTEX_CACHE VERTEX_CACHE;
+typedef struct _LAYER_SPANS LAYER_SPANS;
+typedef struct _OBJECT_GRID OBJECT_GRID;
+typedef struct _ANIMATION_FRAME ANIMATION_FRAME;
+typedef struct _MAP_ANIMATIONS MAP_ANIMATIONS;
+
+// Allocates a zeroed struct of the given type
+#define MALLOC(x) (x *)al_calloc(1, sizeof(x))
+
+// How a map's cells are laid out, parsed from its orientation
+enum MapOrientation {
+	ORIENTATION_UNKNOWN,
+	ORIENTATION_ORTHOGONAL,
+	ORIENTATION_ISOMETRIC,
+	ORIENTATION_STAGGERED,
+	ORIENTATION_HEXAGONAL
+};
 
 struct _ALLEGRO_MAP
 {
 	int width, height;          // dimensions in tiles
 	int tile_width;             // width of each tile in pixels
 	int tile_height;            // height of each tile in pixels
-	char *orientation;          // "orthogonal" or ... isometric?
+	char *orientation;          // "orthogonal", "isometric", "staggered" or "hexagonal"
+	enum MapOrientation orientation_kind; // orientation, parsed once the map is finished
+	bool stagger_x;             // staggered along x, shifting every other column rather than row
+	bool stagger_even;          // the even rows or columns are shifted rather than the odd ones
+	int hex_side_length;        // length of the flat side of a hexagonal map's cells in pixels
+	bool infinite;              // layers are stored as chunks
 	GSList *layers;             // list of all layers
 	GSList *tile_layers;        // list of tile layers
 	GSList *object_layers;      // list of object layers
 	GSList *tilesets;           // list of tilesets
 	int tile_layer_count;       // number of tile layers
 	int object_layer_count;     // number of object layers
-	GHashTable *tiles;          // full list of tiles
+	ALLEGRO_MAP_TILE **tiles;   // full list of tiles, indexed by gid
+	int tiles_length;           // number of entries in tiles
+	int materialized_tiles;     // number of tiles whose bitmaps have been created
+	GSList *atlases;            // bitmaps every tileset was packed into, if any
+	ALLEGRO_BITMAP **atlas_tiles; // tile bitmaps in the atlases, indexed by gid
+	int *atlas_origins;         // x and y of each tile in its atlas, two per gid
+	char *source;               // path of the map file it was read from
+	GMappedFile *image;         // compiled image backing the layer data, if any
+	ARENA *arena;               // memory for everything parsed out of the map file
+	GSList *shared_arenas;      // arenas of external tilesets it borrows from
+	GSList *queries;            // tile queries compiled against the map
+	int render_chunk_size;      // size of render cache chunks in pixels, or 0 to draw directly
+	bool vertex_arrays;         // draw tile layers with al_draw_prim
+	VERTEX_TILE *vertex_tiles;  // texture coordinates of each tile, indexed by gid
+	ALLEGRO_BITMAP **draw_bitmaps; // bitmap drawn for each gid, NULL until first drawn
+	MAP_ANIMATIONS *animations; // animated tiles and the cells showing them, or NULL if none animate
+	GSList *scroll_surfaces;    // scroll surfaces drawing the map
 };
 
 struct _ALLEGRO_MAP_LAYER
@@ -28,10 +74,19 @@ struct _ALLEGRO_MAP_LAYER
 	float opacity;              // the layer's opacity
 	bool visible;               // 0 for hidden, 1 for visible
 	char *name;                 // name of the layer
-	int *data;                  // decoded data (tile layer only)
+	int *data;                  // decoded ids with their flip flags, only while loading
+	void *gids;                 // gid of each cell, gid_size bytes apiece (tile layer only)
+	int gid_size;               // 1, 2 or 4
+	guint8 *flips;              // flip flags, a nibble per cell, or NULL if none are flipped
+	int owned_planes;           // PLANE_* flags of the planes allocated for the layer
+	LAYER_SPANS *spans;         // runs of occupied cells in each row
+	CHUNK_TABLE *chunks;        // chunks, in place of data (infinite maps only)
+	RENDER_CACHE *render_cache; // pre-rendered chunks, set up on first draw
+	VERTEX_CACHE *vertices;     // vertex arrays, set up on first draw
 	GSList *objects;            // objects (object layer only)
 	int object_count;           // number of objects (object layer only)
-	GHashTable *properties;     // properties
+	OBJECT_GRID *object_grid;   // objects by position (object layer only)
+	PROPERTY_LIST *properties;  // properties, or NULL if there are none
 };
 
 struct _ALLEGRO_MAP_TILESET
@@ -42,7 +97,9 @@ struct _ALLEGRO_MAP_TILESET
 	int width, height;          // total dimensions (in pixels)
 	char *name;                 // name
 	char *source;               // path to this tileset's image source
+	char *file;                 // resolved path of the .tsx file it was read from, or NULL if embedded
 	ALLEGRO_BITMAP *bitmap;     // image for this tileset
+	TILESET_IMAGE *image;       // shared cache entry holding the image
 	GSList *tiles;              // list of tiles
 };
 
@@ -50,8 +107,11 @@ struct _ALLEGRO_MAP_TILE
 {
 	int id;                       // the tile id
 	ALLEGRO_MAP_TILESET *tileset; // pointer to its tileset
-	GHashTable *properties;       // tile properties
-	ALLEGRO_BITMAP *bitmap;       // this tile's image
+	PROPERTY_LIST *properties;    // tile properties, or NULL if there are none
+	ALLEGRO_BITMAP *bitmap;       // this tile's image, owned by the tileset image or atlas
+	bool materialized;            // its bitmap has been looked up, even if there was none
+	ANIMATION_FRAME *frames;      // animation frames, or NULL if it doesn't animate
+	int frame_count;              // number of animation frames
 };
 
 struct _ALLEGRO_MAP_OBJECT
@@ -60,11 +120,12 @@ struct _ALLEGRO_MAP_OBJECT
 	char *name;
 	char *type;
 	int gid;
+	int index;
 	int x, y;
 	int width, height;
 	bool visible;
 	ALLEGRO_BITMAP *bitmap;
-	GHashTable *properties;
+	PROPERTY_LIST *properties;
 };
 
 int al_get_map_width(ALLEGRO_MAP *map);
@@ -72,6 +133,8 @@ int al_get_map_height(ALLEGRO_MAP *map);
 int al_get_map_height(ALLEGRO_MAP *map);
 int al_get_tile_height(ALLEGRO_MAP *map);
 char *al_get_map_orientation(ALLEGRO_MAP *map);
+bool al_get_map_infinite(ALLEGRO_MAP *map);
+int al_get_map_materialized_tiles(ALLEGRO_MAP *map);
 ALLEGRO_MAP_LAYER *al_get_map_layer(ALLEGRO_MAP *map, char *name);
 int al_get_layer_width(ALLEGRO_MAP_LAYER *layer);
 int al_get_layer_height(ALLEGRO_MAP_LAYER *layer);
@@ -90,10 +153,7 @@ int al_get_object_height(ALLEGRO_MAP_OBJECT *object);
 void al_get_object_dims(ALLEGRO_MAP_OBJECT *object, int *width, int *height);
 bool al_get_object_visible(ALLEGRO_MAP_OBJECT *object);
 
-void _al_free_tile(gpointer data);
-void _al_free_tileset(gpointer data);
-void _al_free_object(gpointer data);
-void _al_free_layer(gpointer data);
+ALLEGRO_MAP *create_map(void);
 void al_free_map(ALLEGRO_MAP *map);
 
 #endif
@@ -0,0 +1,458 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ *
+ *                               ---
+ *
+ * Methods for decoding the contents of a layer's <data> node.
+ */
+
+#include "decode.h"
+
+#if defined(__SSE2__) && G_BYTE_ORDER == G_LITTLE_ENDIAN
+#  include <emmintrin.h>
+#  define USE_SSE2
+#endif
+
+#define MAX_GID 0xFFFFFFFFu
+
+/*
+ * Layer data waiting to be decoded by the queue's thread pool.
+ */
+typedef struct {
+	ALLEGRO_MAP_LAYER *layer;
+	char *encoding;
+	char *compression;
+	char *str;
+} DECODE_JOB;
+
+struct _DECODE_QUEUE {
+	GThreadPool *pool;          // NULL when decoding on the calling thread
+	gint failed;                // set once any layer fails to decode, from any thread
+};
+
+static inline bool is_digit(char c)
+{
+	return (unsigned char)(c - '0') < 10;
+}
+
+static inline bool is_separator(char c)
+{
+	return c == ',' || c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+/*
+ * Reads the run of digits at p, stopping at end.
+ * Stores the value (saturated past MAX_GID) and returns the run length.
+ */
+static inline size_t parse_digits(const char *p, const char *end, guint64 *value)
+{
+	const char *start = p;
+	guint64 result = 0;
+	while (p < end && is_digit(*p)) {
+		if (result <= MAX_GID) {
+			result = result * 10 + (*p - '0');
+		}
+		p++;
+	}
+
+	*value = result;
+	return p - start;
+}
+
+#ifdef USE_SSE2
+/*
+ * Returns a mask with bit i set if p[i] is a digit, for 16 bytes at p.
+ */
+static inline unsigned digit_mask(const char *p)
+{
+	__m128i chunk = _mm_loadu_si128((const __m128i *)p);
+	// move '0'..'9' to the bottom of the signed range so one compare finds them
+	__m128i shifted = _mm_sub_epi8(chunk, _mm_set1_epi8((char)('0' + 0x80)));
+	__m128i digits = _mm_cmplt_epi8(shifted, _mm_set1_epi8((char)(-0x80 + 10)));
+	return _mm_movemask_epi8(digits);
+}
+
+/*
+ * Converts 1 to 8 digits at p in three multiplies.
+ * At least 8 bytes must be readable at p.
+ */
+static inline guint64 parse_eight_digits(const char *p, size_t len)
+{
+	guint64 chunk;
+	memcpy(&chunk, p, sizeof(chunk));
+
+	// drop whatever follows the digits; the zeroed low bytes act as leading zeros
+	chunk <<= (8 - len) * 8;
+	chunk &= 0x0F0F0F0F0F0F0F0Full;
+	chunk = (chunk * 10 + (chunk >> 8)) & 0x00FF00FF00FF00FFull;
+	chunk = (chunk * 100 + (chunk >> 16)) & 0x0000FFFF0000FFFFull;
+	return (chunk * 10000 + (chunk >> 32)) & 0xFFFFFFFFull;
+}
+#endif
+
+/*
+ * Reads comma- or whitespace-separated gids from str into data, keeping
+ * their flip bits. At most datalen gids are stored, but all are counted.
+ * Returns the number of gids found, or -1 if the text holds anything
+ * else or a gid doesn't fit in 32 bits.
+ */
+static int scan_gids(const char *str, size_t len, int *data, int datalen)
+{
+	const char *p = str;
+	const char *end = str + len;
+	int count = 0;
+
+	while (p < end) {
+		if (is_separator(*p)) {
+			p++;
+			continue;
+		}
+
+		guint64 value;
+		size_t n;
+#ifdef USE_SSE2
+		if (end - p >= 16) {
+			// a non-digit here leaves n at 0, which the check below rejects
+			n = __builtin_ctz(~digit_mask(p) | 0x10000);
+			if (n == 0) {
+				value = 0;
+			} else if (n <= 8) {
+				value = parse_eight_digits(p, n);
+			} else {
+				n = parse_digits(p, end, &value);
+			}
+		} else
+#endif
+		{
+			n = parse_digits(p, end, &value);
+		}
+
+		if (n == 0 || value > MAX_GID) {
+			return -1;
+		}
+
+		if (count < datalen) {
+			data[count] = (int)(guint32)value;
+		}
+		count++;
+		p += n;
+	}
+
+	return count;
+}
+
+/*
+ * Parses a single gid such as a <tile> node's "gid" attribute.
+ * Returns false if it isn't a valid 32-bit unsigned number.
+ */
+bool parse_gid(const char *str, int *gid)
+{
+	*gid = 0;
+	return str && scan_gids(str, strlen(str), gid, 1) == 1;
+}
+
+// 6-bit value of each base64 character; -2 marks whitespace, -3 padding
+#define BASE64_SPACE -2
+#define BASE64_PAD -3
+static const signed char base64_values[256] = {
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -2, -2, -1, -1, -2, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 62, -1, -1, -1, 63,
+	52, 53, 54, 55, 56, 57, 58, 59, 60, 61, -1, -1, -1, -3, -1, -1,
+	-1,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+	15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, -1,
+	-1, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+	41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+};
+
+#ifdef USE_SSE2
+/*
+ * Decodes 16 base64 characters into 12 bytes, writing 13 bytes at dest.
+ * Returns false, writing nothing, if any of them isn't in the alphabet.
+ */
+static inline bool decode_base64_block(const char *src, unsigned char *dest)
+{
+	__m128i c = _mm_loadu_si128((const __m128i *)src);
+
+	// classify every byte; anything >= 0x80 is negative and matches no range
+	__m128i upper = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('Z' + 1)));
+	__m128i lower = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('z' + 1)));
+	__m128i digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+	__m128i plus = _mm_cmpeq_epi8(c, _mm_set1_epi8('+'));
+	__m128i slash = _mm_cmpeq_epi8(c, _mm_set1_epi8('/'));
+
+	__m128i valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(_mm_or_si128(digit, plus), slash));
+	if (_mm_movemask_epi8(valid) != 0xFFFF) {
+		return false;
+	}
+
+	// translate to 6-bit values
+	__m128i offset = _mm_and_si128(upper, _mm_set1_epi8(-'A'));
+	offset = _mm_or_si128(offset, _mm_and_si128(lower, _mm_set1_epi8(26 - 'a')));
+	offset = _mm_or_si128(offset, _mm_and_si128(digit, _mm_set1_epi8(52 - '0')));
+	offset = _mm_or_si128(offset, _mm_and_si128(plus, _mm_set1_epi8(62 - '+')));
+	offset = _mm_or_si128(offset, _mm_and_si128(slash, _mm_set1_epi8(63 - '/')));
+	__m128i v = _mm_add_epi8(c, offset);
+
+	// merge pairs of 6-bit values into 12 bits, then pairs of those into 24
+	v = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(v, _mm_set1_epi16(0x00FF)), 6), _mm_srli_epi16(v, 8));
+	v = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(v, _mm_set1_epi32(0xFFFF)), 12), _mm_srli_epi32(v, 16));
+
+	// each 32-bit lane now holds 3 output bytes, most significant first
+	guint32 lanes[4];
+	_mm_storeu_si128((__m128i *)lanes, v);
+	int i;
+	for (i = 0; i<4; i++) {
+		guint32 bytes = GUINT32_TO_BE(lanes[i] << 8);
+		memcpy(dest + i * 3, &bytes, sizeof(bytes));
+	}
+
+	return true;
+}
+#endif
+
+/*
+ * Decodes base64 text into dest, skipping whitespace. dest may be the
+ * text itself, since output never overtakes input.
+ * Returns the number of bytes written, or -1 if the text is malformed
+ * or decodes to more than destlen bytes.
+ */
+static long decode_base64_text(const char *str, size_t len, unsigned char *dest, size_t destlen)
+{
+	size_t i = 0, o = 0;
+	guint32 bits = 0;
+	int nbits = 0;
+
+	while (i < len) {
+#ifdef USE_SSE2
+		// whole quartets only; the block writes one byte past its 12
+		if (nbits == 0 && len - i >= 16 && destlen - o >= 13
+				&& decode_base64_block(str + i, dest + o)) {
+			i += 16;
+			o += 12;
+			continue;
+		}
+#endif
+		int value = base64_values[(unsigned char)str[i++]];
+		if (value < 0) {
+			if (value == BASE64_SPACE) {
+				continue;
+			}
+			if (value == BASE64_PAD) {
+				break;
+			}
+			return -1;
+		}
+
+		bits = (bits << 6) | value;
+		nbits += 6;
+		if (nbits >= 8) {
+			nbits -= 8;
+			if (o >= destlen) {
+				return -1;
+			}
+			dest[o++] = bits >> nbits;
+		}
+	}
+
+	return o;
+}
+
+/*
+ * Decodes base64 (and optionally compressed) tile ids.
+ */
+static bool decode_base64(const char *name, int *data, int datalen, const char *compression, char *str)
+{
+	size_t datasize = datalen * sizeof(int);
+	size_t len = strlen(str);
+
+	if (compression != NULL) {
+		if (strcmp(compression, "zlib") && strcmp(compression, "gzip")) {
+			fprintf(stderr, "Error: unknown compression format '%s'\n", compression);
+			return false;
+		}
+
+		// decode in place, then inflate straight into the ids
+		unsigned char *rawdata = (unsigned char *)str;
+		long rawlen = decode_base64_text(str, len, rawdata, len);
+		if (rawlen < 0) {
+			fprintf(stderr, "Error: malformed base64 data in layer \"%s\"\n", name);
+			return false;
+		}
+
+		int status = inf(rawdata, rawlen, (unsigned char *)data, datasize);
+		if (status) {
+			zerr(status);
+			return false;
+		}
+	}
+	else {
+		// every tile id takes 4 bytes, so decode straight into the ids
+		long rawlen = decode_base64_text(str, len, (unsigned char *)data, datasize);
+		if (rawlen != datasize) {
+			fprintf(stderr, "Error: malformed base64 data in layer \"%s\"\n", name);
+			return false;
+		}
+	}
+
+#if G_BYTE_ORDER == G_BIG_ENDIAN
+	// ids are stored little-endian
+	int i;
+	for (i = 0; i<datalen; i++) {
+		data[i] = GUINT32_FROM_LE(data[i]);
+	}
+#endif
+
+	return true;
+}
+
+/*
+ * Decodes comma-separated tile ids.
+ */
+static bool decode_csv(const char *name, int *data, int datalen, char *str)
+{
+	int count = scan_gids(str, strlen(str), data, datalen);
+	if (count < 0) {
+		fprintf(stderr, "Error: malformed csv data in layer \"%s\"\n", name);
+		return false;
+	}
+	if (count != datalen) {
+		fprintf(stderr, "Error: layer \"%s\" has %d tiles, expected %d\n", name, count, datalen);
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Decodes the text of an encoded <data> or <chunk> node into datalen
+ * tile ids. The name is only used for error messages; the string is
+ * modified in place.
+ * Returns false if the data couldn't be decoded.
+ */
+bool decode_gids(const char *name, int *data, int datalen, const char *encoding, const char *compression, char *str)
+{
+	str = g_strstrip(str);
+
+	if (!strcmp(encoding, "base64")) {
+		return decode_base64(name, data, datalen, compression, str);
+	}
+	else if (!strcmp(encoding, "csv")) {
+		return decode_csv(name, data, datalen, str);
+	}
+
+	fprintf(stderr, "Error: unknown encoding format '%s'\n", encoding);
+	return false;
+}
+
+/*
+ * Decodes the text of an encoded <data> node into the layer.
+ * layer->data must already hold width*height ids; the string
+ * is modified in place.
+ * Returns false if the data couldn't be decoded.
+ */
+bool decode_layer_data(ALLEGRO_MAP_LAYER *layer, const char *encoding, const char *compression, char *str)
+{
+	return decode_gids(layer->name, layer->data, layer->width * layer->height, encoding, compression, str);
+}
+
+/*
+ * Worker entry point for the queue's thread pool.
+ */
+static void run_decode_job(gpointer data, gpointer user_data)
+{
+	DECODE_JOB *job = (DECODE_JOB*)data;
+	DECODE_QUEUE *queue = (DECODE_QUEUE*)user_data;
+	if (!decode_layer_data(job->layer, job->encoding, job->compression, job->str)) {
+		g_atomic_int_set(&queue->failed, TRUE);
+	}
+
+	g_free(job->encoding);
+	g_free(job->compression);
+	g_free(job->str);
+	g_free(job);
+}
+
+/*
+ * Creates a queue that decodes layer data on up to the given number of
+ * threads. 0 means one per processor; 1 decodes on the calling thread.
+ */
+DECODE_QUEUE *create_decode_queue(int threads)
+{
+	DECODE_QUEUE *queue = g_new0(DECODE_QUEUE, 1);
+
+	if (threads == 0) {
+		threads = g_get_num_processors();
+	}
+
+	if (threads > 1) {
+		GError *error = NULL;
+		queue->pool = g_thread_pool_new(&run_decode_job, queue, threads, FALSE, &error);
+		if (!queue->pool) {
+			// fall back to decoding on this thread
+			fprintf(stderr, "Error: failed to create decode threads\n");
+			g_error_free(error);
+		}
+	}
+
+	return queue;
+}
+
+/*
+ * Decodes the text of an encoded <data> node, either right away or on
+ * the queue's thread pool. The strings are copied if needed, so the
+ * caller may discard them as soon as this returns. Failures are
+ * reported by finish_decode_queue.
+ */
+void queue_layer_data(DECODE_QUEUE *queue, ALLEGRO_MAP_LAYER *layer, const char *encoding, const char *compression, char *str)
+{
+	if (!queue->pool) {
+		if (!decode_layer_data(layer, encoding, compression, str)) {
+			queue->failed = TRUE;
+		}
+		return;
+	}
+
+	DECODE_JOB *job = g_new(DECODE_JOB, 1);
+	job->layer = layer;
+	job->encoding = g_strdup(encoding);
+	job->compression = g_strdup(compression);
+	job->str = g_strdup(str);
+	g_thread_pool_push(queue->pool, job, NULL);
+}
+
+/*
+ * Waits for every queued layer to be decoded, then frees the queue.
+ * Returns false if any of them couldn't be decoded.
+ */
+bool finish_decode_queue(DECODE_QUEUE *queue)
+{
+	if (queue->pool) {
+		g_thread_pool_free(queue->pool, FALSE, TRUE);
+	}
+
+	bool decoded = !g_atomic_int_get(&queue->failed);
+	g_free(queue);
+	return decoded;
+}
@@ -0,0 +1,36 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ */
+
+#ifndef _DECODE_H
+#define _DECODE_H
+
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_tiled.h>
+#include <glib.h>
+#include "data.h"
+#include "zpipe.h"
+
+typedef struct _DECODE_QUEUE DECODE_QUEUE;
+
+bool parse_gid(const char *str, int *gid);
+bool decode_gids(const char *name, int *data, int datalen, const char *encoding, const char *compression, char *str);
+bool decode_layer_data(ALLEGRO_MAP_LAYER *layer, const char *encoding, const char *compression, char *str);
+DECODE_QUEUE *create_decode_queue(int threads);
+void queue_layer_data(DECODE_QUEUE *queue, ALLEGRO_MAP_LAYER *layer, const char *encoding, const char *compression, char *str);
+bool finish_decode_queue(DECODE_QUEUE *queue);
+
+#endif
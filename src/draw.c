@@ -21,9 +21,103 @@
 
 #include "draw.h"
 
+/*
+ * A diagonal flip swaps the axes before the other two flips are applied.
+ * The quarter turn back that stands in for it swaps them too, but it
+ * carries the horizontal flip over to the vertical axis, and mirrors the
+ * horizontal axis unless the tile was flipped vertically as well.
+ */
+const FLIP_DRAW flip_draws[8] = {
+	{0, false},                                               // none
+	{ALLEGRO_FLIP_HORIZONTAL, true},                          // diagonal
+	{ALLEGRO_FLIP_VERTICAL, false},                           // vertical
+	{0, true},                                                // vertical, diagonal
+	{ALLEGRO_FLIP_HORIZONTAL, false},                         // horizontal
+	{ALLEGRO_FLIP_HORIZONTAL | ALLEGRO_FLIP_VERTICAL, true},  // horizontal, diagonal
+	{ALLEGRO_FLIP_HORIZONTAL | ALLEGRO_FLIP_VERTICAL, false}, // horizontal, vertical
+	{ALLEGRO_FLIP_VERTICAL, true}                             // all three
+};
+
+/*
+ * Sets up the table of bitmaps drawn for each gid. Tiles that already
+ * have their bitmaps are filled in now; the rest are looked up as
+ * they're first drawn.
+ */
+void create_draw_bitmaps(ALLEGRO_MAP *map)
+{
+	map->draw_bitmaps = (ALLEGRO_BITMAP **)al_calloc(MAX(map->tiles_length, 1), sizeof(ALLEGRO_BITMAP *));
+
+	int id;
+	for (id = 1; id<map->tiles_length; id++) {
+		ALLEGRO_MAP_TILE *tile = map->tiles[id];
+		if (tile) {
+			map->draw_bitmaps[id] = tile->bitmap;
+		}
+	}
+}
+
+/*
+ * Gets the bitmap a tile object is drawn with: the frame showing, if
+ * its tile animates.
+ */
+static inline ALLEGRO_BITMAP *get_object_bitmap(ALLEGRO_MAP *map, ALLEGRO_MAP_OBJECT *object)
+{
+	if (!map->animations || !object->bitmap) {
+		return object->bitmap;
+	}
+
+	ALLEGRO_BITMAP *bitmap = get_draw_bitmap(map, object->gid & ~(FLIP_MASK << FLIP_SHIFT));
+	return bitmap ? bitmap : object->bitmap;
+}
+
+/*
+ * Draws the part of a chunked layer inside the given tile range.
+ * Only resident chunks with tiles in them are visited; the rest of the
+ * world isn't touched.
+ */
+static void _al_draw_chunked_tile_layer(ALLEGRO_MAP_LAYER *layer, ALLEGRO_MAP *map, ALLEGRO_COLOR color, int xstart, int ystart, int xend, int yend, float sx, float sy, float dx, float dy)
+{
+	GSList *chunk_item = layer->chunks->resident;
+	while (chunk_item) {
+		LAYER_CHUNK *chunk = (LAYER_CHUNK*)chunk_item->data;
+		chunk_item = g_slist_next(chunk_item);
+		if (!chunk->occupied) {
+			continue;
+		}
+
+		// the part of the chunk inside the region
+		int x1 = MAX(xstart, chunk->x), x2 = MIN(xend, chunk->x + chunk->width - 1);
+		int y1 = MAX(ystart, chunk->y), y2 = MIN(yend, chunk->y + chunk->height - 1);
+
+		int mx, my;
+		for (my = y1; my <= y2; my++) {
+			int *row = chunk->data + (my - chunk->y) * chunk->width;
+			for (mx = x1; mx <= x2; mx++) {
+				int raw = row[mx - chunk->x];
+				if (raw) {
+					draw_tile(map, raw, color, mx*(map->tile_width) - sx + dx, my*(map->tile_height) - sy + dy);
+				}
+			}
+		}
+	}
+}
+
+/*
+ * Draws cells first to last of one row of a dense layer whose gid plane
+ * holds the given type, so the inner loop doesn't switch on the gid size.
+ */
+#define DRAW_RUN(type) do { \
+	const type *gids = (const type *)layer->gids + row; \
+	for (mx = first; mx <= last; mx++) { \
+		if (gids[mx]) { \
+			draw_cell(map, gids[mx], get_layer_flip_code(layer, row + mx), color, mx*(map->tile_width) - sx + dx, y); \
+		} \
+	} \
+} while (0)
+
 static void _al_draw_orthogonal_tile_layer(ALLEGRO_MAP_LAYER *layer, ALLEGRO_MAP *map, ALLEGRO_COLOR tint, float sx, float sy, float sw, float sh, float dx, float dy, int flags)
 {
-	if (!layer->visible) {
+	if (!layer->visible || layer_is_empty(layer)) {
 		return;
 	}
 
@@ -32,34 +126,52 @@ static void _al_draw_orthogonal_tile_layer(ALLEGRO_MAP_LAYER *layer, ALLEGRO_MAP
 	ALLEGRO_COLOR color = al_map_rgba_f(r, g, b, a * layer->opacity);
 
 	int mx, my;
-	int ystart = sy / map->tile_height, yend = (sy + sh) / map->tile_height;
-	int xstart = sx / map->tile_width, xend = (sx + sw) / map->tile_width;
+	int ystart = floorf(sy / map->tile_height), yend = floorf((sy + sh) / map->tile_height);
+	int xstart = floorf(sx / map->tile_width), xend = floorf((sx + sw) / map->tile_width);
+
+	if (map->render_chunk_size && draw_cached_tile_layer(layer, map, color, sx, sy, sw, sh, dx, dy)) {
+		return;
+	}
+
+	if (map->vertex_arrays && draw_vertex_tile_layer(layer, map, color, sx, sy, sw, sh, dx, dy)) {
+		return;
+	}
 
 	// defer rendering until everything is drawn
 	al_hold_bitmap_drawing(true);
-	
+
+	if (layer->chunks) {
+		// infinite layers can reach into negative coordinates, so no clamping
+		_al_draw_chunked_tile_layer(layer, map, color, xstart, ystart, xend, yend, sx, sy, dx, dy);
+		al_hold_bitmap_drawing(false);
+		return;
+	}
+
+	// keep the region inside the layer
+	ystart = MAX(ystart, 0);
+	xstart = MAX(xstart, 0);
+	yend = MIN(yend, layer->height - 1);
+	xend = MIN(xend, layer->width - 1);
+
+	// only the runs of each row that hold tiles are walked
+	LAYER_SPANS *spans = layer->spans;
 	for (my = ystart; my <= yend; my++) {
-		for (mx = xstart; mx <= xend; mx++) {
-			ALLEGRO_MAP_TILE *tile = al_get_single_tile(map, layer, mx, my);
-			flags = 0;
-			
-			if (!tile) {
-				continue;
-			}
-			
-			float x = mx*(map->tile_width) - sx + dx;
-			float y = my*(map->tile_height) - sy + dy;
-			
-			if (flipped_vertically(layer, mx, my)) flags ^= ALLEGRO_FLIP_VERTICAL;
-			if (flipped_horizontally(layer, mx, my)) flags ^= ALLEGRO_FLIP_HORIZONTAL;
-			
-			if (flipped_diagonally(layer, mx, my)) {
-				int tile_center_h = map->tile_width		/ 2;
-				int tile_center_w = map->tile_height	/ 2;
-				flags ^= ALLEGRO_FLIP_VERTICAL;
-				al_draw_tinted_rotated_bitmap(tile->bitmap, color, tile_center_w, tile_center_h, x + tile_center_h, y + tile_center_w, -ALLEGRO_PI/2, flags);
-			} else {
-				al_draw_tinted_bitmap(tile->bitmap, color, x, y, flags);
+		int row = my * layer->width;
+		float y = my*(map->tile_height) - sy + dy;
+
+		int s, end = spans->rows[my + 1];
+		for (s = find_row_span(spans, my, xstart); s < end && spans->spans[s * 2] <= xend; s++) {
+			int first = MAX(spans->spans[s * 2], xstart), last = MIN(spans->spans[s * 2 + 1], xend);
+			switch (layer->gid_size) {
+				case 1:
+					DRAW_RUN(guint8);
+					break;
+				case 2:
+					DRAW_RUN(guint16);
+					break;
+				default:
+					DRAW_RUN(guint32);
+					break;
 			}
 		}
 	}
@@ -77,41 +189,306 @@ static void _al_draw_orthogonal_object_layer(ALLEGRO_MAP_LAYER *layer, ALLEGRO_M
 	al_unmap_rgba_f(tint, &r, &g, &b, &a);
 	ALLEGRO_COLOR color = al_map_rgba_f(r, g, b, a * layer->opacity);
 	
+	// only the objects on-screen are found, in the order they're listed;
+	// the grid's found list holds them until the layer is next searched
+	OBJECT_GRID *grid = layer->object_grid;
+	int i, count = find_grid_objects(grid, sx, sy, sx + sw, sy + sh);
+
 	// defer rendering until everything is drawn
 	al_hold_bitmap_drawing(true);
+
+	for (i = 0; i<count; i++) {
+		ALLEGRO_MAP_OBJECT *object = grid->found[i];
+
+		// no need to draw invisible objects
+		ALLEGRO_BITMAP *bitmap = get_object_bitmap(map, object);
+		if (!bitmap) {
+			continue;
+		}
+
+		al_draw_tinted_bitmap(bitmap, color, object->x - sx + dx, object->y - object->height - sy + dy, flags);
+	}
 	
-	GSList *objects = layer->objects;
-	while (objects) {
-		ALLEGRO_MAP_OBJECT *object = (ALLEGRO_MAP_OBJECT*)objects->data;
-		objects = g_slist_next(objects);
+	al_hold_bitmap_drawing(false);
+}
+
+static void _al_draw_orthogonal_map(ALLEGRO_MAP *map, ALLEGRO_COLOR tint, float sx, float sy, float sw, float sh, float dx, float dy, int flags)
+{
+	GSList *layers = map->layers;
+	while (layers) {
+		ALLEGRO_MAP_LAYER *layer = (ALLEGRO_MAP_LAYER*)layers->data;
+		layers = g_slist_next(layers);
+		if (layer->type == TILE_LAYER) {
+			_al_draw_orthogonal_tile_layer(layer, map, tint, sx, sy, sw, sh, dx, dy, flags);
+		} else if (layer->type == OBJECT_LAYER) {
+			_al_draw_orthogonal_object_layer(layer, map, tint, sx, sy, sw, sh, dx, dy, flags);
+		}
+	}
+}
+
+/*
+ * Draws the tile with the given gid and flip code with the bottom left
+ * corner of its image at the given position.
+ */
+static inline void draw_standing_cell(ALLEGRO_MAP *map, int gid, int flips, ALLEGRO_COLOR color, float x, float bottom)
+{
+	ALLEGRO_BITMAP *bitmap = get_draw_bitmap(map, gid);
+	if (bitmap) {
+		draw_cell(map, gid, flips, color, x, bottom - al_get_bitmap_height(bitmap));
+	}
+}
+
+/*
+ * Like Tiled, isometric tiles are drawn with the bottom left corner of
+ * their image on that of their cell's diamond, so tall tiles stand up
+ * over the cells behind them. Cells are drawn row by row, which is back
+ * to front for tiles no wider than a cell, and only those whose tiles
+ * can reach into the region are visited.
+ */
+static void _al_draw_isometric_tile_layer(ALLEGRO_MAP_LAYER *layer, ALLEGRO_MAP *map, ALLEGRO_COLOR tint, float sx, float sy, float sw, float sh, float dx, float dy, int flags)
+{
+	if (!layer->visible || layer_is_empty(layer)) {
+		return;
+	}
+
+	float r, g, b, a;
+	al_unmap_rgba_f(tint, &r, &g, &b, &a);
+	ALLEGRO_COLOR color = al_map_rgba_f(r, g, b, a * layer->opacity);
+
+	float half_width = map->tile_width / 2.0f, half_height = map->tile_height / 2.0f;
+	float origin = map->height * half_width;
+	int d1, d2, e1, e2;
+	get_isometric_diagonals(map, sx, sy, sw, sh, &d1, &d2, &e1, &e2);
+
+	int mx, my;
+	int ystart = ceilf((d1 - e2) / 2.0f), yend = floorf((d2 - e1) / 2.0f);
+	if (!layer->chunks) {
+		ystart = MAX(ystart, 0);
+		yend = MIN(yend, layer->height - 1);
+	}
+
+	// defer rendering until everything is drawn
+	al_hold_bitmap_drawing(true);
+
+	for (my = ystart; my <= yend; my++) {
+		int xstart = MAX(d1 - my, e1 + my), xend = MIN(d2 - my, e2 + my);
+
+		if (layer->chunks) {
+			// infinite layers can reach into negative coordinates, so no clamping
+			for (mx = xstart; mx <= xend; mx++) {
+				int raw = lookup_chunk_tile(layer->chunks, mx, my);
+				if (raw) {
+					draw_standing_cell(map, raw & ~(FLIP_MASK << FLIP_SHIFT), ((guint32)raw >> FLIP_SHIFT) & FLIP_MASK, color,
+							(mx - my - 1) * half_width + origin - sx + dx, (mx + my) * half_height + map->tile_height - sy + dy);
+				}
+			}
+			continue;
+		}
+
+		// only the runs of the row that hold tiles are walked
+		LAYER_SPANS *spans = layer->spans;
+		int row = my * layer->width, s, end = spans->rows[my + 1];
+		xstart = MAX(xstart, 0);
+		xend = MIN(xend, layer->width - 1);
+		for (s = find_row_span(spans, my, xstart); s < end && spans->spans[s * 2] <= xend; s++) {
+			int last = MIN(spans->spans[s * 2 + 1], xend);
+			for (mx = MAX(spans->spans[s * 2], xstart); mx <= last; mx++) {
+				int gid = get_layer_gid(layer, row + mx);
+				if (gid) {
+					draw_standing_cell(map, gid, get_layer_flip_code(layer, row + mx), color,
+							(mx - my - 1) * half_width + origin - sx + dx, (mx + my) * half_height + map->tile_height - sy + dy);
+				}
+			}
+		}
+	}
+
+	al_hold_bitmap_drawing(false);
+}
+
+/*
+ * Like Tiled, isometric objects are placed in tile_height pixel steps
+ * along both diagonals, and tile objects are drawn centered on their
+ * position, standing up from it.
+ */
+static void _al_draw_isometric_object_layer(ALLEGRO_MAP_LAYER *layer, ALLEGRO_MAP *map, ALLEGRO_COLOR tint, float sx, float sy, float sw, float sh, float dx, float dy, int flags)
+{
+	if (!layer->visible) {
+		return;
+	}
+
+	float r, g, b, a;
+	al_unmap_rgba_f(tint, &r, &g, &b, &a);
+	ALLEGRO_COLOR color = al_map_rgba_f(r, g, b, a * layer->opacity);
+
+	float half_width = map->tile_width / 2.0f, half_height = map->tile_height / 2.0f;
+	float origin = map->height * half_width;
+	float scale = (float)map->tile_height / map->tile_width;
+	int extent_width, extent_height;
+	get_tile_extent(map, &extent_width, &extent_height);
+
+	// objects drawn from inside this area can reach into the region; it's
+	// a diamond in object space, so search the box around it
+	float x1 = sx - extent_width / 2.0f - origin, x2 = sx + sw + extent_width / 2.0f - origin;
+	float y1 = sy, y2 = sy + sh + extent_height;
+	OBJECT_GRID *grid = layer->object_grid;
+	int i, count = find_grid_objects(grid, y1 + x1 * scale, y1 - x2 * scale, y2 + x2 * scale, y2 - x1 * scale);
+
+	// defer rendering until everything is drawn
+	al_hold_bitmap_drawing(true);
+
+	for (i = 0; i<count; i++) {
+		ALLEGRO_MAP_OBJECT *object = grid->found[i];
 
 		// no need to draw invisible objects
-		if (!object->bitmap) {
+		ALLEGRO_BITMAP *bitmap = get_object_bitmap(map, object);
+		if (!bitmap) {
 			continue;
 		}
 
-		int x = object->x - sx;
-		int y = object->y - sy;
+		float tx = (float)object->x / map->tile_height, ty = (float)object->y / map->tile_height;
+		float x = (tx - ty) * half_width + origin, y = (tx + ty) * half_height;
 
-		// make sure it's on-screen; if it's not, don't draw it
-		if ((x + object->width) < 0 || x > sw || y < 0 || (y - object->height) > sh) {
+		int width = al_get_bitmap_width(bitmap), height = al_get_bitmap_height(bitmap);
+		x -= width / 2.0f;
+		if (x > sx + sw || x + width < sx || y - height > sy + sh || y < sy) {
 			continue;
 		}
 
-		al_draw_tinted_bitmap(object->bitmap, color, x, y-object->height, flags);
+		al_draw_tinted_bitmap(bitmap, color, x - sx + dx, y - height - sy + dy, flags);
 	}
-	
+
 	al_hold_bitmap_drawing(false);
 }
 
-static void _al_draw_orthogonal_map(ALLEGRO_MAP *map, ALLEGRO_COLOR tint, float sx, float sy, float sw, float sh, float dx, float dy, int flags)
+static void _al_draw_isometric_map(ALLEGRO_MAP *map, ALLEGRO_COLOR tint, float sx, float sy, float sw, float sh, float dx, float dy, int flags)
 {
 	GSList *layers = map->layers;
 	while (layers) {
 		ALLEGRO_MAP_LAYER *layer = (ALLEGRO_MAP_LAYER*)layers->data;
 		layers = g_slist_next(layers);
 		if (layer->type == TILE_LAYER) {
-			_al_draw_orthogonal_tile_layer(layer, map, tint, sx, sy, sw, sh, dx, dy, flags);
+			_al_draw_isometric_tile_layer(layer, map, tint, sx, sy, sw, sh, dx, dy, flags);
+		} else if (layer->type == OBJECT_LAYER) {
+			_al_draw_isometric_object_layer(layer, map, tint, sx, sy, sw, sh, dx, dy, flags);
+		}
+	}
+}
+
+/*
+ * Draws the cells of row my from column first to last, stepping by the
+ * given number of columns, with their tiles standing on the bottom left
+ * corner of their boxes. ox and oy move a cell's box from map pixels to
+ * where the bottom of its tile is drawn.
+ */
+static void draw_staggered_run(ALLEGRO_MAP_LAYER *layer, ALLEGRO_MAP *map, const STAGGER_GRID *grid, ALLEGRO_COLOR color, int my, int first, int last, int step, float ox, float oy)
+{
+	int mx;
+	float x, y;
+
+	if (layer->chunks) {
+		// infinite layers can reach into negative coordinates, so no clamping
+		for (mx = first; mx <= last; mx += step) {
+			int raw = lookup_chunk_tile(layer->chunks, mx, my);
+			if (raw) {
+				get_staggered_cell_pos(grid, mx, my, &x, &y);
+				draw_standing_cell(map, raw & ~(FLIP_MASK << FLIP_SHIFT), ((guint32)raw >> FLIP_SHIFT) & FLIP_MASK, color, x + ox, y + oy);
+			}
+		}
+		return;
+	}
+
+	if (first < 0) {
+		first += (step - 1 - first) / step * step;
+	}
+	last = MIN(last, layer->width - 1);
+
+	// only the runs of the row that hold tiles are walked, keeping to the
+	// columns of the step
+	LAYER_SPANS *spans = layer->spans;
+	int row = my * layer->width, s, end = spans->rows[my + 1];
+	for (s = find_row_span(spans, my, first); s < end && spans->spans[s * 2] <= last; s++) {
+		int start = MAX(spans->spans[s * 2], first), stop = MIN(spans->spans[s * 2 + 1], last);
+		start += (step - (start - first) % step) % step;
+		for (mx = start; mx <= stop; mx += step) {
+			int gid = get_layer_gid(layer, row + mx);
+			if (gid) {
+				get_staggered_cell_pos(grid, mx, my, &x, &y);
+				draw_standing_cell(map, gid, get_layer_flip_code(layer, row + mx), color, x + ox, y + oy);
+			}
+		}
+	}
+}
+
+/*
+ * Staggered and hexagonal maps shift every other row (or column) by
+ * half a cell. Like Tiled, tiles are drawn with the bottom left corner
+ * of their image on that of their cell's box, and back to front: when
+ * columns are staggered, each row's unshifted cells are drawn before
+ * the shifted ones that sit half a cell lower. Only cells whose tiles
+ * can reach into the region are visited.
+ */
+static void _al_draw_staggered_tile_layer(ALLEGRO_MAP_LAYER *layer, ALLEGRO_MAP *map, ALLEGRO_COLOR tint, float sx, float sy, float sw, float sh, float dx, float dy, int flags)
+{
+	if (!layer->visible || layer_is_empty(layer)) {
+		return;
+	}
+
+	float r, g, b, a;
+	al_unmap_rgba_f(tint, &r, &g, &b, &a);
+	ALLEGRO_COLOR color = al_map_rgba_f(r, g, b, a * layer->opacity);
+
+	STAGGER_GRID grid;
+	get_stagger_grid(map, &grid);
+	if (grid.tile_width <= 0 || grid.tile_height <= 0) {
+		return;
+	}
+
+	int extent_width, extent_height;
+	get_tile_extent(map, &extent_width, &extent_height);
+	float ox = dx - sx, oy = dy - sy + grid.tile_height;
+
+	int mx, my, xstart, xend, ystart, yend;
+	get_staggered_bounds(map, sx, sy, sw, sh, &xstart, &ystart, &xend, &yend);
+	if (!layer->chunks) {
+		ystart = MAX(ystart, 0);
+		yend = MIN(yend, layer->height - 1);
+	}
+
+	// defer rendering until everything is drawn
+	al_hold_bitmap_drawing(true);
+
+	if (grid.stagger_x) {
+		int unshifted = xstart + (is_staggered_cell(&grid, xstart, 0) ? 1 : 0);
+		int shifted = xstart + (is_staggered_cell(&grid, xstart, 0) ? 0 : 1);
+		for (my = ystart; my <= yend; my++) {
+			draw_staggered_run(layer, map, &grid, color, my, unshifted, xend, 2, ox, oy);
+			draw_staggered_run(layer, map, &grid, color, my, shifted, xend, 2, ox, oy);
+		}
+	} else {
+		// each row's run starts as far left as its own shift allows
+		int column_step = grid.tile_width + grid.side_length_x;
+		for (my = ystart; my <= yend; my++) {
+			float shift = is_staggered_cell(&grid, 0, my) ? grid.column_width : 0;
+			mx = ceilf((sx - extent_width - shift) / column_step);
+			draw_staggered_run(layer, map, &grid, color, my, mx, floorf((sx + sw - shift) / column_step), 1, ox, oy);
+		}
+	}
+
+	al_hold_bitmap_drawing(false);
+}
+
+/*
+ * Objects on staggered and hexagonal maps are placed in plain map
+ * pixels, the same as on orthogonal ones.
+ */
+static void _al_draw_staggered_map(ALLEGRO_MAP *map, ALLEGRO_COLOR tint, float sx, float sy, float sw, float sh, float dx, float dy, int flags)
+{
+	GSList *layers = map->layers;
+	while (layers) {
+		ALLEGRO_MAP_LAYER *layer = (ALLEGRO_MAP_LAYER*)layers->data;
+		layers = g_slist_next(layers);
+		if (layer->type == TILE_LAYER) {
+			_al_draw_staggered_tile_layer(layer, map, tint, sx, sy, sw, sh, dx, dy, flags);
 		} else if (layer->type == OBJECT_LAYER) {
 			_al_draw_orthogonal_object_layer(layer, map, tint, sx, sy, sw, sh, dx, dy, flags);
 		}
@@ -124,11 +501,7 @@ static void _al_draw_orthogonal_map(ALLEGRO_MAP *map, ALLEGRO_COLOR tint, float
  */
 void al_draw_tinted_map(ALLEGRO_MAP *map, ALLEGRO_COLOR tint, float dx, float dy, int flags)
 {
-	if (!strcmp(map->orientation, "orthogonal")) {
-		_al_draw_orthogonal_map(map, tint, 0, 0, map->width * map->tile_width, map->height * map->tile_width, dx, dy, flags);
-	} else {
-		fprintf(stderr, "Error: can't draw map with orientation \"%s\"\n", map->orientation);
-	}
+	al_draw_tinted_map_region(map, tint, 0, 0, al_map_get_pixel_width(map), al_map_get_pixel_height(map), dx, dy, flags);
 }
 
 /*
@@ -137,10 +510,47 @@ void al_draw_tinted_map(ALLEGRO_MAP *map, ALLEGRO_COLOR tint, float dx, float dy
  */
 void al_draw_tinted_map_region(ALLEGRO_MAP *map, ALLEGRO_COLOR tint, float sx, float sy, float sw, float sh, float dx, float dy, int flags)
 {
-	if (!strcmp(map->orientation, "orthogonal")) {
-		_al_draw_orthogonal_map(map, tint, sx, sy, sw, sh, dx, dy, flags);
-	} else {
-		fprintf(stderr, "Error: can't draw map with orientation \"%s\"\n", map->orientation);
+	switch (map->orientation_kind) {
+		case ORIENTATION_ORTHOGONAL:
+			_al_draw_orthogonal_map(map, tint, sx, sy, sw, sh, dx, dy, flags);
+			break;
+		case ORIENTATION_ISOMETRIC:
+			_al_draw_isometric_map(map, tint, sx, sy, sw, sh, dx, dy, flags);
+			break;
+		case ORIENTATION_STAGGERED:
+		case ORIENTATION_HEXAGONAL:
+			_al_draw_staggered_map(map, tint, sx, sy, sw, sh, dx, dy, flags);
+			break;
+		default:
+			fprintf(stderr, "Error: can't draw map with orientation \"%s\"\n", map->orientation);
+			break;
+	}
+}
+
+/*
+ * Draws a region of every tile layer of the map, leaving out the object
+ * layers, for drawing into bitmaps that outlive the frame.
+ */
+void draw_map_tile_layers(ALLEGRO_MAP *map, ALLEGRO_COLOR tint, float sx, float sy, float sw, float sh, float dx, float dy)
+{
+	GSList *layers = map->tile_layers;
+	while (layers) {
+		ALLEGRO_MAP_LAYER *layer = (ALLEGRO_MAP_LAYER*)layers->data;
+		layers = g_slist_next(layers);
+		switch (map->orientation_kind) {
+			case ORIENTATION_ORTHOGONAL:
+				_al_draw_orthogonal_tile_layer(layer, map, tint, sx, sy, sw, sh, dx, dy, 0);
+				break;
+			case ORIENTATION_ISOMETRIC:
+				_al_draw_isometric_tile_layer(layer, map, tint, sx, sy, sw, sh, dx, dy, 0);
+				break;
+			case ORIENTATION_STAGGERED:
+			case ORIENTATION_HEXAGONAL:
+				_al_draw_staggered_tile_layer(layer, map, tint, sx, sy, sw, sh, dx, dy, 0);
+				break;
+			default:
+				break;
+		}
 	}
 }
 
@@ -165,7 +575,7 @@ void al_draw_map(ALLEGRO_MAP *map, float dx, float dy, int flags)
  */
 void al_draw_tinted_tile_layer_for_name(ALLEGRO_MAP *map, char *name, ALLEGRO_COLOR tint, float dx, float dy, int flags)
 {
-	_al_draw_orthogonal_tile_layer(al_get_layer_for_name(map, name), map, tint, 0, 0, map->width * map->tile_width, map->height * map->tile_height, dx, dy, flags);
+	al_draw_tinted_tile_layer_region_for_name(map, name, tint, 0, 0, al_map_get_pixel_width(map), al_map_get_pixel_height(map), dx, dy, flags);
 }
 
 /*
@@ -181,10 +591,21 @@ void al_draw_tile_layer_for_name(ALLEGRO_MAP *map, char *name, float dx, float d
  */
 void al_draw_tinted_tile_layer_region_for_name(ALLEGRO_MAP *map, char *name, ALLEGRO_COLOR tint, float sx, float sy, float sw, float sh, float dx, float dy, int flags)
 {
-	if (!strcmp(map->orientation, "orthogonal")) {
-		_al_draw_orthogonal_tile_layer(al_get_layer_for_name(map, name), map, tint, sx, sy, sw, sh, dx, dy, flags);
-	} else {
-		fprintf(stderr, "Error: can't draw layer with orientation \"%s\"\n", map->orientation);
+	ALLEGRO_MAP_LAYER *layer = al_get_layer_for_name(map, name);
+	switch (map->orientation_kind) {
+		case ORIENTATION_ORTHOGONAL:
+			_al_draw_orthogonal_tile_layer(layer, map, tint, sx, sy, sw, sh, dx, dy, flags);
+			break;
+		case ORIENTATION_ISOMETRIC:
+			_al_draw_isometric_tile_layer(layer, map, tint, sx, sy, sw, sh, dx, dy, flags);
+			break;
+		case ORIENTATION_STAGGERED:
+		case ORIENTATION_HEXAGONAL:
+			_al_draw_staggered_tile_layer(layer, map, tint, sx, sy, sw, sh, dx, dy, flags);
+			break;
+		default:
+			fprintf(stderr, "Error: can't draw layer with orientation \"%s\"\n", map->orientation);
+			break;
 	}
 }
 
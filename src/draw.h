@@ -23,6 +23,7 @@
 #include <stdio.h>
 #include "data.h"
 #include "map.h"
+#include "render.h"
 
 void al_draw_tinted_map(ALLEGRO_MAP *map, ALLEGRO_COLOR tint, float dx, float dy, int flags);
 void al_draw_map(ALLEGRO_MAP *map, float dx, float dy, int flags);
@@ -32,5 +33,66 @@ void al_draw_tile_layer_for_name(ALLEGRO_MAP *map, char *name, float dx, float d
 void al_draw_tinted_tile_layer_region_for_name(ALLEGRO_MAP *map, char *name, ALLEGRO_COLOR tint, float sx, float sy, float sw, float sh, float dx, float dy, int flags);
 void al_draw_tile_layer_region_for_name(ALLEGRO_MAP *map, char *name, float sx, float sy, float sw, float sh, float dx, float dy, int flags);
 void al_draw_objects(ALLEGRO_MAP *map);
+void create_draw_bitmaps(ALLEGRO_MAP *map);
+void draw_map_tile_layers(ALLEGRO_MAP *map, ALLEGRO_COLOR tint, float sx, float sy, float sw, float sh, float dx, float dy);
+
+/*
+ * How to draw a tile for each combination of flip flags, indexed by
+ * their value in the top three bits of a raw id.
+ */
+typedef struct {
+	int flags;                  // ALLEGRO_FLIP_* flags to draw the bitmap with
+	bool turned;                // drawn a quarter turn back, for a diagonal flip
+} FLIP_DRAW;
+
+extern const FLIP_DRAW flip_draws[8];
+
+/*
+ * Gets the bitmap drawn for a gid, looking its tile up the first time.
+ */
+static inline ALLEGRO_BITMAP *get_draw_bitmap(ALLEGRO_MAP *map, int gid)
+{
+	if (gid <= 0 || gid >= map->tiles_length) {
+		return NULL;
+	}
+
+	ALLEGRO_BITMAP *bitmap = map->draw_bitmaps[gid];
+	if (!bitmap) {
+		ALLEGRO_MAP_TILE *tile = al_get_tile_for_id(map, gid);
+		bitmap = tile ? tile->bitmap : NULL;
+		map->draw_bitmaps[gid] = bitmap;
+	}
+
+	return bitmap;
+}
+
+/*
+ * Draws the tile with the given gid and flip code (see get_layer_flip_code)
+ * at the given position.
+ */
+static inline void draw_cell(ALLEGRO_MAP *map, int gid, int flips, ALLEGRO_COLOR color, float x, float y)
+{
+	ALLEGRO_BITMAP *bitmap = get_draw_bitmap(map, gid);
+	if (!bitmap) {
+		return;
+	}
+
+	const FLIP_DRAW *flip = &flip_draws[flips];
+	if (flip->turned) {
+		int tile_center_h = map->tile_width		/ 2;
+		int tile_center_w = map->tile_height	/ 2;
+		al_draw_tinted_rotated_bitmap(bitmap, color, tile_center_w, tile_center_h, x + tile_center_h, y + tile_center_w, -ALLEGRO_PI/2, flip->flags);
+	} else {
+		al_draw_tinted_bitmap(bitmap, color, x, y, flip->flags);
+	}
+}
+
+/*
+ * Draws the tile with the given raw id (flip bits included) at the given position.
+ */
+static inline void draw_tile(ALLEGRO_MAP *map, int raw, ALLEGRO_COLOR color, float x, float y)
+{
+	draw_cell(map, raw & ~(FLIP_MASK << FLIP_SHIFT), ((guint32)raw >> FLIP_SHIFT) & FLIP_MASK, color, x, y);
+}
 
 #endif
@@ -0,0 +1,231 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ *
+ *
+ *                               ---
+ *
+ * Spatial index of the objects on object layers.
+ *
+ * Layers can hold tens of thousands of pickups and triggers, far too
+ * many to walk every frame just to find the few on screen. Each object
+ * layer keeps a uniform grid of cells at least OBJECT_CELL_SIZE pixels
+ * square, and every object sits in the cell its top left corner falls
+ * in. Objects are never larger than a cell, so a search only has to
+ * reach one cell further up and to the left than the area it covers;
+ * the odd object that is larger is kept on a list of its own, which
+ * every search checks.
+ *
+ * The grid covers the objects where they were loaded. Objects moved
+ * off it go in the nearest cell on its edge, which searches beyond the
+ * edge reach as well. Objects are kept in step by al_set_object_pos.
+ */
+
+#include "grid.h"
+
+/*
+ * Gets the cell of a grid row or column that an offset from the grid's
+ * edge falls in, clamped to the grid.
+ */
+static inline int get_cell_index(float offset, int cell_size, int count)
+{
+	int i = (int)floorf(offset / cell_size);
+	return MIN(MAX(i, 0), count - 1);
+}
+
+/*
+ * Finds the cell an object belongs in.
+ */
+static OBJECT_CELL *get_object_cell(OBJECT_GRID *grid, ALLEGRO_MAP_OBJECT *object)
+{
+	if (object->width > grid->cell_size || object->height > grid->cell_size) {
+		return &grid->large;
+	}
+
+	int column = get_cell_index(object->x - grid->x, grid->cell_size, grid->columns);
+	int row = get_cell_index(get_object_top(object) - grid->y, grid->cell_size, grid->rows);
+	return &grid->cells[column + row * grid->columns];
+}
+
+/*
+ * Adds an object to the cell it belongs in.
+ */
+void insert_grid_object(OBJECT_GRID *grid, ALLEGRO_MAP_OBJECT *object)
+{
+	OBJECT_CELL *cell = get_object_cell(grid, object);
+	if (cell->count == cell->capacity) {
+		cell->capacity = MAX(cell->capacity * 2, 4);
+		cell->objects = (ALLEGRO_MAP_OBJECT **)al_realloc(cell->objects, cell->capacity * sizeof(ALLEGRO_MAP_OBJECT *));
+	}
+
+	cell->objects[cell->count++] = object;
+}
+
+/*
+ * Takes an object out of its cell. Call it before the object moves.
+ */
+void remove_grid_object(OBJECT_GRID *grid, ALLEGRO_MAP_OBJECT *object)
+{
+	OBJECT_CELL *cell = get_object_cell(grid, object);
+
+	int i;
+	for (i = 0; i<cell->count; i++) {
+		if (cell->objects[i] == object) {
+			cell->objects[i] = cell->objects[--cell->count];
+			return;
+		}
+	}
+}
+
+/*
+ * Builds the grid of an object layer, and numbers its objects in the
+ * order they're listed.
+ */
+void index_layer_objects(ALLEGRO_MAP_LAYER *layer)
+{
+	free_object_grid(layer);
+
+	// find the area the objects' top left corners cover
+	int x1 = 0, y1 = 0, x2 = 0, y2 = 0, index = 0;
+	GSList *objects = layer->objects;
+	while (objects) {
+		ALLEGRO_MAP_OBJECT *object = (ALLEGRO_MAP_OBJECT*)objects->data;
+		objects = g_slist_next(objects);
+
+		int top = get_object_top(object);
+		if (!index) {
+			x1 = x2 = object->x;
+			y1 = y2 = top;
+		}
+		x1 = MIN(x1, object->x);
+		y1 = MIN(y1, top);
+		x2 = MAX(x2, object->x);
+		y2 = MAX(y2, top);
+		object->index = index++;
+	}
+
+	OBJECT_GRID *grid = (OBJECT_GRID *)al_calloc(1, sizeof(OBJECT_GRID));
+	grid->x = x1;
+	grid->y = y1;
+
+	// sparse layers spread over a large area get larger cells, so there
+	// are never more than a few per object
+	gint64 max_cells = MAX(layer->object_count * 4, 1);
+	grid->cell_size = OBJECT_CELL_SIZE;
+	while (grid->cell_size < G_MAXINT / 2
+			&& (gint64)((x2 - x1) / grid->cell_size + 1) * ((y2 - y1) / grid->cell_size + 1) > max_cells) {
+		grid->cell_size *= 2;
+	}
+	grid->columns = (x2 - x1) / grid->cell_size + 1;
+	grid->rows = (y2 - y1) / grid->cell_size + 1;
+	grid->cells = (OBJECT_CELL *)al_calloc(grid->columns * grid->rows, sizeof(OBJECT_CELL));
+
+	objects = layer->objects;
+	while (objects) {
+		insert_grid_object(grid, (ALLEGRO_MAP_OBJECT*)objects->data);
+		objects = g_slist_next(objects);
+	}
+
+	layer->object_grid = grid;
+}
+
+/*
+ * Adds the objects of a cell whose bounds overlap the given area to the
+ * grid's found list, which already holds count objects.
+ * Returns the new count.
+ */
+static int find_cell_objects(OBJECT_GRID *grid, OBJECT_CELL *cell, int count, float x1, float y1, float x2, float y2)
+{
+	int i;
+	for (i = 0; i<cell->count; i++) {
+		ALLEGRO_MAP_OBJECT *object = cell->objects[i];
+		int top = get_object_top(object);
+		if (object->x + object->width < x1 || object->x > x2 || top + object->height < y1 || top > y2) {
+			continue;
+		}
+
+		if (count == grid->found_capacity) {
+			grid->found_capacity = MAX(grid->found_capacity * 2, 64);
+			grid->found = (ALLEGRO_MAP_OBJECT **)al_realloc(grid->found, grid->found_capacity * sizeof(ALLEGRO_MAP_OBJECT *));
+		}
+		grid->found[count++] = object;
+	}
+
+	return count;
+}
+
+/*
+ * Orders objects by their place on the layer.
+ */
+static int compare_object_index(const void *a, const void *b)
+{
+	return (*(ALLEGRO_MAP_OBJECT * const *)a)->index - (*(ALLEGRO_MAP_OBJECT * const *)b)->index;
+}
+
+/*
+ * Finds the objects whose bounds overlap the area from x1,y1 to x2,y2
+ * (in pixels, edges included), and puts them in the grid's found list
+ * in the order they're listed on the layer. The list belongs to the
+ * grid and is only valid until the next search on it, which may move
+ * it; callers that keep the results must copy them out first. Since
+ * every search shares it, searches of one layer can't run on several
+ * threads at once.
+ * Returns the number of objects found.
+ */
+int find_grid_objects(OBJECT_GRID *grid, float x1, float y1, float x2, float y2)
+{
+	int count = find_cell_objects(grid, &grid->large, 0, x1, y1, x2, y2);
+
+	// objects reach at most a cell right of and below their corner
+	int c1 = get_cell_index(x1 - grid->x - grid->cell_size, grid->cell_size, grid->columns);
+	int r1 = get_cell_index(y1 - grid->y - grid->cell_size, grid->cell_size, grid->rows);
+	int c2 = get_cell_index(x2 - grid->x, grid->cell_size, grid->columns);
+	int r2 = get_cell_index(y2 - grid->y, grid->cell_size, grid->rows);
+
+	int column, row;
+	for (row = r1; row <= r2; row++) {
+		for (column = c1; column <= c2; column++) {
+			count = find_cell_objects(grid, &grid->cells[column + row * grid->columns], count, x1, y1, x2, y2);
+		}
+	}
+
+	if (count > 1) {
+		qsort(grid->found, count, sizeof(ALLEGRO_MAP_OBJECT *), compare_object_index);
+	}
+
+	return count;
+}
+
+/*
+ * Frees a layer's object grid. The objects themselves live in the map's arena.
+ */
+void free_object_grid(ALLEGRO_MAP_LAYER *layer)
+{
+	OBJECT_GRID *grid = layer->object_grid;
+	if (!grid) {
+		return;
+	}
+
+	int i;
+	for (i = 0; i<grid->columns * grid->rows; i++) {
+		al_free(grid->cells[i].objects);
+	}
+
+	al_free(grid->cells);
+	al_free(grid->large.objects);
+	al_free(grid->found);
+	al_free(grid);
+	layer->object_grid = NULL;
+}
@@ -0,0 +1,62 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ */
+
+#ifndef _GRID_H
+#define _GRID_H
+
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_tiled.h>
+#include <glib.h>
+#include <math.h>
+#include "data.h"
+
+// Smallest size of an object grid cell, in pixels
+#define OBJECT_CELL_SIZE 256
+
+typedef struct {
+	ALLEGRO_MAP_OBJECT **objects; // objects in the cell, in no particular order
+	int count;                  // number of objects
+	int capacity;               // number of objects there's room for
+} OBJECT_CELL;
+
+struct _OBJECT_GRID
+{
+	int x, y;                   // pixel position of the top left corner of the first cell
+	int cell_size;              // width and height of every cell, in pixels
+	int columns, rows;          // size of the grid, in cells
+	OBJECT_CELL *cells;         // objects by the cell their top left corner is in, row by row
+	OBJECT_CELL large;          // objects too big for a cell, which every search checks
+	ALLEGRO_MAP_OBJECT **found; // objects found by the last search, in layer order; reused by the next
+	int found_capacity;         // number of objects there's room for in found
+};
+
+void index_layer_objects(ALLEGRO_MAP_LAYER *layer);
+void insert_grid_object(OBJECT_GRID *grid, ALLEGRO_MAP_OBJECT *object);
+void remove_grid_object(OBJECT_GRID *grid, ALLEGRO_MAP_OBJECT *object);
+int find_grid_objects(OBJECT_GRID *grid, float x1, float y1, float x2, float y2);
+void free_object_grid(ALLEGRO_MAP_LAYER *layer);
+
+/*
+ * Gets the top edge of an object. Tile objects hang up from their
+ * position; everything else hangs down.
+ */
+static inline int get_object_top(ALLEGRO_MAP_OBJECT *object)
+{
+	return object->gid ? object->y - object->height : object->y;
+}
+
+#endif
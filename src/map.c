@@ -26,7 +26,25 @@
  */
 static inline int lookup_tile(ALLEGRO_MAP_LAYER *layer, int x, int y)
 {
-	return layer->data[x+(y*layer->width)];
+	if (layer->chunks) {
+		return lookup_chunk_tile(layer->chunks, x, y);
+	}
+
+	int i = x+(y*layer->width);
+	return get_layer_gid(layer, i) | get_layer_flips(layer, i);
+}
+
+/*
+ * Look up the flip flags of a tile in the given layer, in their place
+ * in the raw data. Other bits may be set too.
+ */
+static inline int lookup_flips(ALLEGRO_MAP_LAYER *layer, int x, int y)
+{
+	if (layer->chunks) {
+		return lookup_chunk_tile(layer->chunks, x, y);
+	}
+
+	return get_layer_flips(layer, x+(y*layer->width));
 }
 
 /*
@@ -38,6 +56,11 @@ int al_get_single_tile_id(ALLEGRO_MAP_LAYER *layer, int x, int y)
 		return 0;
 	}
 
+	if (!layer->chunks) {
+		// the gid plane holds no flip flags, so there's nothing to mask
+		return get_layer_gid(layer, x+(y*layer->width));
+	}
+
 	int id = lookup_tile(layer, x, y);
 	id &= ~(FLIPPED_HORIZONTALLY_FLAG
 			|FLIPPED_VERTICALLY_FLAG
@@ -46,6 +69,49 @@ int al_get_single_tile_id(ALLEGRO_MAP_LAYER *layer, int x, int y)
 	return id;
 }
 
+/*
+ * Sets the tile at the given location on the given layer. The id may
+ * carry flip flags, and 0 clears the cell. Cells of chunked layers can
+ * only be set while their chunk is resident.
+ * Returns false if the id isn't in any of the map's tilesets or there's
+ * no cell to set at the location.
+ */
+bool al_set_single_tile_id(ALLEGRO_MAP *map, ALLEGRO_MAP_LAYER *layer, int x, int y, int id)
+{
+	if (layer->type != TILE_LAYER) {
+		return false;
+	}
+
+	int gid = id & ~(FLIPPED_HORIZONTALLY_FLAG
+			|FLIPPED_VERTICALLY_FLAG
+			|FLIPPED_DIAGONALLY_FLAG);
+	if (gid >= map->tiles_length) {
+		return false;
+	}
+
+	if (layer->chunks) {
+		if (!set_chunk_tile(layer->chunks, x, y, id)) {
+			return false;
+		}
+		invalidate_scroll_surfaces(map, x, y);
+		return true;
+	}
+
+	if (x < 0 || y < 0 || x >= layer->width || y >= layer->height) {
+		return false;
+	}
+
+	int i = x+(y*layer->width), old_gid = get_layer_gid(layer, i);
+	set_layer_cell(layer, i, id);
+	update_layer_spans(layer, y);
+	update_animated_cell(map, layer, i, old_gid, gid);
+	update_tile_queries(map, layer, x, y, id);
+	invalidate_render_cache(layer, x, y);
+	patch_vertex_cache(map, layer, x, y);
+	invalidate_scroll_surfaces(map, x, y);
+	return true;
+}
+
 /*
  * Gets the tile at the given location on the given layer.
  */
@@ -107,10 +173,11 @@ ALLEGRO_MAP_OBJECT **al_get_objects_for_name(ALLEGRO_MAP_LAYER *layer, char *nam
 	}
 
 	ALLEGRO_MAP_OBJECT **results = (ALLEGRO_MAP_OBJECT**)al_malloc(sizeof(ALLEGRO_MAP_OBJECT*) * (*length));
+	GSList *match = matches;
 	int i;
 	for (i = 0; i<(*length); i++) {
-		results[i] = matches->data;
-		matches = g_slist_next(matches);
+		results[i] = match->data;
+		match = g_slist_next(match);
 	}
 
 	g_slist_free(matches);
@@ -145,12 +212,57 @@ ALLEGRO_MAP_OBJECT **al_get_objects(ALLEGRO_MAP_LAYER *layer, int *length)
 	return results;
 }
 
+/*
+ * Finds the objects on the given layer whose bounds overlap the given
+ * rectangle (in pixels), and stores up to max of them in results, in
+ * the order they're listed on the layer. Tile objects extend up from
+ * their position, like they're drawn. The objects are copied into
+ * results, which stay valid however the layer is searched or drawn
+ * afterwards. They're gathered in a list the layer reuses for every
+ * search and draw, which only grows when a search finds more objects
+ * than any before it, so it's cheap enough to call every frame; but it
+ * mustn't be called on several threads at once for the same layer.
+ * Returns the number of objects found, which may be more than max.
+ */
+int al_get_objects_in_rect(ALLEGRO_MAP_LAYER *layer, float x, float y, float width, float height, ALLEGRO_MAP_OBJECT **results, int max)
+{
+	if (layer->type != OBJECT_LAYER || !layer->object_grid) {
+		return 0;
+	}
+
+	int count = find_grid_objects(layer->object_grid, x, y, x + width, y + height);
+	if (count > 0 && max > 0) {
+		memcpy(results, layer->object_grid->found, MIN(count, max) * sizeof(ALLEGRO_MAP_OBJECT*));
+	}
+
+	return count;
+}
+
+/*
+ * Moves an object to the given position, keeping its layer's index of
+ * objects by position up to date.
+ */
+void al_set_object_pos(ALLEGRO_MAP_OBJECT *object, int x, int y)
+{
+	OBJECT_GRID *grid = object->layer->object_grid;
+	if (grid) {
+		remove_grid_object(grid, object);
+	}
+
+	object->x = x;
+	object->y = y;
+
+	if (grid) {
+		insert_grid_object(grid, object);
+	}
+}
+
 /*
  * Returns true if the tile at the given location is flipped horizontally.
  */
 bool flipped_horizontally(ALLEGRO_MAP_LAYER *layer, int x, int y)
 {
-	return lookup_tile(layer, x, y) & FLIPPED_HORIZONTALLY_FLAG;
+	return lookup_flips(layer, x, y) & FLIPPED_HORIZONTALLY_FLAG;
 }
 
 /*
@@ -158,7 +270,7 @@ bool flipped_horizontally(ALLEGRO_MAP_LAYER *layer, int x, int y)
  */
 bool flipped_vertically(ALLEGRO_MAP_LAYER *layer, int x, int y)
 {
-	return lookup_tile(layer, x, y) & FLIPPED_VERTICALLY_FLAG;
+	return lookup_flips(layer, x, y) & FLIPPED_VERTICALLY_FLAG;
 }
 /*
 
@@ -166,19 +278,94 @@ bool flipped_vertically(ALLEGRO_MAP_LAYER *layer, int x, int y)
  */
 bool flipped_diagonally(ALLEGRO_MAP_LAYER *layer, int x, int y)
 {
-	return lookup_tile(layer, x, y) & FLIPPED_DIAGONALLY_FLAG;
+	return lookup_flips(layer, x, y) & FLIPPED_DIAGONALLY_FLAG;
 }
 
 /*
- * Looks up tiles in a map by id.
+ * Finds the tileset a gid belongs to, which is the one with the
+ * highest firstgid not past it.
+ */
+static ALLEGRO_MAP_TILESET *find_tileset(ALLEGRO_MAP *map, int id)
+{
+	ALLEGRO_MAP_TILESET *found = NULL;
+	GSList *tilesets = map->tilesets;
+	while (tilesets) {
+		ALLEGRO_MAP_TILESET *tileset = (ALLEGRO_MAP_TILESET*)tilesets->data;
+		tilesets = g_slist_next(tilesets);
+		if (tileset->firstgid <= id && (!found || tileset->firstgid > found->firstgid)) {
+			found = tileset;
+		}
+	}
+
+	return found;
+}
+
+/*
+ * Creates the tile object for an id if the map file didn't define one,
+ * and cuts its bitmap out of the tileset's image.
+ */
+static ALLEGRO_MAP_TILE *materialize_tile(ALLEGRO_MAP *map, int id)
+{
+	ALLEGRO_MAP_TILE *tile = map->tiles[id];
+	if (!tile) {
+		// gids past the end of their tileset's image have no tile
+		ALLEGRO_MAP_TILESET *tileset = find_tileset(map, id);
+		if (!tileset || !tileset_has_tile(tileset, id - tileset->firstgid)) {
+			return NULL;
+		}
+
+		// wasn't defined in the map file, presumably because it had no properties
+		tile = ARENA_NEW(map->arena, ALLEGRO_MAP_TILE);
+		tile->id = id;
+		tile->tileset = tileset;
+		tileset->tiles = arena_slist_prepend(map->arena, tileset->tiles, tile);
+		map->tiles[id] = tile;
+	}
+
+	ALLEGRO_MAP_TILESET *tileset = tile->tileset;
+	if (map->atlas_tiles) {
+		tile->bitmap = map->atlas_tiles[id];
+	}
+
+	if (!tile->bitmap) {
+		tile->bitmap = get_tileset_image_tile(tileset->image,
+				tile->id - tileset->firstgid,
+				tileset->tilewidth,
+				tileset->tileheight);
+	}
+	if (tile->bitmap) {
+		map->materialized_tiles++;
+	}
+
+	// tiles past the end of their tileset's image have no bitmap, so
+	// don't look for one every time they're drawn
+	tile->materialized = true;
+	return tile;
+}
+
+/*
+ * Looks up tiles in a map by id, creating them on first use.
  */
 ALLEGRO_MAP_TILE *al_get_tile_for_id(ALLEGRO_MAP *map, int id)
 {
-	if (id == 0) {
+	if (id <= 0 || id >= map->tiles_length) {
 		return NULL;
 	}
 
-	return (ALLEGRO_MAP_TILE*)g_hash_table_lookup(map->tiles, GINT_TO_POINTER(id));
+	ALLEGRO_MAP_TILE *tile = map->tiles[id];
+	if (!tile || !tile->materialized) {
+		tile = materialize_tile(map, id);
+	}
+
+	return tile;
+}
+
+/*
+ * Finds a property of a tile by name, or NULL.
+ */
+static const PROPERTY *find_tile_property(ALLEGRO_MAP_TILE *tile, char *name)
+{
+	return tile ? find_property_for_name(tile->properties, name) : NULL;
 }
 
 /*
@@ -186,12 +373,82 @@ ALLEGRO_MAP_TILE *al_get_tile_for_id(ALLEGRO_MAP *map, int id)
  */
 char *al_get_tile_property(ALLEGRO_MAP_TILE *tile, char *name, char *def)
 {
-	if (tile) {
-		char *value = g_hash_table_lookup(tile->properties, name);
-		return value ? value : def;
-	}
+	const PROPERTY *property = find_tile_property(tile, name);
+	return property ? property->value : def;
+}
 
-	return def;
+/*
+ * Get a property from a tile as an integer. "true" and "false" count as 1 and 0.
+ * Returns def if the tile doesn't have it or it isn't an integer.
+ */
+int al_get_tile_property_int(ALLEGRO_MAP_TILE *tile, char *name, int def)
+{
+	const PROPERTY *property = find_tile_property(tile, name);
+	return property && (property->types & PROPERTY_INT) ? property->int_value : def;
+}
+
+/*
+ * Get a property from a tile as a float.
+ * Returns def if the tile doesn't have it or it isn't a number.
+ */
+float al_get_tile_property_float(ALLEGRO_MAP_TILE *tile, char *name, float def)
+{
+	const PROPERTY *property = find_tile_property(tile, name);
+	return property && (property->types & PROPERTY_FLOAT) ? property->float_value : def;
+}
+
+/*
+ * Get a property from a tile as a boolean. Numbers are true if nonzero.
+ * Returns def if the tile doesn't have it or it isn't "true", "false" or a number.
+ */
+bool al_get_tile_property_bool(ALLEGRO_MAP_TILE *tile, char *name, bool def)
+{
+	const PROPERTY *property = find_tile_property(tile, name);
+	return property && (property->types & PROPERTY_BOOL) ? property->bool_value : def;
+}
+
+/*
+ * Same as al_get_tile_property, but with a key from al_get_map_property_key.
+ */
+char *al_get_tile_property_for_key(ALLEGRO_MAP_TILE *tile, ALLEGRO_MAP_PROPERTY_KEY *key, char *def)
+{
+	const PROPERTY *property = tile ? find_property(tile->properties, (const char *)key) : NULL;
+	return property ? property->value : def;
+}
+
+/*
+ * Same as al_get_tile_property_int, but with a key from al_get_map_property_key.
+ */
+int al_get_tile_property_int_for_key(ALLEGRO_MAP_TILE *tile, ALLEGRO_MAP_PROPERTY_KEY *key, int def)
+{
+	const PROPERTY *property = tile ? find_property(tile->properties, (const char *)key) : NULL;
+	return property && (property->types & PROPERTY_INT) ? property->int_value : def;
+}
+
+/*
+ * Same as al_get_tile_property_float, but with a key from al_get_map_property_key.
+ */
+float al_get_tile_property_float_for_key(ALLEGRO_MAP_TILE *tile, ALLEGRO_MAP_PROPERTY_KEY *key, float def)
+{
+	const PROPERTY *property = tile ? find_property(tile->properties, (const char *)key) : NULL;
+	return property && (property->types & PROPERTY_FLOAT) ? property->float_value : def;
+}
+
+/*
+ * Same as al_get_tile_property_bool, but with a key from al_get_map_property_key.
+ */
+bool al_get_tile_property_bool_for_key(ALLEGRO_MAP_TILE *tile, ALLEGRO_MAP_PROPERTY_KEY *key, bool def)
+{
+	const PROPERTY *property = tile ? find_property(tile->properties, (const char *)key) : NULL;
+	return property && (property->types & PROPERTY_BOOL) ? property->bool_value : def;
+}
+
+/*
+ * Finds a property of an object by name, or NULL.
+ */
+static const PROPERTY *find_object_property(ALLEGRO_MAP_OBJECT *object, char *name)
+{
+	return object ? find_property_for_name(object->properties, name) : NULL;
 }
 
 /*
@@ -199,12 +456,35 @@ char *al_get_tile_property(ALLEGRO_MAP_TILE *tile, char *name, char *def)
  */
 char *al_get_object_property(ALLEGRO_MAP_OBJECT *object, char *name, char *def)
 {
-	if (object) {
-		char *value = g_hash_table_lookup(object->properties, name);
-		return value ? value : def;
-	}
+	const PROPERTY *property = find_object_property(object, name);
+	return property ? property->value : def;
+}
+
+/*
+ * Get a property from an object as an integer; see al_get_tile_property_int.
+ */
+int al_get_object_property_int(ALLEGRO_MAP_OBJECT *object, char *name, int def)
+{
+	const PROPERTY *property = find_object_property(object, name);
+	return property && (property->types & PROPERTY_INT) ? property->int_value : def;
+}
 
-	return def;
+/*
+ * Get a property from an object as a float; see al_get_tile_property_float.
+ */
+float al_get_object_property_float(ALLEGRO_MAP_OBJECT *object, char *name, float def)
+{
+	const PROPERTY *property = find_object_property(object, name);
+	return property && (property->types & PROPERTY_FLOAT) ? property->float_value : def;
+}
+
+/*
+ * Get a property from an object as a boolean; see al_get_tile_property_bool.
+ */
+bool al_get_object_property_bool(ALLEGRO_MAP_OBJECT *object, char *name, bool def)
+{
+	const PROPERTY *property = find_object_property(object, name);
+	return property && (property->types & PROPERTY_BOOL) ? property->bool_value : def;
 }
 
 /*
@@ -246,3 +526,181 @@ ALLEGRO_MAP_OBJECT *al_get_object_for_name(ALLEGRO_MAP *map, char *name)
 	}
 	return NULL;
 }
+
+/*
+ * Gets the width of the map in pixels, as drawn.
+ */
+int al_map_get_pixel_width(ALLEGRO_MAP *map)
+{
+	int width, height;
+	switch (map->orientation_kind) {
+		case ORIENTATION_ISOMETRIC:
+			return (map->width + map->height) * map->tile_width / 2;
+		case ORIENTATION_STAGGERED:
+		case ORIENTATION_HEXAGONAL:
+			get_staggered_map_size(map, &width, &height);
+			return width;
+		default:
+			return map->width * map->tile_width;
+	}
+}
+
+/*
+ * Gets the height of the map in pixels, as drawn.
+ */
+int al_map_get_pixel_height(ALLEGRO_MAP *map)
+{
+	int width, height;
+	switch (map->orientation_kind) {
+		case ORIENTATION_ISOMETRIC:
+			return (map->width + map->height) * map->tile_height / 2;
+		case ORIENTATION_STAGGERED:
+		case ORIENTATION_HEXAGONAL:
+			get_staggered_map_size(map, &width, &height);
+			return height;
+		default:
+			return map->height * map->tile_height;
+	}
+}
+
+/*
+ * Finds the size of the largest tile image on the map, which is as far
+ * as a tile can reach from the corner of its cell it's drawn from.
+ */
+void get_tile_extent(ALLEGRO_MAP *map, int *width, int *height)
+{
+	*width = map->tile_width;
+	*height = map->tile_height;
+
+	GSList *tilesets = map->tilesets;
+	while (tilesets) {
+		ALLEGRO_MAP_TILESET *tileset = (ALLEGRO_MAP_TILESET*)tilesets->data;
+		tilesets = g_slist_next(tilesets);
+		*width = MAX(*width, tileset->tilewidth);
+		*height = MAX(*height, tileset->tileheight);
+	}
+}
+
+/*
+ * Finds the cells of an isometric map whose tiles can reach into the
+ * given region of map pixels. They lie between two pairs of diagonals,
+ * d1 <= x + y <= d2 (the screen row) and e1 <= x - y <= e2 (the screen
+ * column).
+ */
+void get_isometric_diagonals(ALLEGRO_MAP *map, float sx, float sy, float sw, float sh, int *d1, int *d2, int *e1, int *e2)
+{
+	float half_width = map->tile_width / 2.0f, half_height = map->tile_height / 2.0f;
+	float origin = map->height * half_width;
+	int extent_width, extent_height;
+	get_tile_extent(map, &extent_width, &extent_height);
+
+	(*d1) = ceilf((sy - map->tile_height) / half_height);
+	(*d2) = floorf((sy + sh + extent_height - map->tile_height) / half_height);
+	(*e1) = ceilf((sx - extent_width - origin) / half_width) + 1;
+	(*e2) = floorf((sx + sw - origin) / half_width) + 1;
+}
+
+/*
+ * Finds the cells of a staggered or hexagonal map whose tiles can reach
+ * into the given region of map pixels, as the rectangle of cells
+ * x1..x2 by y1..y2 that holds them.
+ */
+void get_staggered_bounds(ALLEGRO_MAP *map, float sx, float sy, float sw, float sh, int *x1, int *y1, int *x2, int *y2)
+{
+	STAGGER_GRID grid;
+	get_stagger_grid(map, &grid);
+	int extent_width, extent_height;
+	get_tile_extent(map, &extent_width, &extent_height);
+
+	if (grid.stagger_x) {
+		// shifted cells hang half a cell below the row's unshifted ones
+		int row_step = grid.tile_height + grid.side_length_y;
+		(*x1) = ceilf((sx - extent_width) / grid.column_width);
+		(*x2) = floorf((sx + sw) / grid.column_width);
+		(*y1) = ceilf((sy - grid.tile_height - grid.row_height) / row_step);
+		(*y2) = floorf((sy + sh + extent_height - grid.tile_height) / row_step);
+	} else {
+		// shifted rows start half a cell to the right
+		int column_step = grid.tile_width + grid.side_length_x;
+		(*x1) = ceilf((sx - extent_width - grid.column_width) / column_step);
+		(*x2) = floorf((sx + sw) / column_step);
+		(*y1) = ceilf((sy - grid.tile_height) / grid.row_height);
+		(*y2) = floorf((sy + sh + extent_height - grid.tile_height) / grid.row_height);
+	}
+}
+
+/*
+ * Converts a position in tiles, which may be fractional, to one in map
+ * pixels. Whole positions give the top left corner of a cell, or the
+ * top corner of its diamond on isometric maps. Staggered and hexagonal
+ * maps only convert whole cells, giving the top left corner of the box
+ * the cell's tile is drawn in. A map pixel appears on screen at
+ * (x - sx + dx, y - sy + dy) when drawn with al_draw_map_region.
+ */
+void al_map_tile_to_pixel(ALLEGRO_MAP *map, float tx, float ty, float *px, float *py)
+{
+	STAGGER_GRID grid;
+	switch (map->orientation_kind) {
+		case ORIENTATION_ISOMETRIC:
+			(*px) = (tx - ty + map->height) * map->tile_width / 2.0f;
+			(*py) = (tx + ty) * map->tile_height / 2.0f;
+			break;
+		case ORIENTATION_STAGGERED:
+		case ORIENTATION_HEXAGONAL:
+			get_stagger_grid(map, &grid);
+			get_staggered_cell_pos(&grid, (int)floorf(tx), (int)floorf(ty), px, py);
+			break;
+		default:
+			(*px) = tx * map->tile_width;
+			(*py) = ty * map->tile_height;
+			break;
+	}
+}
+
+/*
+ * Converts a position in map pixels to one in tiles; the reverse of
+ * al_map_tile_to_pixel. Round both down to find the cell the pixel is in.
+ * Staggered and hexagonal maps give the whole cell.
+ */
+void al_map_pixel_to_tile(ALLEGRO_MAP *map, float px, float py, float *tx, float *ty)
+{
+	int x, y;
+	switch (map->orientation_kind) {
+		case ORIENTATION_ISOMETRIC: {
+			float ix = px / map->tile_width - map->height / 2.0f;
+			float iy = py / map->tile_height;
+			(*tx) = iy + ix;
+			(*ty) = iy - ix;
+			break;
+		}
+		case ORIENTATION_STAGGERED:
+		case ORIENTATION_HEXAGONAL:
+			find_staggered_cell(map, px, py, &x, &y);
+			(*tx) = x;
+			(*ty) = y;
+			break;
+		default:
+			(*tx) = px / map->tile_width;
+			(*ty) = py / map->tile_height;
+			break;
+	}
+}
+
+/*
+ * Finds the cell under a position in map pixels, such as the mouse's
+ * position once the drawing offset is undone. Returns false if the
+ * cell is off the edge of the map, which never happens on infinite maps.
+ */
+bool al_map_pixel_to_cell(ALLEGRO_MAP *map, float px, float py, int *tx, int *ty)
+{
+	if (map->orientation_kind == ORIENTATION_STAGGERED || map->orientation_kind == ORIENTATION_HEXAGONAL) {
+		find_staggered_cell(map, px, py, tx, ty);
+	} else {
+		float x, y;
+		al_map_pixel_to_tile(map, px, py, &x, &y);
+		(*tx) = (int)floorf(x);
+		(*ty) = (int)floorf(y);
+	}
+
+	return map->infinite || ((*tx) >= 0 && (*tx) < map->width && (*ty) >= 0 && (*ty) < map->height);
+}
@@ -21,6 +21,18 @@
 #include <allegro5/allegro_tiled.h>
 #include <stdio.h>
 #include "data.h"
+#include "cache.h"
+#include "chunk.h"
+#include "plane.h"
+#include "span.h"
+#include "anim.h"
+#include "stagger.h"
+#include "grid.h"
+#include "property.h"
+#include "query.h"
+#include "render.h"
+#include "scroll.h"
+#include "vertex.h"
 
 // Bits on the far end of the 32-bit global tile ID are used for tile flags
 #define FLIPPED_HORIZONTALLY_FLAG	0x80000000
@@ -28,10 +40,13 @@
 #define FLIPPED_DIAGONALLY_FLAG		0x20000000
 
 int al_get_single_tile_id(ALLEGRO_MAP_LAYER *layer, int x, int y);
+bool al_set_single_tile_id(ALLEGRO_MAP *map, ALLEGRO_MAP_LAYER *layer, int x, int y, int id);
 ALLEGRO_MAP_TILE *al_get_single_tile(ALLEGRO_MAP *map, ALLEGRO_MAP_LAYER *layer, int x, int y);
 ALLEGRO_MAP_TILE **al_get_tiles(ALLEGRO_MAP *map, int x, int y, int *length);
 ALLEGRO_MAP_OBJECT **al_get_objects(ALLEGRO_MAP_LAYER *layer, int *length);
 ALLEGRO_MAP_OBJECT **al_get_objects_for_name(ALLEGRO_MAP_LAYER *layer, char *name, int *length);
+int al_get_objects_in_rect(ALLEGRO_MAP_LAYER *layer, float x, float y, float width, float height, ALLEGRO_MAP_OBJECT **results, int max);
+void al_set_object_pos(ALLEGRO_MAP_OBJECT *object, int x, int y);
 bool flipped_horizontally(ALLEGRO_MAP_LAYER *layer, int x, int y);
 bool flipped_vertically(ALLEGRO_MAP_LAYER *layer, int x, int y);
 bool flipped_diagonally(ALLEGRO_MAP_LAYER *layer, int x, int y);
@@ -41,5 +56,11 @@ ALLEGRO_MAP_LAYER *al_get_layer_for_name(ALLEGRO_MAP *map, char *name);
 
 int al_map_get_pixel_width(ALLEGRO_MAP *map);
 int al_map_get_pixel_height(ALLEGRO_MAP *map);
+void get_tile_extent(ALLEGRO_MAP *map, int *width, int *height);
+void get_isometric_diagonals(ALLEGRO_MAP *map, float sx, float sy, float sw, float sh, int *d1, int *d2, int *e1, int *e2);
+void get_staggered_bounds(ALLEGRO_MAP *map, float sx, float sy, float sw, float sh, int *x1, int *y1, int *x2, int *y2);
+void al_map_tile_to_pixel(ALLEGRO_MAP *map, float tx, float ty, float *px, float *py);
+void al_map_pixel_to_tile(ALLEGRO_MAP *map, float px, float py, float *tx, float *ty);
+bool al_map_pixel_to_cell(ALLEGRO_MAP *map, float px, float py, int *tx, int *ty);
 
 #endif
@@ -35,121 +35,180 @@ static inline _AL_LIST *create_list(size_t capacity)
 */
 
 /*
- * Decodes map data from a <data> node
+ * Flags applied to every map opened after they're set.
  */
-static void decode_layer_data(xmlNode *data_node, ALLEGRO_MAP_LAYER *layer)
-{
-	char *str = g_strstrip((char *)data_node->children->content);
-	int datalen = layer->width * layer->height;
-	layer->data = (int *)calloc(datalen, sizeof(int));
+static int new_map_flags = 0;
 
-	char *encoding = get_xml_attribute(data_node, "encoding");
-	if (!encoding) {
-		int i = 0;
-		GSList *tiles = get_children_for_name(data_node, "tile");
-		GSList *tile_item = tiles;
-		while (tile_item) {
-			xmlNode *tile_node = (xmlNode*)tile_item->data;
-			tile_item = g_slist_next(tile_item);
-			char *gid = get_xml_attribute(tile_node, "gid");
-			layer->data[i] = atoi(gid);
-			i++;
+/*
+ * Number of threads used to decode layer data.
+ */
+static int new_map_decode_threads = 1;
+
+/*
+ * Size of the chunks layers are pre-rendered in, with ALLEGRO_MAP_RENDER_CACHE.
+ */
+static int new_map_render_chunk_size = RENDER_CHUNK_SIZE;
+
+/*
+ * Decodes the gids of unencoded <tile> nodes into data.
+ * Returns the number of <tile> nodes found, or -1 if one has an invalid gid.
+ */
+static int decode_tile_nodes(xmlNode *parent, const char *name, int *data, int datalen)
+{
+	int i = 0;
+	xmlNode *tile_node;
+	for (tile_node = parent->children; tile_node; tile_node = tile_node->next) {
+		if (tile_node->type != XML_ELEMENT_NODE || strcmp((const char*)tile_node->name, "tile")) {
+			continue;
 		}
-		g_slist_free(tiles);
+		// Tiled writes empty cells as a <tile/> with no gid
+		char *gid = get_xml_attribute(tile_node, "gid");
+		if (i < datalen && gid && !parse_gid(gid, &data[i])) {
+			fprintf(stderr, "Error: invalid tile gid in layer \"%s\"\n", name);
+			return -1;
+		}
+		i++;
 	}
-	else if (!strcmp(encoding, "base64")) {
-		// decompress
-		gsize rawlen;
-		unsigned char *rawdata = g_base64_decode(str, &rawlen);
-
-		// check the compression
-		char *compression = get_xml_attribute(data_node, "compression");
-		if (compression != NULL) {
-			if (strcmp(compression, "zlib") && strcmp(compression, "gzip")) {
-				fprintf(stderr, "Error: unknown compression format '%s'\n", compression);
-				return;
-			}
 
-			// set up files used by zlib to decompress the data
-			ALLEGRO_PATH *srcpath;
-			ALLEGRO_FILE *datasrc = al_make_temp_file("XXXXXX", &srcpath);
-			al_fwrite(datasrc, rawdata, rawlen);
-			al_fseek(datasrc, 0, ALLEGRO_SEEK_SET);
-			//al_fclose(datasrc);
-			//datasrc = al_fopen(al_path_cstr(srcpath, ALLEGRO_NATIVE_PATH_SEP), "rb");
-			ALLEGRO_FILE *datadest = al_make_temp_file("XXXXXX", NULL);
-
-			// decompress and print an error if it failed
-			int status = inf(datasrc, datadest);
-			if (status)
-				zerr(status);
-
-			// flush data and get the file length
-			al_fflush(datadest);
-			int len = al_fsize(datadest);
-
-			// read in the file
-			al_fseek(datadest, 0, ALLEGRO_SEEK_SET);
-			char *data = (char *)calloc(len, sizeof(char));
-			if (al_fread(datadest, data, len) != len) {
-				fprintf(stderr, "Error: failed to read in map data\n");
-				return;
-			}
+	return i;
+}
 
-			// every tile id takes 4 bytes
-			int i;
-			for (i = 0; i<len; i += 4) {
-				int tileid = 0;
-				tileid |= data[i];
-				tileid |= data[i+1] << 8;
-				tileid |= data[i+2] << 16;
-				tileid |= data[i+3] << 24;
-				layer->data[i/4] = tileid;
-			}
-			/*	printf("layer dimensions: %dx%d, data length = %d\n", 
-						layer->width, layer->height, len); */
+/*
+ * Decodes the <chunk> nodes of an infinite map's <data> node into
+ * the layer's chunk table.
+ * Returns false if a chunk has no cells, or its data couldn't be decoded.
+ */
+static bool decode_chunk_nodes(xmlNode *data_node, ALLEGRO_MAP *map, ALLEGRO_MAP_LAYER *layer)
+{
+	bool decoded = true;
+	if (!data_node) {
+		layer->chunks = create_chunk_table(map->arena, layer->name, NULL);
+		return true;
+	}
 
-			al_destroy_path(srcpath);
-			al_fclose(datasrc);
-			al_fclose(datadest);
-			al_free(data);
+	char *encoding = get_xml_attribute(data_node, "encoding");
+	char *compression = get_xml_attribute(data_node, "compression");
+	GSList *chunks = NULL;
+
+	GSList *chunk_nodes = get_children_for_name(data_node, "chunk");
+	GSList *chunk_item = chunk_nodes;
+	while (chunk_item) {
+		xmlNode *chunk_node = (xmlNode*)chunk_item->data;
+		chunk_item = g_slist_next(chunk_item);
+
+		int x = atoi(get_xml_attribute(chunk_node, "x"));
+		int y = atoi(get_xml_attribute(chunk_node, "y"));
+		int width = atoi(get_xml_attribute(chunk_node, "width"));
+		int height = atoi(get_xml_attribute(chunk_node, "height"));
+		if (width <= 0 || height <= 0) {
+			fprintf(stderr, "Error: chunk at %d,%d in layer \"%s\" is empty\n", x, y, layer->name);
+			decoded = false;
+			continue;
 		}
-		else {
-			// TODO: verify that this still works
-			int i;
-			for (i = 0; i<rawlen; i += 4) {
-				int tileid = 0;
-				tileid |= rawdata[i];
-				tileid |= rawdata[i+1] << 8;
-				tileid |= rawdata[i+2] << 16;
-				tileid |= rawdata[i+3] << 24;
-
-				layer->data[i/4] = tileid;
+
+		int datalen = width * height;
+		int *data = g_new0(int, datalen);
+		if (!encoding) {
+			int count = decode_tile_nodes(chunk_node, layer->name, data, datalen);
+			if (count < 0) {
+				decoded = false;
+			}
+			else if (count != datalen) {
+				fprintf(stderr, "Error: chunk at %d,%d in layer \"%s\" has %d tiles, expected %d\n", x, y, layer->name, count, datalen);
+				decoded = false;
 			}
 		}
+		else if (!chunk_node->children) {
+			fprintf(stderr, "Error: chunk at %d,%d in layer \"%s\" is empty\n", x, y, layer->name);
+			decoded = false;
+		}
+		else if (!decode_gids(layer->name, data, datalen, encoding, compression, (char *)chunk_node->children->content)) {
+			decoded = false;
+		}
 
-		g_free(rawdata);
+		// once the layer has failed, its chunks are never looked at
+		LAYER_CHUNK *chunk = decoded ? create_layer_chunk(map->arena, x, y, width, height, data) : NULL;
+		if (chunk) {
+			chunks = arena_slist_prepend(map->arena, chunks, chunk);
+		}
+		g_free(data);
 	}
-	else if (!strcmp(encoding, "csv")) {
-		int i;
-		for (i = 0; i<datalen; i++) {
-			char *id = strtok((i == 0 ? str : NULL), ",");
-			layer->data[i] = atoi(id);
+
+	g_slist_free(chunk_nodes);
+	layer->chunks = create_chunk_table(map->arena, layer->name, chunks);
+	return decoded;
+}
+
+/*
+ * Decodes map data from a <data> node
+ * Encoded data may be left on the queue; those failures are reported
+ * when it's finished.
+ * Returns false if the data couldn't be decoded.
+ */
+static bool decode_layer_node(xmlNode *data_node, ALLEGRO_MAP *map, ALLEGRO_MAP_LAYER *layer, DECODE_QUEUE *queue)
+{
+	if (map->infinite) {
+		return decode_chunk_nodes(data_node, map, layer);
+	}
+
+	int datalen = layer->width * layer->height;
+	layer->data = (int *)al_calloc(datalen, sizeof(int));
+
+	// a layer with no <data> is left empty, as the reader leaves it
+	if (!data_node) {
+		return true;
+	}
+
+	char *encoding = get_xml_attribute(data_node, "encoding");
+	if (!encoding) {
+		int i = decode_tile_nodes(data_node, layer->name, layer->data, datalen);
+		if (i < 0) {
+			return false;
 		}
+		if (i != datalen) {
+			fprintf(stderr, "Error: layer \"%s\" has %d tiles, expected %d\n", layer->name, i, datalen);
+			return false;
+		}
+	}
+	else if (!data_node->children) {
+		fprintf(stderr, "Error: layer \"%s\" is empty\n", layer->name);
+		return false;
 	}
 	else {
-		fprintf(stderr, "Error: unknown encoding format '%s'\n", encoding);
+		char *compression = get_xml_attribute(data_node, "compression");
+		queue_layer_data(queue, layer, encoding, compression, (char *)data_node->children->content);
 	}
+
+	return true;
 }
 
 /*
  * After all the tiles have been parsed out of their tilesets,
  * create the map's global list of tiles.
+ * Gids are small and dense, so the list is a flat array indexed by gid
+ * that covers every tileset's range.
  */
 static void cache_tile_list(ALLEGRO_MAP *map)
 {
-	map->tiles = g_hash_table_new(NULL, NULL);
+	int length = 1;
 	GSList *tileset_item = map->tilesets;
+	while (tileset_item != NULL) {
+		ALLEGRO_MAP_TILESET *tileset = (ALLEGRO_MAP_TILESET*)tileset_item->data;
+		tileset_item = g_slist_next(tileset_item);
+		length = MAX(length, tileset->firstgid + tileset_tile_count(tileset));
+
+		GSList *tile_item = tileset->tiles;
+		while (tile_item != NULL) {
+			ALLEGRO_MAP_TILE *tile = (ALLEGRO_MAP_TILE*)tile_item->data;
+			tile_item = g_slist_next(tile_item);
+			length = MAX(length, tile->id + 1);
+		}
+	}
+
+	map->tiles = (ALLEGRO_MAP_TILE **)arena_alloc(map->arena, length * sizeof(ALLEGRO_MAP_TILE *));
+	map->tiles_length = length;
+
+	tileset_item = map->tilesets;
 	while (tileset_item != NULL) {
 		ALLEGRO_MAP_TILESET *tileset = (ALLEGRO_MAP_TILESET*)tileset_item->data;
 		tileset_item = g_slist_next(tileset_item);
@@ -158,67 +217,184 @@ static void cache_tile_list(ALLEGRO_MAP *map)
 			ALLEGRO_MAP_TILE *tile = (ALLEGRO_MAP_TILE*)tile_item->data;
 			tile_item = g_slist_next(tile_item);
 			// associate the tile's id with its ALLEGRO_TILE struct
-			g_hash_table_insert(map->tiles, GINT_TO_POINTER(tile->id), tile);
+			map->tiles[tile->id] = tile;
 		}
 	}
 }
 
 /*
  * Parse a <properties> node into a list of property objects.
+ * Returns NULL if there are none.
  */
-static GHashTable *parse_properties(xmlNode *node)
+static PROPERTY_LIST *parse_properties(ALLEGRO_MAP *map, xmlNode *node)
 {
-	GHashTable *props = g_hash_table_new_full(&g_str_hash, &g_str_equal, &g_free, &g_free);
-
 	xmlNode *properties_node = get_first_child_for_name(node, "properties");
 	if (!properties_node) {
-		return props;
+		return NULL;
 	}
 
-	GSList *properties_list = get_children_for_name(properties_node, "property");
+	GArray *props = g_array_new(FALSE, FALSE, sizeof(PROPERTY));
+
+	// in document order, so that a repeated name keeps its last value
+	GSList *properties_list = g_slist_reverse(get_children_for_name(properties_node, "property"));
 	GSList *property_item = properties_list;
 	while (property_item) {
 		xmlNode *property_node = (xmlNode*)property_item->data;
 		property_item = g_slist_next(property_item);
 
-		char *name = g_strdup(get_xml_attribute(property_node, "name"));
+		char *name = get_xml_attribute(property_node, "name");
+		if (!name) {
+			continue;
+		}
+
 		char *value = get_xml_attribute(property_node, "value");
-		if (!value) {
-			value = (char*)xmlNodeGetContent(property_node);
+		if (value) {
+			value = arena_strdup(map->arena, value);
+		} else {
+			xmlChar *content = xmlNodeGetContent(property_node);
+			value = arena_strdup(map->arena, content ? (const char *)content : "");
+			xmlFree(content);
 		}
 
-		value = g_strdup(value);
-		g_hash_table_insert(props, name, value);
+		add_property(props, name, value);
 	}
 
 	g_slist_free(properties_list);
-	return props;
+	PROPERTY_LIST *list = create_property_list(map->arena, props);
+	g_array_free(props, TRUE);
+	return list;
 }
 
 /*
- * Parses a map file
- * Given the path to a map file, returns a new map struct
- * The struct must be freed once it's done being used
+ * Create every tile used by the layer, along with its bitmap.
  */
-ALLEGRO_MAP *al_open_map(const char *dir, const char *filename)
+static void create_layer_tiles(ALLEGRO_MAP *map, ALLEGRO_MAP_LAYER *layer)
 {
-	xmlDoc *doc;
-	xmlNode *root;
-	ALLEGRO_MAP *map;
+	int i, datalen = layer->width * layer->height;
+	if (layer->chunks) {
+		// chunked layers create their tiles as the chunks are drawn
+		return;
+	}
 
-	unsigned i, j;
+	for (i = 0; i<datalen; i++) {
+		int id = get_layer_gid(layer, i);
+		if (id) {
+			al_get_tile_for_id(map, id);
+		}
+	}
+}
 
-	ALLEGRO_PATH *cwd = al_get_standard_path(ALLEGRO_RESOURCES_PATH);
-	ALLEGRO_PATH *resources = al_clone_path(cwd);
-	ALLEGRO_PATH *maps = al_create_path(dir);
+/*
+ * Works out the layout named by a map's orientation attribute.
+ */
+static enum MapOrientation parse_orientation(const char *orientation)
+{
+	if (!orientation) {
+		return ORIENTATION_UNKNOWN;
+	}
 
-	al_join_paths(resources, maps);
-	if (!al_change_directory(al_path_cstr(resources, ALLEGRO_NATIVE_PATH_SEP))) {
-		fprintf(stderr, "Error: failed to change directory in al_parse_map().");
+	if (!strcmp(orientation, "orthogonal")) {
+		return ORIENTATION_ORTHOGONAL;
+	} else if (!strcmp(orientation, "isometric")) {
+		return ORIENTATION_ISOMETRIC;
+	} else if (!strcmp(orientation, "staggered")) {
+		return ORIENTATION_STAGGERED;
+	} else if (!strcmp(orientation, "hexagonal")) {
+		return ORIENTATION_HEXAGONAL;
 	}
 
-	al_destroy_path(resources);
-	al_destroy_path(maps);
+	return ORIENTATION_UNKNOWN;
+}
+
+/*
+ * Builds the map's tile list, tile bitmaps and object images once
+ * its tilesets and layers have been read in.
+ */
+void finish_map(ALLEGRO_MAP *map)
+{
+	map->orientation_kind = parse_orientation(map->orientation);
+
+	// Shrink the decoded layers down to the fewest bytes per cell, and
+	// find the runs of cells that hold tiles
+	GSList *layer_item = map->tile_layers;
+	while (layer_item) {
+		ALLEGRO_MAP_LAYER *layer = (ALLEGRO_MAP_LAYER*)layer_item->data;
+		layer_item = g_slist_next(layer_item);
+		if (layer->data) {
+			pack_layer_data(layer);
+		}
+		if (!layer->chunks) {
+			index_layer_spans(layer);
+		}
+	}
+
+	// Create the map's master list of tiles
+	cache_tile_list(map);
+
+	if (new_map_flags & ALLEGRO_MAP_ATLAS) {
+		pack_map_atlas(map);
+	}
+
+	if (new_map_flags & ALLEGRO_MAP_RENDER_CACHE) {
+		map->render_chunk_size = MAX(new_map_render_chunk_size, 1);
+	}
+	map->vertex_arrays = new_map_flags & ALLEGRO_MAP_VERTEX_ARRAYS;
+
+	// Lazy maps create their tiles the first time they're looked up
+	layer_item = map->tile_layers;
+	while (layer_item && !(new_map_flags & ALLEGRO_MAP_LAZY_TILES)) {
+		ALLEGRO_MAP_LAYER *layer = (ALLEGRO_MAP_LAYER*)layer_item->data;
+		layer_item = g_slist_next(layer_item);
+		create_layer_tiles(map, layer);
+	}
+
+	// Tiles created above go straight into the table the draw loop reads
+	create_draw_bitmaps(map);
+
+	// Animated tiles show their first frame until the map is updated
+	index_map_animations(map);
+
+	// If any objects have a tile gid, cache their image, then index the
+	// objects by position now that they all have their sizes
+	layer_item = map->object_layers;
+	while (layer_item) {
+		ALLEGRO_MAP_LAYER *layer = (ALLEGRO_MAP_LAYER*)layer_item->data;
+		layer_item = g_slist_next(layer_item);
+
+		GSList *objects = layer->objects;
+		while (objects) {
+			ALLEGRO_MAP_OBJECT *object = (ALLEGRO_MAP_OBJECT*)objects->data;
+			objects = g_slist_next(objects);
+			if (!object->gid) {
+				continue;
+			}
+
+			ALLEGRO_MAP_TILE *tile = al_get_tile_for_id(map, object->gid & ~(FLIPPED_HORIZONTALLY_FLAG
+						|FLIPPED_VERTICALLY_FLAG
+						|FLIPPED_DIAGONALLY_FLAG));
+			if (!tile) {
+				continue;
+			}
+
+			object->bitmap = tile->bitmap;
+			object->width = map->tile_width;
+			object->height = map->tile_height;
+		}
+
+		index_layer_objects(layer);
+	}
+}
+
+/*
+ * Reads a map file by loading its whole document tree.
+ * Used in place of the streaming reader when ALLEGRO_MAP_DOM_PARSER is set.
+ */
+ALLEGRO_MAP *parse_map_dom(const char *filename, int threads)
+{
+	DECODE_QUEUE *queue;
+	xmlDoc *doc;
+	xmlNode *root;
+	ALLEGRO_MAP *map;
 
 	// Read in the data file
 	doc = xmlReadFile(filename, NULL, 0);
@@ -231,12 +407,20 @@ ALLEGRO_MAP *al_open_map(const char *dir, const char *filename)
 	root = xmlDocGetRootElement(doc);
 
 	// Get some basic info
-	map = MALLOC(ALLEGRO_MAP);
+	map = create_map();
 	map->width = atoi(get_xml_attribute(root, "width"));
 	map->height = atoi(get_xml_attribute(root, "height"));
 	map->tile_width = atoi(get_xml_attribute(root, "tilewidth"));
 	map->tile_height = atoi(get_xml_attribute(root, "tileheight"));
-	map->orientation = g_strdup(get_xml_attribute(root, "orientation"));
+	map->orientation = arena_strdup(map->arena, get_xml_attribute(root, "orientation"));
+	char *infinite = get_xml_attribute(root, "infinite");
+	map->infinite = infinite && atoi(infinite);
+	char *stagger_axis = get_xml_attribute(root, "staggeraxis");
+	map->stagger_x = stagger_axis && !strcmp(stagger_axis, "x");
+	char *stagger_index = get_xml_attribute(root, "staggerindex");
+	map->stagger_even = stagger_index && !strcmp(stagger_index, "even");
+	char *hex_side_length = get_xml_attribute(root, "hexsidelength");
+	map->hex_side_length = hex_side_length ? atoi(hex_side_length) : 0;
 	map->tile_layer_count = 0;
 	map->object_layer_count = 0;
 
@@ -250,18 +434,28 @@ ALLEGRO_MAP *al_open_map(const char *dir, const char *filename)
 		xmlNode *tileset_node = (xmlNode*)tileset_item->data;
 		tileset_item = g_slist_next(tileset_item);
 
-		ALLEGRO_MAP_TILESET *tileset = MALLOC(ALLEGRO_MAP_TILESET);
+		// kept in its own file
+		char *source = get_xml_attribute(tileset_node, "source");
+		if (source) {
+			ALLEGRO_MAP_TILESET *tileset = load_external_tileset(map, source, atoi(get_xml_attribute(tileset_node, "firstgid")));
+			if (tileset) {
+				map->tilesets = arena_slist_prepend(map->arena, map->tilesets, tileset);
+			}
+			continue;
+		}
+
+		ALLEGRO_MAP_TILESET *tileset = ARENA_NEW(map->arena, ALLEGRO_MAP_TILESET);
 		tileset->firstgid = atoi(get_xml_attribute(tileset_node, "firstgid"));
 		tileset->tilewidth = atoi(get_xml_attribute(tileset_node, "tilewidth"));
 		tileset->tileheight = atoi(get_xml_attribute(tileset_node, "tileheight"));
-		tileset->name = g_strdup(get_xml_attribute(tileset_node, "name"));
+		tileset->name = arena_strdup(map->arena, get_xml_attribute(tileset_node, "name"));
 
 		// Get this tileset's image
 		xmlNode *image_node = get_first_child_for_name(tileset_node, "image");
 		tileset->width = atoi(get_xml_attribute(image_node, "width"));
 		tileset->height = atoi(get_xml_attribute(image_node, "height"));
-		tileset->source = g_strdup(get_xml_attribute(image_node, "source"));
-		tileset->bitmap = al_load_bitmap(tileset->source);
+		tileset->source = arena_strdup(map->arena, get_xml_attribute(image_node, "source"));
+		attach_tileset_image(tileset);
 
 		// Get this tileset's tiles
 		GSList *tiles = get_children_for_name(tileset_node, "tile");
@@ -272,32 +466,55 @@ ALLEGRO_MAP *al_open_map(const char *dir, const char *filename)
 			xmlNode *tile_node = (xmlNode*)tile_item->data;
 			tile_item = g_slist_next(tile_item);
 
-			ALLEGRO_MAP_TILE *tile = MALLOC(ALLEGRO_MAP_TILE);
-			tile->id = tileset->firstgid + atoi(get_xml_attribute(tile_node, "id"));
+			char *tile_id = get_xml_attribute(tile_node, "id");
+			int id = tile_id ? atoi(tile_id) : 0;
+			if (!tileset_has_tile(tileset, id)) {
+				fprintf(stderr, "Error: tileset \"%s\" has no tile %d\n", tileset->name, id);
+				continue;
+			}
+
+			ALLEGRO_MAP_TILE *tile = ARENA_NEW(map->arena, ALLEGRO_MAP_TILE);
+			tile->id = tileset->firstgid + id;
 			tile->tileset = tileset;
 			tile->bitmap = NULL;
 
 			// Get this tile's properties
-			tile->properties = parse_properties(tile_node);
+			tile->properties = parse_properties(map, tile_node);
+
+			// and its animation, if any
+			xmlNode *animation_node = get_first_child_for_name(tile_node, "animation");
+			if (animation_node) {
+				GArray *frames = g_array_new(FALSE, FALSE, sizeof(ANIMATION_FRAME));
+				GSList *frame_nodes = g_slist_reverse(get_children_for_name(animation_node, "frame"));
+				GSList *frame_item = frame_nodes;
+				while (frame_item) {
+					xmlNode *frame_node = (xmlNode*)frame_item->data;
+					frame_item = g_slist_next(frame_item);
+					char *tile_id = get_xml_attribute(frame_node, "tileid");
+					char *duration = get_xml_attribute(frame_node, "duration");
+					ANIMATION_FRAME frame = {tile_id ? atoi(tile_id) : 0, duration ? atoi(duration) : 0};
+					g_array_append_val(frames, frame);
+				}
+				g_slist_free(frame_nodes);
+				set_tile_frames(map->arena, tile, frames);
+				g_array_free(frames, TRUE);
+			}
 
-			// TODO: add a destructor
-			tileset->tiles = g_slist_prepend(tileset->tiles, tile);
+			tileset->tiles = arena_slist_prepend(map->arena, tileset->tiles, tile);
 		}
 
 		g_slist_free(tiles);
 		//tileset->tiles = g_slist_reverse(tileset->tiles);
 
-		// TODO: add a destructor
-		map->tilesets = g_slist_prepend(map->tilesets, tileset);
+		map->tilesets = arena_slist_prepend(map->arena, map->tilesets, tileset);
 	}
 
 	g_slist_free(tilesets);
 	//map->tilesets = g_slist_reverse(map->tilesets);
 
-	// Create the map's master list of tiles
-	cache_tile_list(map);
-
 	// Get the layers
+	queue = create_decode_queue(threads);
+	bool decoded = true;
 	GSList *layers = get_children_for_either_name(root, "layer", "objectgroup");
 	map->layers = NULL;
 
@@ -306,9 +523,9 @@ ALLEGRO_MAP *al_open_map(const char *dir, const char *filename)
 		xmlNode *layer_node = (xmlNode*)layer_item->data;
 		layer_item = g_slist_next(layer_item);
 
-		ALLEGRO_MAP_LAYER *layer = MALLOC(ALLEGRO_MAP_LAYER);
-		layer->name = g_strdup(get_xml_attribute(layer_node, "name"));
-		layer->properties = parse_properties(layer_node);
+		ALLEGRO_MAP_LAYER *layer = ARENA_NEW(map->arena, ALLEGRO_MAP_LAYER);
+		layer->name = arena_strdup(map->arena, get_xml_attribute(layer_node, "name"));
+		layer->properties = parse_properties(map, layer_node);
 
 		char *layer_visible = get_xml_attribute(layer_node, "visible");
 		layer->visible = (layer_visible != NULL ? atoi(layer_visible) : 1);
@@ -320,61 +537,11 @@ ALLEGRO_MAP *al_open_map(const char *dir, const char *filename)
 			layer->type = TILE_LAYER;
 			layer->width = atoi(get_xml_attribute(layer_node, "width"));
 			layer->height = atoi(get_xml_attribute(layer_node, "height"));
-			decode_layer_data(get_first_child_for_name(layer_node, "data"), layer);
-			// Create any missing tile objects
-			for (i = 0; i<layer->height; i++) {
-				for (j = 0; j<layer->width; j++) {
-					
-					int id = al_get_single_tile_id(layer, j, i);
-					
-					if (id == 0) {
-						continue;
-					}
-					ALLEGRO_MAP_TILE *tile = al_get_tile_for_id(map, id);
-					if (!tile) {
-						// wasn't defined in the map file, presumably because it had no properties
-						tile = MALLOC(ALLEGRO_MAP_TILE);
-						tile->id = id;
-						tile->properties = g_hash_table_new(NULL, NULL);
-						tile->tileset = NULL;
-						tile->bitmap = NULL;
-						
-						// locate its tilemap
-						GSList *tilesets = map->tilesets;
-						ALLEGRO_MAP_TILESET *tileset_ref;
-						while (tilesets) {
-							ALLEGRO_MAP_TILESET *tileset = (ALLEGRO_MAP_TILESET*)tilesets->data;
-							tilesets = g_slist_next(tilesets);
-							if (tileset->firstgid <= id) {
-								if (!tile->tileset || tileset->firstgid > tile->tileset->firstgid) {
-									tileset_ref = tileset;
-								}
-							}
-
-						}
-
-						tile->tileset = tileset_ref;
-						tileset_ref->tiles = g_slist_prepend(tileset_ref->tiles, tile);
-						g_hash_table_insert(map->tiles, GINT_TO_POINTER(tile->id), tile);
-					}
-
-					// create this tile's bitmap if it hasn't been yet
-					if (!tile->bitmap) {
-						ALLEGRO_MAP_TILESET *tileset = tile->tileset;
-						int id = tile->id - tileset->firstgid;
-						int width = tileset->width / tileset->tilewidth;
-						int x = (id % width) * tileset->tilewidth;
-						int y = (id / width) * tileset->tileheight;
-						tile->bitmap = al_create_sub_bitmap(
-								tileset->bitmap,
-								x, y,
-								tileset->tilewidth,
-								tileset->tileheight);
-					}
-				}
+			if (!decode_layer_node(get_first_child_for_name(layer_node, "data"), map, layer, queue)) {
+				decoded = false;
 			}
 			map->tile_layer_count++;
-			map->tile_layers = g_slist_prepend(map->tile_layers, layer);
+			map->tile_layers = arena_slist_prepend(map->arena, map->tile_layers, layer);
 		} else if (!strcmp((const char*)layer_node->name, "objectgroup")) {
 			layer->type = OBJECT_LAYER;
 			layer->objects = NULL;
@@ -386,10 +553,10 @@ ALLEGRO_MAP *al_open_map(const char *dir, const char *filename)
 				xmlNode *object_node = (xmlNode*)object_item->data;
 				object_item = g_slist_next(object_item);
 
-				ALLEGRO_MAP_OBJECT *object = MALLOC(ALLEGRO_MAP_OBJECT);
+				ALLEGRO_MAP_OBJECT *object = ARENA_NEW(map->arena, ALLEGRO_MAP_OBJECT);
 				object->layer = layer;
-				object->name = g_strdup(get_xml_attribute(object_node, "name"));
-				object->type = g_strdup(get_xml_attribute(object_node, "type"));
+				object->name = arena_strdup(map->arena, get_xml_attribute(object_node, "name"));
+				object->type = arena_strdup(map->arena, get_xml_attribute(object_node, "type"));
 				object->x = atoi(get_xml_attribute(object_node, "x"));
 				object->y = atoi(get_xml_attribute(object_node, "y"));
 
@@ -408,47 +575,175 @@ ALLEGRO_MAP *al_open_map(const char *dir, const char *filename)
 				object->visible = (object_visible ? atoi(object_visible) : 1);
 
 				// Get the object's properties
-				object->properties = parse_properties(object_node);
-				layer->objects = g_slist_prepend(layer->objects, object);
+				object->properties = parse_properties(map, object_node);
+				layer->objects = arena_slist_prepend(map->arena, layer->objects, object);
 				layer->object_count++;
 			}
+			g_slist_free(objects);
 			map->object_layer_count++;
-			map->object_layers = g_slist_prepend(map->object_layers, layer);
+			map->object_layers = arena_slist_prepend(map->arena, map->object_layers, layer);
 		} else {
 			fprintf(stderr, "Error: found invalid layer node \"%s\"\n", layer_node->name);
 			continue;
 		}
 
-		map->layers = g_slist_prepend(map->layers, layer);
+		map->layers = arena_slist_prepend(map->arena, map->layers, layer);
 	}
 
 	g_slist_free(layers);
-	
-	// If any objects have a tile gid, cache their image
-	layer_item = map->layers;
-	while (layer_item) {
-		ALLEGRO_MAP_LAYER *layer = (ALLEGRO_MAP_LAYER*)layer_item->data;
-		layer_item = g_slist_next(layer_item);
-		if (layer->type != OBJECT_LAYER) {
-			continue;
-		}
+	decoded = finish_decode_queue(queue) && decoded;
+	xmlFreeDoc(doc);
 
-		GSList *objects = layer->objects;
-		while (objects) {
-			ALLEGRO_MAP_OBJECT *object = (ALLEGRO_MAP_OBJECT*)objects->data;
-			objects = g_slist_next(objects);
-			if (!object->gid) {
-				continue;
-			}
+	if (!decoded) {
+		fprintf(stderr, "Error: failed to decode map data: %s\n", filename);
+		al_free_map(map);
+		return NULL;
+	}
 
-			object->bitmap = al_get_tile_for_id(map, object->gid)->bitmap;
-			object->width = map->tile_width;
-			object->height = map->tile_height;
-		}
+	return map;
+}
+
+/*
+ * Sets the flags used by every map opened from now on.
+ */
+void al_set_new_map_flags(int flags)
+{
+	new_map_flags = flags;
+}
+
+/*
+ * Gets the flags used by newly opened maps.
+ */
+int al_get_new_map_flags(void)
+{
+	return new_map_flags;
+}
+
+/*
+ * Sets how many threads newly opened maps decode their layers on.
+ * 1 (the default) decodes on the calling thread, 0 uses one thread per
+ * processor. Tiles and their bitmaps are always created on the calling
+ * thread.
+ */
+void al_set_new_map_decode_threads(int threads)
+{
+	new_map_decode_threads = threads;
+}
+
+/*
+ * Gets how many threads newly opened maps decode their layers on.
+ */
+int al_get_new_map_decode_threads(void)
+{
+	return new_map_decode_threads;
+}
+
+/*
+ * Sets the size, in pixels, of the chunks newly opened maps pre-render
+ * their layers in when ALLEGRO_MAP_RENDER_CACHE is set. Chunks are
+ * rounded down to whole tiles. Defaults to RENDER_CHUNK_SIZE.
+ */
+void al_set_new_map_render_chunk_size(int size)
+{
+	new_map_render_chunk_size = size;
+}
+
+/*
+ * Gets the size of the chunks newly opened maps pre-render their layers in.
+ */
+int al_get_new_map_render_chunk_size(void)
+{
+	return new_map_render_chunk_size;
+}
+
+/*
+ * Changes into the given map directory, relative to the resources path,
+ * so that tileset images resolve against it.
+ * Returns the path to change back to with leave_map_directory().
+ */
+ALLEGRO_PATH *enter_map_directory(const char *dir)
+{
+	ALLEGRO_PATH *cwd = al_get_standard_path(ALLEGRO_RESOURCES_PATH);
+	ALLEGRO_PATH *resources = al_clone_path(cwd);
+	ALLEGRO_PATH *maps = al_create_path(dir);
+
+	al_join_paths(resources, maps);
+	if (!al_change_directory(al_path_cstr(resources, ALLEGRO_NATIVE_PATH_SEP))) {
+		fprintf(stderr, "Error: failed to change directory in al_parse_map().");
 	}
 
-	xmlFreeDoc(doc);
+	al_destroy_path(resources);
+	al_destroy_path(maps);
+	return cwd;
+}
+
+/*
+ * Changes back to the directory that was current before enter_map_directory().
+ */
+void leave_map_directory(ALLEGRO_PATH *cwd)
+{
 	al_change_directory(al_path_cstr(cwd, ALLEGRO_NATIVE_PATH_SEP));
+	al_destroy_path(cwd);
+}
+
+/*
+ * Returns a copy of the filename made absolute against the current directory,
+ * with "." and "dir/.." components collapsed so that one file always
+ * resolves to the same string.
+ */
+char *resolve_map_path(const char *filename)
+{
+	char *current = al_get_current_directory();
+	ALLEGRO_PATH *head = al_create_path_for_directory(current);
+	ALLEGRO_PATH *path = al_create_path(filename);
+
+	al_rebase_path(head, path);
+
+	int i = 0;
+	while (i < al_get_path_num_components(path)) {
+		const char *component = al_get_path_component(path, i);
+		if (!strcmp(component, ".")) {
+			al_remove_path_component(path, i);
+		} else if (!strcmp(component, "..") && i > 0 && strcmp(al_get_path_component(path, i - 1), "..")) {
+			al_remove_path_component(path, i);
+			al_remove_path_component(path, i - 1);
+			i--;
+		} else {
+			i++;
+		}
+	}
+	char *resolved = g_strdup(al_path_cstr(path, ALLEGRO_NATIVE_PATH_SEP));
+
+	al_destroy_path(path);
+	al_destroy_path(head);
+	al_free(current);
+	return resolved;
+}
+
+/*
+ * Parses a map file
+ * Given the path to a map file, returns a new map struct
+ * The struct must be freed once it's done being used
+ * Returns NULL if the file can't be read or its layer data can't be decoded
+ */
+ALLEGRO_MAP *al_open_map(const char *dir, const char *filename)
+{
+	ALLEGRO_MAP *map;
+	ALLEGRO_PATH *cwd = enter_map_directory(dir);
+
+	if (new_map_flags & ALLEGRO_MAP_DOM_PARSER) {
+		map = parse_map_dom(filename, new_map_decode_threads);
+	} else {
+		map = parse_map_stream(filename, new_map_decode_threads);
+	}
+
+	if (map) {
+		char *source = resolve_map_path(filename);
+		map->source = arena_strdup(map->arena, source);
+		g_free(source);
+		finish_map(map);
+	}
 
+	leave_map_directory(cwd);
 	return map;
 }
@@ -23,9 +23,23 @@
 #include <glib.h>
 #include "data.h"
 #include "map.h"
+#include "cache.h"
+#include "atlas.h"
+#include "tsx.h"
+#include "chunk.h"
+#include "plane.h"
+#include "span.h"
+#include "grid.h"
+#include "render.h"
+#include "draw.h"
 #include "xml.h"
-#include "zpipe.h"
+#include "decode.h"
+#include "reader.h"
 
-#define MALLOC(x) (x *)al_malloc(sizeof(x))
+void finish_map(ALLEGRO_MAP *map);
+ALLEGRO_MAP *parse_map_dom(const char *filename, int threads);
+ALLEGRO_PATH *enter_map_directory(const char *dir);
+void leave_map_directory(ALLEGRO_PATH *cwd);
+char *resolve_map_path(const char *filename);
 
 #endif
@@ -0,0 +1,196 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ *
+ *
+ *                               ---
+ *
+ * Compact storage for the cells of tile layers.
+ *
+ * Tiled hands us every cell as a 32-bit id whose top three bits are
+ * flip flags, but most maps use far fewer than 65536 gids and flip
+ * few tiles, if any. Once a layer is decoded, its ids are split into
+ * a gid plane of 1, 2 or 4 bytes per cell (the smallest that holds the
+ * layer's largest gid) and a flip plane of one nibble per cell, which
+ * is left out entirely when nothing on the layer is flipped.
+ *
+ * The planes of a parsed map belong to its layers and are allocated
+ * with al_malloc rather than from the map's arena, so they can be
+ * resized; those of a compiled map live in (or next to) its mapped
+ * image until a cell is set that they can't hold, at which point the
+ * layer gets its own copy.
+ */
+
+#include "plane.h"
+
+/*
+ * Bytes taken by the layer's gid plane.
+ */
+size_t gid_plane_size(ALLEGRO_MAP_LAYER *layer)
+{
+	return (size_t)layer->width * layer->height * layer->gid_size;
+}
+
+/*
+ * Bytes taken by the layer's flip plane, if it has one.
+ */
+size_t flip_plane_size(ALLEGRO_MAP_LAYER *layer)
+{
+	return ((size_t)layer->width * layer->height + 1) / 2;
+}
+
+/*
+ * Splits the decoded ids in layer->data into a gid plane and, if any
+ * cell is flipped, a flip plane. The gid plane is packed in place over
+ * layer->data, which is then shrunk to fit and handed over to it, so
+ * loading never needs room for both at once.
+ */
+void pack_layer_data(ALLEGRO_MAP_LAYER *layer)
+{
+	const guint32 flip_bits = FLIP_MASK << FLIP_SHIFT;
+	int i, datalen = layer->width * layer->height;
+	guint32 *data = (guint32 *)layer->data;
+
+	// find the largest gid and whether anything is flipped
+	guint32 max_gid = 0, flipped = 0;
+	for (i = 0; i<datalen; i++) {
+		max_gid = MAX(max_gid, data[i] & ~flip_bits);
+		flipped |= data[i];
+	}
+
+	if (max_gid <= GID_PLANE_8_MAX) {
+		layer->gid_size = 1;
+	} else if (max_gid <= GID_PLANE_16_MAX) {
+		layer->gid_size = 2;
+	} else {
+		layer->gid_size = 4;
+	}
+
+	if (flipped & flip_bits) {
+		layer->flips = (guint8 *)al_calloc(flip_plane_size(layer), 1);
+		layer->owned_planes |= PLANE_FLIPS;
+		for (i = 0; i<datalen; i++) {
+			guint8 flips = (data[i] >> FLIP_SHIFT) & FLIP_MASK;
+			layer->flips[i >> 1] |= flips << ((i & 1) << 2);
+		}
+	}
+
+	// cell i is never written past the end of id i, so a forward pass
+	// only overwrites ids that have already been read
+	switch (layer->gid_size) {
+		case 1: {
+			guint8 *gids = (guint8 *)data;
+			for (i = 0; i<datalen; i++) {
+				gids[i] = data[i] & ~flip_bits;
+			}
+			break;
+		}
+		case 2: {
+			guint16 *gids = (guint16 *)data;
+			for (i = 0; i<datalen; i++) {
+				gids[i] = data[i] & ~flip_bits;
+			}
+			break;
+		}
+		default:
+			for (i = 0; i<datalen; i++) {
+				data[i] &= ~flip_bits;
+			}
+			break;
+	}
+
+	void *gids = al_realloc(data, MAX(gid_plane_size(layer), 1));
+	layer->gids = gids ? gids : data;
+	layer->owned_planes |= PLANE_GIDS;
+	layer->data = NULL;
+}
+
+/*
+ * Moves the gid plane to a wider cell size, so larger gids fit.
+ */
+static void widen_gid_plane(ALLEGRO_MAP_LAYER *layer, int gid_size)
+{
+	int i, datalen = layer->width * layer->height;
+	void *gids = al_malloc(MAX((size_t)datalen * gid_size, 1));
+
+	for (i = 0; i<datalen; i++) {
+		if (gid_size == 2) {
+			((guint16 *)gids)[i] = get_layer_gid(layer, i);
+		} else {
+			((guint32 *)gids)[i] = get_layer_gid(layer, i);
+		}
+	}
+
+	if (layer->owned_planes & PLANE_GIDS) {
+		al_free(layer->gids);
+	}
+	layer->gids = gids;
+	layer->gid_size = gid_size;
+	layer->owned_planes |= PLANE_GIDS;
+}
+
+/*
+ * Stores a raw id (gid and flip flags) in the cell at index i. The gid
+ * plane is widened if the gid doesn't fit it, and a flip plane is
+ * added the first time a cell on the layer is flipped.
+ */
+void set_layer_cell(ALLEGRO_MAP_LAYER *layer, int i, int raw)
+{
+	const guint32 flip_bits = FLIP_MASK << FLIP_SHIFT;
+	guint32 gid = (guint32)raw & ~flip_bits;
+	guint8 flips = ((guint32)raw >> FLIP_SHIFT) & FLIP_MASK;
+
+	int gid_size = gid <= GID_PLANE_8_MAX ? 1 : gid <= GID_PLANE_16_MAX ? 2 : 4;
+	if (gid_size > layer->gid_size) {
+		widen_gid_plane(layer, gid_size);
+	}
+
+	switch (layer->gid_size) {
+		case 1:
+			((guint8 *)layer->gids)[i] = gid;
+			break;
+		case 2:
+			((guint16 *)layer->gids)[i] = gid;
+			break;
+		default:
+			((guint32 *)layer->gids)[i] = gid;
+			break;
+	}
+
+	if (flips && !layer->flips) {
+		layer->flips = (guint8 *)al_calloc(flip_plane_size(layer), 1);
+		layer->owned_planes |= PLANE_FLIPS;
+	}
+	if (layer->flips) {
+		int shift = (i & 1) << 2;
+		layer->flips[i >> 1] = (layer->flips[i >> 1] & ~(FLIP_MASK << shift)) | (flips << shift);
+	}
+}
+
+/*
+ * Frees whichever of the layer's planes it allocated itself.
+ */
+void free_layer_planes(ALLEGRO_MAP_LAYER *layer)
+{
+	if (layer->owned_planes & PLANE_GIDS) {
+		al_free(layer->gids);
+	}
+	if (layer->owned_planes & PLANE_FLIPS) {
+		al_free(layer->flips);
+	}
+	layer->gids = NULL;
+	layer->flips = NULL;
+	layer->owned_planes = 0;
+}
@@ -0,0 +1,80 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ */
+
+#ifndef _PLANE_H
+#define _PLANE_H
+
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_tiled.h>
+#include <glib.h>
+#include "data.h"
+
+// Where the flip flags sit in a raw 32-bit tile id
+#define FLIP_SHIFT 29
+#define FLIP_MASK 0x7u
+
+// Largest gids that fit the smaller gid planes
+#define GID_PLANE_8_MAX 0xff
+#define GID_PLANE_16_MAX 0xffff
+
+// Planes a layer allocated itself, as opposed to ones in a compiled image
+#define PLANE_GIDS  (1 << 0)
+#define PLANE_FLIPS (1 << 1)
+
+void pack_layer_data(ALLEGRO_MAP_LAYER *layer);
+void set_layer_cell(ALLEGRO_MAP_LAYER *layer, int i, int raw);
+void free_layer_planes(ALLEGRO_MAP_LAYER *layer);
+size_t gid_plane_size(ALLEGRO_MAP_LAYER *layer);
+size_t flip_plane_size(ALLEGRO_MAP_LAYER *layer);
+
+/*
+ * Gets the gid of the cell at index i, without its flip flags.
+ */
+static inline int get_layer_gid(ALLEGRO_MAP_LAYER *layer, int i)
+{
+	switch (layer->gid_size) {
+		case 1:
+			return ((const guint8 *)layer->gids)[i];
+		case 2:
+			return ((const guint16 *)layer->gids)[i];
+		default:
+			return ((const guint32 *)layer->gids)[i];
+	}
+}
+
+/*
+ * Gets the flip flags of the cell at index i as a number from 0 to 7,
+ * as they'd sit in the top bits of a raw id.
+ */
+static inline int get_layer_flip_code(ALLEGRO_MAP_LAYER *layer, int i)
+{
+	if (!layer->flips) {
+		return 0;
+	}
+
+	return (layer->flips[i >> 1] >> ((i & 1) << 2)) & FLIP_MASK;
+}
+
+/*
+ * Gets the flip flags of the cell at index i, in their place in a raw id.
+ */
+static inline int get_layer_flips(ALLEGRO_MAP_LAYER *layer, int i)
+{
+	return (int)((guint32)get_layer_flip_code(layer, i) << FLIP_SHIFT);
+}
+
+#endif
@@ -0,0 +1,156 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ *
+ *
+ *                               ---
+ *
+ * Flat, typed storage for the properties of tiles, layers and objects.
+ *
+ * Property names are interned, so every copy of a name shares one
+ * address and a lookup by key handle compares pointers instead of
+ * strings. Each element's properties are a single array in the map's
+ * arena, sorted by key (or NULL if it has none), and every value is
+ * parsed as an integer, float and boolean once at load, so typed
+ * getters never touch the string again.
+ */
+
+#include "property.h"
+
+/*
+ * Parses the typed values of a property from its string.
+ */
+static void parse_property_value(PROPERTY *property)
+{
+	const char *value = property->value;
+	char *end;
+
+	if (!strcmp(value, "true")) {
+		property->int_value = 1;
+		property->float_value = 1;
+		property->bool_value = true;
+		property->types = PROPERTY_INT | PROPERTY_FLOAT | PROPERTY_BOOL;
+		return;
+	}
+	if (!strcmp(value, "false")) {
+		property->types = PROPERTY_INT | PROPERTY_FLOAT | PROPERTY_BOOL;
+		return;
+	}
+
+	if (*value == '\0') {
+		return;
+	}
+
+	double number = strtod(value, &end);
+	if (*end != '\0') {
+		return;
+	}
+
+	property->float_value = (float)number;
+	property->int_value = (int)strtol(value, &end, 10);
+	property->bool_value = number != 0;
+	property->types = PROPERTY_FLOAT | PROPERTY_BOOL;
+	if (*end == '\0') {
+		property->types |= PROPERTY_INT;
+	}
+}
+
+static int compare_properties(gconstpointer a, gconstpointer b)
+{
+	const PROPERTY *pa = (const PROPERTY *)a, *pb = (const PROPERTY *)b;
+	if (pa->key == pb->key) {
+		return 0;
+	}
+
+	return pa->key < pb->key ? -1 : 1;
+}
+
+/*
+ * Adds a property to a list being built. The name is interned; the
+ * value must stay valid as long as the finished list does.
+ */
+void add_property(GArray *properties, const char *name, char *value)
+{
+	PROPERTY property;
+	memset(&property, 0, sizeof(property));
+	property.key = g_intern_string(name);
+	property.value = value;
+	g_array_append_val(properties, property);
+}
+
+/*
+ * Sorts and parses the properties collected in the array into a list
+ * allocated from the arena. When a name appears more than once, the
+ * last value wins. The array is left empty.
+ * Returns NULL if there are no properties.
+ */
+PROPERTY_LIST *create_property_list(ARENA *arena, GArray *properties)
+{
+	if (properties->len == 0) {
+		return NULL;
+	}
+
+	// the sort is stable, so repeated names stay in the order they were added
+	g_array_sort(properties, &compare_properties);
+
+	PROPERTY_LIST *list = (PROPERTY_LIST *)arena_alloc(arena,
+			sizeof(PROPERTY_LIST) + properties->len * sizeof(PROPERTY));
+
+	guint i;
+	for (i = 0; i<properties->len; i++) {
+		PROPERTY *property = &g_array_index(properties, PROPERTY, i);
+		if (i + 1 < properties->len && g_array_index(properties, PROPERTY, i + 1).key == property->key) {
+			// overridden by a later one
+			continue;
+		}
+
+		list->items[list->count] = *property;
+		parse_property_value(&list->items[list->count]);
+		list->count++;
+	}
+
+	g_array_set_size(properties, 0);
+	return list;
+}
+
+/*
+ * Finds the property with the given name, or NULL. Elements rarely have
+ * more than a few properties, so comparing names beats interning one.
+ */
+const PROPERTY *find_property_for_name(const PROPERTY_LIST *list, const char *name)
+{
+	if (!list || !name) {
+		return NULL;
+	}
+
+	int i;
+	for (i = 0; i<list->count; i++) {
+		if (!strcmp(list->items[i].key, name)) {
+			return &list->items[i];
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Gets a handle for the property with the given name, for use with the
+ * *_for_key getters. Handles stay valid for the life of the program,
+ * so look them up once rather than every time they're used.
+ */
+ALLEGRO_MAP_PROPERTY_KEY *al_get_map_property_key(const char *name)
+{
+	return (ALLEGRO_MAP_PROPERTY_KEY *)g_intern_string(name);
+}
@@ -0,0 +1,77 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ */
+
+#ifndef _PROPERTY_H
+#define _PROPERTY_H
+
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_tiled.h>
+#include <glib.h>
+#include <stdlib.h>
+#include "data.h"
+
+// Which typed values a property's string could be parsed as
+#define PROPERTY_INT   (1 << 0)
+#define PROPERTY_FLOAT (1 << 1)
+#define PROPERTY_BOOL  (1 << 2)
+
+typedef struct {
+	const char *key;            // interned name
+	char *value;                // value as written in the map
+	int int_value;              // value as an integer, if PROPERTY_INT is set
+	float float_value;          // value as a float, if PROPERTY_FLOAT is set
+	bool bool_value;            // value as a boolean, if PROPERTY_BOOL is set
+	int types;                  // PROPERTY_* flags
+} PROPERTY;
+
+struct _PROPERTY_LIST
+{
+	int count;                  // number of properties
+	PROPERTY items[];           // sorted by key address
+};
+
+PROPERTY_LIST *create_property_list(ARENA *arena, GArray *properties);
+void add_property(GArray *properties, const char *name, char *value);
+const PROPERTY *find_property_for_name(const PROPERTY_LIST *list, const char *name);
+
+/*
+ * Finds the property with the given interned key, or NULL.
+ */
+static inline const PROPERTY *find_property(const PROPERTY_LIST *list, const char *key)
+{
+	if (!list || !key) {
+		return NULL;
+	}
+
+	int low = 0, high = list->count - 1;
+	while (low <= high) {
+		int mid = (low + high) / 2;
+		const PROPERTY *property = &list->items[mid];
+		if (property->key == key) {
+			return property;
+		}
+		if (property->key < key) {
+			low = mid + 1;
+		} else {
+			high = mid - 1;
+		}
+	}
+
+	return NULL;
+}
+
+#endif
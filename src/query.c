@@ -0,0 +1,237 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ *
+ *
+ *                               ---
+ *
+ * Compiled boolean tile queries.
+ *
+ * Collision and trigger code tends to ask the same question of a lot
+ * of cells: does the tile here have this property set to true? A query
+ * answers it once per gid up front, in a bitset indexed by gid, so
+ * testing a cell is a plane read and a bit test. A layer can also be
+ * indexed into a grid of one bit per cell, which skips the plane too.
+ *
+ * Tile properties are fixed once a map is loaded, so the gid bitset
+ * never goes stale; grids are kept in step by al_set_single_tile_id.
+ */
+
+#include "query.h"
+
+/*
+ * Returns true if the gid bit of the raw id is set, ignoring flip flags.
+ */
+static inline bool query_gid(ALLEGRO_MAP_TILE_QUERY *query, int id)
+{
+	guint32 gid = (guint32)id & ~(FLIP_MASK << FLIP_SHIFT);
+	return gid < (guint32)query->gids_length && QUERY_BIT(query->gids, gid);
+}
+
+/*
+ * Compiles a query for tiles whose property of the given name is true
+ * (or a non-zero number). Free it with al_destroy_tile_query, or leave
+ * it to be freed along with the map.
+ */
+ALLEGRO_MAP_TILE_QUERY *al_create_tile_query(ALLEGRO_MAP *map, const char *name)
+{
+	ALLEGRO_MAP_TILE_QUERY *query = (ALLEGRO_MAP_TILE_QUERY *)al_calloc(1, sizeof(ALLEGRO_MAP_TILE_QUERY));
+	query->map = map;
+	query->key = g_intern_string(name);
+	query->gids_length = map->tiles_length;
+	query->gids = (guint32 *)al_calloc((map->tiles_length + 31) / 32 + 1, sizeof(guint32));
+
+	// only tiles with properties are defined up front, which are the only
+	// ones that can match
+	int id;
+	for (id = 0; id<map->tiles_length; id++) {
+		ALLEGRO_MAP_TILE *tile = map->tiles[id];
+		if (!tile) {
+			continue;
+		}
+
+		const PROPERTY *property = find_property(tile->properties, query->key);
+		if (property && (property->types & PROPERTY_BOOL) && property->bool_value) {
+			query->gids[id >> 5] |= 1u << (id & 31);
+		}
+	}
+
+	map->queries = g_slist_prepend(map->queries, query);
+	return query;
+}
+
+/*
+ * Finds the grid a query keeps for a layer, or NULL if it isn't indexed.
+ */
+static inline QUERY_GRID *find_query_grid(ALLEGRO_MAP_TILE_QUERY *query, ALLEGRO_MAP_LAYER *layer)
+{
+	if (query->last_grid && query->last_grid->layer == layer) {
+		return query->last_grid;
+	}
+
+	GSList *grids = query->grids;
+	while (grids) {
+		QUERY_GRID *grid = (QUERY_GRID*)grids->data;
+		grids = g_slist_next(grids);
+		if (grid->layer == layer) {
+			query->last_grid = grid;
+			return grid;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Indexes a tile layer into a grid of one bit per cell, which makes
+ * al_query_tile on it a single bit test. Costs width*height/8 bytes.
+ * Chunked layers aren't indexed, since their cells come and go with
+ * streaming; queries on them test the gid bitset instead.
+ * Returns false if the layer can't be indexed.
+ */
+bool al_index_tile_query(ALLEGRO_MAP_TILE_QUERY *query, ALLEGRO_MAP_LAYER *layer)
+{
+	if (layer->type != TILE_LAYER || layer->chunks) {
+		return false;
+	}
+
+	QUERY_GRID *grid = find_query_grid(query, layer);
+	if (!grid) {
+		grid = (QUERY_GRID *)al_malloc(sizeof(QUERY_GRID));
+		grid->layer = layer;
+		grid->bits = NULL;
+		query->grids = g_slist_prepend(query->grids, grid);
+	}
+
+	int i, datalen = layer->width * layer->height;
+	al_free(grid->bits);
+	grid->bits = (guint32 *)al_calloc((datalen + 31) / 32 + 1, sizeof(guint32));
+	for (i = 0; i<datalen; i++) {
+		int gid = get_layer_gid(layer, i);
+		if (gid < query->gids_length && QUERY_BIT(query->gids, gid)) {
+			grid->bits[i >> 5] |= 1u << (i & 31);
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Returns true if the tile with the given id matches the query.
+ * Flip flags in the id are ignored.
+ */
+bool al_query_tile_id(ALLEGRO_MAP_TILE_QUERY *query, int id)
+{
+	return query_gid(query, id);
+}
+
+/*
+ * Returns true if the tile at the given location on the given layer
+ * matches the query. Locations off the layer never match.
+ */
+bool al_query_tile(ALLEGRO_MAP_TILE_QUERY *query, ALLEGRO_MAP_LAYER *layer, int x, int y)
+{
+	if (layer->type != TILE_LAYER) {
+		return false;
+	}
+
+	if (layer->chunks) {
+		return query_gid(query, lookup_chunk_tile(layer->chunks, x, y));
+	}
+
+	if (x < 0 || y < 0 || x >= layer->width || y >= layer->height) {
+		return false;
+	}
+
+	int i = x + y * layer->width;
+	QUERY_GRID *grid = find_query_grid(query, layer);
+	if (grid) {
+		return QUERY_BIT(grid->bits, i);
+	}
+
+	return query_gid(query, get_layer_gid(layer, i));
+}
+
+/*
+ * Brings the grids of every query on the map in line with a cell that
+ * was just set to the given raw id.
+ */
+void update_tile_queries(ALLEGRO_MAP *map, ALLEGRO_MAP_LAYER *layer, int x, int y, int id)
+{
+	int i = x + y * layer->width;
+
+	GSList *queries = map->queries;
+	while (queries) {
+		ALLEGRO_MAP_TILE_QUERY *query = (ALLEGRO_MAP_TILE_QUERY*)queries->data;
+		queries = g_slist_next(queries);
+
+		QUERY_GRID *grid = find_query_grid(query, layer);
+		if (!grid) {
+			continue;
+		}
+
+		if (query_gid(query, id)) {
+			grid->bits[i >> 5] |= 1u << (i & 31);
+		} else {
+			grid->bits[i >> 5] &= ~(1u << (i & 31));
+		}
+	}
+}
+
+/*
+ * Frees a query and its grids.
+ */
+static void free_tile_query(ALLEGRO_MAP_TILE_QUERY *query)
+{
+	GSList *grids = query->grids;
+	while (grids) {
+		QUERY_GRID *grid = (QUERY_GRID*)grids->data;
+		grids = g_slist_next(grids);
+		al_free(grid->bits);
+		al_free(grid);
+	}
+
+	g_slist_free(query->grids);
+	al_free(query->gids);
+	al_free(query);
+}
+
+/*
+ * Destroys a query before its map is freed.
+ */
+void al_destroy_tile_query(ALLEGRO_MAP_TILE_QUERY *query)
+{
+	if (!query) {
+		return;
+	}
+
+	query->map->queries = g_slist_remove(query->map->queries, query);
+	free_tile_query(query);
+}
+
+/*
+ * Frees every query still registered on the map.
+ */
+void free_tile_queries(ALLEGRO_MAP *map)
+{
+	GSList *queries = map->queries;
+	while (queries) {
+		free_tile_query((ALLEGRO_MAP_TILE_QUERY*)queries->data);
+		queries = g_slist_next(queries);
+	}
+
+	g_slist_free(map->queries);
+	map->queries = NULL;
+}
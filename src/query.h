@@ -0,0 +1,50 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ */
+
+#ifndef _QUERY_H
+#define _QUERY_H
+
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_tiled.h>
+#include <glib.h>
+#include "data.h"
+#include "chunk.h"
+#include "plane.h"
+#include "property.h"
+
+// Bit i of a bitset stored as 32-bit words
+#define QUERY_BIT(bits, i) (((bits)[(guint32)(i) >> 5] >> ((guint32)(i) & 31)) & 1)
+
+typedef struct {
+	ALLEGRO_MAP_LAYER *layer;   // layer the grid mirrors
+	guint32 *bits;              // one bit per cell, row by row
+} QUERY_GRID;
+
+struct _ALLEGRO_MAP_TILE_QUERY
+{
+	ALLEGRO_MAP *map;           // map the query was compiled against
+	const char *key;            // interned name of the property tested
+	guint32 *gids;              // one bit per gid, set where the property is true
+	int gids_length;            // number of gids covered, the map's tiles_length
+	GSList *grids;              // QUERY_GRIDs of the layers indexed so far
+	QUERY_GRID *last_grid;      // grid of the last layer asked about
+};
+
+void update_tile_queries(ALLEGRO_MAP *map, ALLEGRO_MAP_LAYER *layer, int x, int y, int id);
+void free_tile_queries(ALLEGRO_MAP *map);
+
+#endif
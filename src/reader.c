@@ -0,0 +1,594 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ *
+ *                               ---
+ *
+ * Streaming map reader built on libxml2's xmlTextReader.
+ * The map is filled in during a single forward pass over the file, so
+ * the document tree (and its copy of every <tile gid>) never exists in
+ * memory all at once.
+ */
+
+#include "reader.h"
+
+/*
+ * Everything the reader needs to remember between nodes.
+ */
+typedef struct {
+	xmlTextReaderPtr reader;
+	DECODE_QUEUE *queue;            // decodes <data> text, maybe in parallel
+	ALLEGRO_MAP *map;
+	ALLEGRO_MAP_TILESET *tileset;   // tileset being read, if any
+	ALLEGRO_MAP_TILE *tile;         // tileset tile being read, if any
+	ALLEGRO_MAP_LAYER *layer;       // layer being read, if any
+	ALLEGRO_MAP_OBJECT *object;     // object being read, if any
+	PROPERTY_LIST **properties;     // where the <properties> being read will go
+	GArray *property_items;         // <property> nodes read so far
+	GArray *frame_items;            // <frame> nodes of the tile being read
+	bool in_data;                   // inside a <data> node
+	char *encoding;                 // encoding of the current <data>
+	char *compression;              // compression of the current <data>
+	int data_index;                 // next cell for unencoded <tile> data
+	bool data_read;                 // encoded text was found in the current <data> or <chunk>
+	bool in_chunk;                  // inside a <chunk> node of an infinite map
+	int chunk_x, chunk_y;           // position of the current <chunk>, in tiles
+	int chunk_width, chunk_height;  // size of the current <chunk>, in tiles
+	int *chunk_data;                // ids of the current <chunk>, reused between chunks
+	int chunk_capacity;             // number of ids chunk_data can hold
+	GSList *chunks;                 // chunks read so far for the current layer
+	bool defer_images;              // leave tileset images unloaded
+	bool decode_failed;             // some layer or chunk data couldn't be read
+} READER_STATE;
+
+/*
+ * Gets a copy of an attribute of the current node, allocated from
+ * the arena, or NULL.
+ */
+static char *get_reader_attribute(xmlTextReaderPtr reader, ARENA *arena, const char *name)
+{
+	xmlChar *value = xmlTextReaderGetAttribute(reader, (const xmlChar *)name);
+	if (!value) {
+		return NULL;
+	}
+
+	char *copy = arena_strdup(arena, (const char *)value);
+	xmlFree(value);
+	return copy;
+}
+
+/*
+ * Gets an integer attribute of the current node, or def if it's missing.
+ * Parsed as unsigned so that gids keep their flip bits.
+ */
+static int get_reader_attribute_int(xmlTextReaderPtr reader, const char *name, int def)
+{
+	xmlChar *value = xmlTextReaderGetAttribute(reader, (const xmlChar *)name);
+	if (!value) {
+		return def;
+	}
+
+	int result = (int)strtoul((const char *)value, NULL, 10);
+	xmlFree(value);
+	return result;
+}
+
+/*
+ * Gets a float attribute of the current node, or def if it's missing.
+ */
+static float get_reader_attribute_float(xmlTextReaderPtr reader, const char *name, float def)
+{
+	xmlChar *value = xmlTextReaderGetAttribute(reader, (const xmlChar *)name);
+	if (!value) {
+		return def;
+	}
+
+	float result = atof((const char *)value);
+	xmlFree(value);
+	return result;
+}
+
+
+/*
+ * Starts a layer of either type. Layers are attached to the map as
+ * soon as they're seen so that a parse error can free everything
+ * through al_free_map().
+ */
+static ALLEGRO_MAP_LAYER *start_layer(READER_STATE *state, enum LayerType type)
+{
+	xmlTextReaderPtr reader = state->reader;
+	ALLEGRO_MAP *map = state->map;
+
+	ALLEGRO_MAP_LAYER *layer = ARENA_NEW(map->arena, ALLEGRO_MAP_LAYER);
+	layer->type = type;
+	layer->name = get_reader_attribute(reader, map->arena, "name");
+	layer->visible = get_reader_attribute_int(reader, "visible", 1);
+	layer->opacity = get_reader_attribute_float(reader, "opacity", 1.0);
+
+	if (type == TILE_LAYER) {
+		map->tile_layer_count++;
+		map->tile_layers = arena_slist_prepend(map->arena, map->tile_layers, layer);
+	} else {
+		map->object_layer_count++;
+		map->object_layers = arena_slist_prepend(map->arena, map->object_layers, layer);
+	}
+
+	map->layers = arena_slist_prepend(map->arena, map->layers, layer);
+	return layer;
+}
+
+/*
+ * Starts reading a <chunk> of an infinite map's layer.
+ * A chunk with no cells fails the load.
+ */
+static void start_chunk(READER_STATE *state)
+{
+	xmlTextReaderPtr reader = state->reader;
+	state->chunk_x = get_reader_attribute_int(reader, "x", 0);
+	state->chunk_y = get_reader_attribute_int(reader, "y", 0);
+	state->chunk_width = get_reader_attribute_int(reader, "width", 0);
+	state->chunk_height = get_reader_attribute_int(reader, "height", 0);
+	if (state->chunk_width <= 0 || state->chunk_height <= 0) {
+		fprintf(stderr, "Error: chunk at %d,%d in layer \"%s\" is empty\n", state->chunk_x, state->chunk_y, state->layer->name);
+		state->decode_failed = true;
+		return;
+	}
+
+	int datalen = state->chunk_width * state->chunk_height;
+	if (datalen > state->chunk_capacity) {
+		state->chunk_data = g_renew(int, state->chunk_data, datalen);
+		state->chunk_capacity = datalen;
+	}
+
+	memset(state->chunk_data, 0, datalen * sizeof(int));
+	state->data_index = 0;
+	state->data_read = false;
+	state->in_chunk = true;
+}
+
+/*
+ * Packs the <chunk> that was just read into the current layer's chunk list.
+ */
+static void end_chunk(READER_STATE *state)
+{
+	ALLEGRO_MAP *map = state->map;
+	int datalen = state->chunk_width * state->chunk_height;
+	if (!state->encoding && state->data_index != datalen) {
+		fprintf(stderr, "Error: chunk at %d,%d in layer \"%s\" has %d tiles, expected %d\n",
+				state->chunk_x, state->chunk_y, state->layer->name, state->data_index, datalen);
+		state->decode_failed = true;
+	}
+	else if (state->encoding && !state->data_read) {
+		fprintf(stderr, "Error: chunk at %d,%d in layer \"%s\" is empty\n",
+				state->chunk_x, state->chunk_y, state->layer->name);
+		state->decode_failed = true;
+	}
+
+	LAYER_CHUNK *chunk = create_layer_chunk(map->arena, state->chunk_x, state->chunk_y,
+			state->chunk_width, state->chunk_height, state->chunk_data);
+	if (chunk) {
+		state->chunks = arena_slist_prepend(map->arena, state->chunks, chunk);
+	}
+
+	state->in_chunk = false;
+}
+
+/*
+ * Handles the start of an element.
+ */
+static void start_element(READER_STATE *state, const char *name)
+{
+	xmlTextReaderPtr reader = state->reader;
+	ALLEGRO_MAP *map = state->map;
+
+	if (state->in_data) {
+		// unencoded data: one <tile gid="..."/> per cell, skipped if it's
+		// outside a chunk of an infinite map, where there's nowhere to put it
+		ALLEGRO_MAP_LAYER *layer = state->layer;
+		int *data = !layer ? NULL : state->in_chunk ? state->chunk_data : layer->data;
+		if (!strcmp(name, "tile") && data) {
+			int datalen = state->in_chunk ? state->chunk_width * state->chunk_height : layer->width * layer->height;
+			if (state->data_index < datalen
+					&& xmlTextReaderMoveToAttribute(reader, (const xmlChar *)"gid") == 1) {
+				// read the value in place rather than copying it out
+				const char *gid = (const char *)xmlTextReaderConstValue(reader);
+				if (!parse_gid(gid, &data[state->data_index])) {
+					fprintf(stderr, "Error: invalid tile gid in layer \"%s\"\n", layer->name);
+					state->decode_failed = true;
+				}
+				xmlTextReaderMoveToElement(reader);
+			}
+			state->data_index++;
+		}
+		else if (!strcmp(name, "chunk") && state->map->infinite) {
+			start_chunk(state);
+		}
+	}
+	else if (!strcmp(name, "map")) {
+		map->width = get_reader_attribute_int(reader, "width", 0);
+		map->height = get_reader_attribute_int(reader, "height", 0);
+		map->tile_width = get_reader_attribute_int(reader, "tilewidth", 0);
+		map->tile_height = get_reader_attribute_int(reader, "tileheight", 0);
+		map->orientation = get_reader_attribute(reader, map->arena, "orientation");
+		map->infinite = get_reader_attribute_int(reader, "infinite", 0);
+		map->hex_side_length = get_reader_attribute_int(reader, "hexsidelength", 0);
+
+		// staggered along y and shifting the odd rows unless told otherwise
+		char *stagger_axis = get_reader_attribute(reader, map->arena, "staggeraxis");
+		char *stagger_index = get_reader_attribute(reader, map->arena, "staggerindex");
+		map->stagger_x = stagger_axis && !strcmp(stagger_axis, "x");
+		map->stagger_even = stagger_index && !strcmp(stagger_index, "even");
+	}
+	else if (!strcmp(name, "tileset")) {
+		char *source = get_reader_attribute(reader, map->arena, "source");
+		if (source) {
+			// kept in its own file
+			ALLEGRO_MAP_TILESET *tileset = load_external_tileset(map, source,
+					get_reader_attribute_int(reader, "firstgid", 1));
+			if (tileset) {
+				map->tilesets = arena_slist_prepend(map->arena, map->tilesets, tileset);
+			}
+			return;
+		}
+
+		ALLEGRO_MAP_TILESET *tileset = ARENA_NEW(map->arena, ALLEGRO_MAP_TILESET);
+		tileset->firstgid = get_reader_attribute_int(reader, "firstgid", 1);
+		tileset->tilewidth = get_reader_attribute_int(reader, "tilewidth", 0);
+		tileset->tileheight = get_reader_attribute_int(reader, "tileheight", 0);
+		tileset->name = get_reader_attribute(reader, map->arena, "name");
+		map->tilesets = arena_slist_prepend(map->arena, map->tilesets, tileset);
+		state->tileset = tileset;
+	}
+	else if (!strcmp(name, "image")) {
+		// only the tileset's own image; per-tile images aren't supported
+		ALLEGRO_MAP_TILESET *tileset = state->tileset;
+		if (tileset && !state->tile && !tileset->source) {
+			tileset->width = get_reader_attribute_int(reader, "width", 0);
+			tileset->height = get_reader_attribute_int(reader, "height", 0);
+			tileset->source = get_reader_attribute(reader, map->arena, "source");
+			if (!state->defer_images) {
+				attach_tileset_image(tileset);
+			}
+		}
+	}
+	else if (!strcmp(name, "tile")) {
+		ALLEGRO_MAP_TILESET *tileset = state->tileset;
+		int id = get_reader_attribute_int(reader, "id", 0);
+		if (tileset && !tileset_has_tile(tileset, id)) {
+			// skipped along with its properties and frames
+			fprintf(stderr, "Error: tileset \"%s\" has no tile %d\n", tileset->name, id);
+		}
+		else if (tileset) {
+			ALLEGRO_MAP_TILE *tile = ARENA_NEW(map->arena, ALLEGRO_MAP_TILE);
+			tile->id = tileset->firstgid + id;
+			tile->tileset = tileset;
+			tileset->tiles = arena_slist_prepend(map->arena, tileset->tiles, tile);
+			state->tile = tile;
+		}
+	}
+	else if (!strcmp(name, "layer")) {
+		ALLEGRO_MAP_LAYER *layer = start_layer(state, TILE_LAYER);
+		layer->width = get_reader_attribute_int(reader, "width", 0);
+		layer->height = get_reader_attribute_int(reader, "height", 0);
+		if (!map->infinite) {
+			layer->data = (int *)al_calloc(layer->width * layer->height, sizeof(int));
+		}
+		state->layer = layer;
+	}
+	else if (!strcmp(name, "objectgroup")) {
+		state->layer = start_layer(state, OBJECT_LAYER);
+	}
+	else if (!strcmp(name, "object")) {
+		ALLEGRO_MAP_LAYER *layer = state->layer;
+		if (layer && layer->type == OBJECT_LAYER) {
+			ALLEGRO_MAP_OBJECT *object = ARENA_NEW(map->arena, ALLEGRO_MAP_OBJECT);
+			object->layer = layer;
+			object->name = get_reader_attribute(reader, map->arena, "name");
+			object->type = get_reader_attribute(reader, map->arena, "type");
+			object->x = get_reader_attribute_int(reader, "x", 0);
+			object->y = get_reader_attribute_int(reader, "y", 0);
+			object->width = get_reader_attribute_int(reader, "width", 0);
+			object->height = get_reader_attribute_int(reader, "height", 0);
+			object->gid = get_reader_attribute_int(reader, "gid", 0);
+			object->visible = get_reader_attribute_int(reader, "visible", 1);
+			layer->objects = arena_slist_prepend(map->arena, layer->objects, object);
+			layer->object_count++;
+			state->object = object;
+		}
+	}
+	else if (!strcmp(name, "data")) {
+		if (state->layer && state->layer->type == TILE_LAYER) {
+			state->in_data = true;
+			state->encoding = get_reader_attribute(reader, map->arena, "encoding");
+			state->compression = get_reader_attribute(reader, map->arena, "compression");
+			state->data_index = 0;
+			state->data_read = false;
+		}
+	}
+	else if (!strcmp(name, "properties")) {
+		// properties belong to the innermost tile, object or layer
+		if (state->object) {
+			state->properties = &state->object->properties;
+		} else if (state->tile) {
+			state->properties = &state->tile->properties;
+		} else if (state->layer) {
+			state->properties = &state->layer->properties;
+		}
+		if (state->properties && !state->property_items) {
+			state->property_items = g_array_new(FALSE, FALSE, sizeof(PROPERTY));
+		}
+	}
+	else if (!strcmp(name, "frame")) {
+		if (state->tile) {
+			if (!state->frame_items) {
+				state->frame_items = g_array_new(FALSE, FALSE, sizeof(ANIMATION_FRAME));
+			}
+			ANIMATION_FRAME frame;
+			frame.tile_id = get_reader_attribute_int(reader, "tileid", 0);
+			frame.duration = get_reader_attribute_int(reader, "duration", 0);
+			g_array_append_val(state->frame_items, frame);
+		}
+	}
+	else if (!strcmp(name, "property")) {
+		xmlChar *key = xmlTextReaderGetAttribute(reader, (const xmlChar *)"name");
+		if (state->properties && key) {
+			xmlChar *value = xmlTextReaderGetAttribute(reader, (const xmlChar *)"value");
+			if (!value) {
+				value = xmlTextReaderReadString(reader);
+			}
+
+			add_property(state->property_items, (const char *)key, arena_strdup(map->arena, value ? (const char *)value : ""));
+			xmlFree(value);
+		}
+		xmlFree(key);
+	}
+}
+
+/*
+ * Handles the end of an element (or an empty element right after its start).
+ */
+static void end_element(READER_STATE *state, const char *name)
+{
+	if (!strcmp(name, "chunk") && state->in_chunk) {
+		end_chunk(state);
+	}
+	else if (!strcmp(name, "data")) {
+		if (!state->in_data) {
+			return;
+		}
+
+		ALLEGRO_MAP_LAYER *layer = state->layer;
+		if (!state->encoding && !state->map->infinite && state->data_index != layer->width * layer->height) {
+			fprintf(stderr, "Error: layer \"%s\" has %d tiles, expected %d\n",
+					layer->name, state->data_index, layer->width * layer->height);
+			state->decode_failed = true;
+		}
+		else if (state->encoding && !state->map->infinite && !state->data_read) {
+			fprintf(stderr, "Error: layer \"%s\" is empty\n", layer->name);
+			state->decode_failed = true;
+		}
+
+		state->encoding = NULL;
+		state->compression = NULL;
+		state->in_data = false;
+	}
+	else if (state->in_data) {
+		return;
+	}
+	else if (!strcmp(name, "tileset")) {
+		state->tileset = NULL;
+	}
+	else if (!strcmp(name, "tile")) {
+		if (state->tile && state->frame_items) {
+			set_tile_frames(state->map->arena, state->tile, state->frame_items);
+			g_array_set_size(state->frame_items, 0);
+		}
+		state->tile = NULL;
+	}
+	else if (!strcmp(name, "layer") || !strcmp(name, "objectgroup")) {
+		ALLEGRO_MAP_LAYER *layer = state->layer;
+		if (layer && layer->type == TILE_LAYER && state->map->infinite) {
+			layer->chunks = create_chunk_table(state->map->arena, layer->name, state->chunks);
+			state->chunks = NULL;
+		}
+		state->layer = NULL;
+	}
+	else if (!strcmp(name, "object")) {
+		state->object = NULL;
+	}
+	else if (!strcmp(name, "properties")) {
+		if (state->properties) {
+			*state->properties = create_property_list(state->map->arena, state->property_items);
+		}
+		state->properties = NULL;
+	}
+}
+
+/*
+ * Handles the text content of a <data> node.
+ */
+static void read_data_text(READER_STATE *state)
+{
+	if (!state->in_data || !state->encoding) {
+		return;
+	}
+
+	// the reader owns this text and discards it once we move on,
+	// so it's safe to decode it in place
+	char *str = (char *)xmlTextReaderConstValue(state->reader);
+	if (str && state->in_chunk) {
+		state->data_read = true;
+		// chunks are small and packed right after, so decode them here
+		if (!decode_gids(state->layer->name, state->chunk_data, state->chunk_width * state->chunk_height,
+				state->encoding, state->compression, str)) {
+			state->decode_failed = true;
+		}
+	}
+	else if (str && state->layer->data) {
+		state->data_read = true;
+		queue_layer_data(state->queue, state->layer, state->encoding, state->compression, str);
+	}
+}
+
+/*
+ * Puts the map's lists in document order, since everything was prepended.
+ */
+static void reverse_lists(ALLEGRO_MAP *map)
+{
+	map->tilesets = g_slist_reverse(map->tilesets);
+	map->layers = g_slist_reverse(map->layers);
+	map->tile_layers = g_slist_reverse(map->tile_layers);
+	map->object_layers = g_slist_reverse(map->object_layers);
+
+	GSList *layer_item = map->object_layers;
+	while (layer_item) {
+		ALLEGRO_MAP_LAYER *layer = (ALLEGRO_MAP_LAYER*)layer_item->data;
+		layer_item = g_slist_next(layer_item);
+		layer->objects = g_slist_reverse(layer->objects);
+	}
+}
+
+/*
+ * Runs the reader to the end of the document.
+ * Returns 0 on success, like xmlTextReaderRead().
+ */
+static int read_document(READER_STATE *state)
+{
+	xmlTextReaderPtr reader = state->reader;
+
+	int ret;
+	while ((ret = xmlTextReaderRead(reader)) == 1) {
+		const char *name = (const char *)xmlTextReaderConstName(reader);
+
+		switch (xmlTextReaderNodeType(reader)) {
+			case XML_READER_TYPE_ELEMENT:
+				start_element(state, name);
+				if (xmlTextReaderIsEmptyElement(reader)) {
+					end_element(state, name);
+				}
+				break;
+			case XML_READER_TYPE_END_ELEMENT:
+				end_element(state, name);
+				break;
+			case XML_READER_TYPE_TEXT:
+			case XML_READER_TYPE_CDATA:
+				read_data_text(state);
+				break;
+		}
+	}
+
+	return ret;
+}
+
+/*
+ * Reads a map file in a single forward pass, decoding layer data on
+ * the given number of threads (see create_decode_queue).
+ * Returns NULL if the file couldn't be read, isn't well-formed, or holds
+ * layer data that can't be decoded.
+ */
+ALLEGRO_MAP *parse_map_stream(const char *filename, int threads)
+{
+	// layer data can easily exceed libxml2's default text node limit
+	xmlTextReaderPtr reader = xmlReaderForFile(filename, NULL, XML_PARSE_HUGE);
+	if (!reader) {
+		fprintf(stderr, "Error: failed to open map data: %s\n", filename);
+		return NULL;
+	}
+
+	READER_STATE state;
+	memset(&state, 0, sizeof(state));
+	state.reader = reader;
+	state.queue = create_decode_queue(threads);
+	state.map = create_map();
+
+	int ret = read_document(&state);
+
+	bool decoded = finish_decode_queue(state.queue) && !state.decode_failed;
+	xmlFreeTextReader(reader);
+	g_free(state.chunk_data);
+	if (state.property_items) {
+		g_array_free(state.property_items, TRUE);
+	}
+	if (state.frame_items) {
+		g_array_free(state.frame_items, TRUE);
+	}
+	reverse_lists(state.map);
+
+	if (ret != 0) {
+		fprintf(stderr, "Error: failed to parse map data: %s\n", filename);
+		al_free_map(state.map);
+		return NULL;
+	}
+
+	if (!decoded) {
+		fprintf(stderr, "Error: failed to decode map data: %s\n", filename);
+		al_free_map(state.map);
+		return NULL;
+	}
+
+	return state.map;
+}
+
+/*
+ * Reads a standalone .tsx tileset file without loading its image.
+ * Its tile ids are left relative to the tileset, with a firstgid of 0.
+ * The tileset lives in the arena returned through arena, which the
+ * caller owns a reference to.
+ * Returns NULL if the file couldn't be read or isn't well-formed.
+ */
+ALLEGRO_MAP_TILESET *parse_tileset_stream(const char *filename, ARENA **arena)
+{
+	xmlTextReaderPtr reader = xmlReaderForFile(filename, NULL, 0);
+	if (!reader) {
+		fprintf(stderr, "Error: failed to open tileset data: %s\n", filename);
+		return NULL;
+	}
+
+	// the tileset is read into a scratch map, as if it were embedded
+	READER_STATE state;
+	memset(&state, 0, sizeof(state));
+	state.reader = reader;
+	state.map = create_map();
+	state.defer_images = true;
+
+	int ret = read_document(&state);
+	xmlFreeTextReader(reader);
+	if (state.property_items) {
+		g_array_free(state.property_items, TRUE);
+	}
+	if (state.frame_items) {
+		g_array_free(state.frame_items, TRUE);
+	}
+
+	ALLEGRO_MAP_TILESET *tileset = NULL;
+	if (ret != 0 || !state.map->tilesets) {
+		fprintf(stderr, "Error: failed to parse tileset data: %s\n", filename);
+	} else {
+		tileset = (ALLEGRO_MAP_TILESET*)state.map->tilesets->data;
+		state.map->tilesets = g_slist_next(state.map->tilesets);
+		(*arena) = ref_arena(state.map->arena);
+
+		GSList *tiles = tileset->tiles;
+		while (tiles) {
+			ALLEGRO_MAP_TILE *tile = (ALLEGRO_MAP_TILE*)tiles->data;
+			tiles = g_slist_next(tiles);
+			tile->id -= tileset->firstgid;
+		}
+		tileset->firstgid = 0;
+	}
+
+	al_free_map(state.map);
+	return tileset;
+}
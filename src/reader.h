@@ -0,0 +1,36 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ */
+
+#ifndef _READER_H
+#define _READER_H
+
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_tiled.h>
+#include <libxml/xmlreader.h>
+#include <glib.h>
+#include "data.h"
+#include "decode.h"
+#include "cache.h"
+#include "tsx.h"
+#include "chunk.h"
+#include "property.h"
+#include "anim.h"
+
+ALLEGRO_MAP *parse_map_stream(const char *filename, int threads);
+ALLEGRO_MAP_TILESET *parse_tileset_stream(const char *filename, ARENA **arena);
+
+#endif
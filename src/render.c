@@ -0,0 +1,222 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ *
+ *
+ *                               ---
+ *
+ * Pre-rendered chunks of static tile layers.
+ *
+ * With ALLEGRO_MAP_RENDER_CACHE, each tile layer is cut into chunks of
+ * about RENDER_CHUNK_SIZE pixels square, and every chunk is drawn once
+ * into a bitmap of its own. Drawing a region then blits the handful
+ * of chunks it overlaps instead of every visible tile. Setting a tile
+ * only marks the chunks it reaches as dirty, and they're redrawn the
+ * next time they're on screen.
+ *
+ * Chunk bitmaps are created with the new bitmap flags in effect when
+ * they're first drawn, so ALLEGRO_MEMORY_BITMAP works headless. Layer
+ * opacity and the tint are applied when blitting, so they can change
+ * without redrawing anything. Chunked (infinite) layers stream their
+ * cells in and out, so they're always drawn directly.
+ */
+
+#include "render.h"
+#include "draw.h"
+
+/*
+ * Sets up the render cache of a layer, without creating any bitmaps.
+ */
+static RENDER_CACHE *create_render_cache(ALLEGRO_MAP *map, ALLEGRO_MAP_LAYER *layer)
+{
+	RENDER_CACHE *cache = (RENDER_CACHE *)al_calloc(1, sizeof(RENDER_CACHE));
+	cache->chunk_width = MAX(map->render_chunk_size / map->tile_width, 1);
+	cache->chunk_height = MAX(map->render_chunk_size / map->tile_height, 1);
+	cache->columns = (layer->width + cache->chunk_width - 1) / cache->chunk_width;
+	cache->rows = (layer->height + cache->chunk_height - 1) / cache->chunk_height;
+	cache->bitmaps = (ALLEGRO_BITMAP **)al_calloc(MAX(cache->columns * cache->rows, 1), sizeof(ALLEGRO_BITMAP *));
+	cache->dirty = (bool *)al_calloc(MAX(cache->columns * cache->rows, 1), sizeof(bool));
+
+	// tiles are drawn from their cell's top left corner, so ones larger
+	// than a cell spill into the cells right of and below it
+	int tile_width = map->tile_width, tile_height = map->tile_height;
+	GSList *tilesets = map->tilesets;
+	while (tilesets) {
+		ALLEGRO_MAP_TILESET *tileset = (ALLEGRO_MAP_TILESET*)tilesets->data;
+		tilesets = g_slist_next(tilesets);
+		tile_width = MAX(tile_width, tileset->tilewidth);
+		tile_height = MAX(tile_height, tileset->tileheight);
+	}
+	cache->overhang_x = (tile_width - 1) / map->tile_width;
+	cache->overhang_y = (tile_height - 1) / map->tile_height;
+
+	return cache;
+}
+
+/*
+ * Draws the cells of a chunk into its bitmap, creating it if needed.
+ * Returns false if the bitmap couldn't be created.
+ */
+static bool render_chunk(RENDER_CACHE *cache, ALLEGRO_MAP_LAYER *layer, ALLEGRO_MAP *map, int column, int row)
+{
+	ALLEGRO_BITMAP **bitmap = &cache->bitmaps[column + row * cache->columns];
+
+	int x1 = column * cache->chunk_width, x2 = MIN(x1 + cache->chunk_width, layer->width) - 1;
+	int y1 = row * cache->chunk_height, y2 = MIN(y1 + cache->chunk_height, layer->height) - 1;
+	if (!(*bitmap)) {
+		*bitmap = al_create_bitmap((x2 - x1 + 1) * map->tile_width, (y2 - y1 + 1) * map->tile_height);
+		if (!(*bitmap)) {
+			fprintf(stderr, "Error: failed to create render cache chunk for layer \"%s\"\n", layer->name);
+			return false;
+		}
+	}
+
+	ALLEGRO_STATE state;
+	al_store_state(&state, ALLEGRO_STATE_TARGET_BITMAP | ALLEGRO_STATE_BLENDER);
+	al_set_target_bitmap(*bitmap);
+	al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_INVERSE_ALPHA);
+	al_clear_to_color(al_map_rgba(0, 0, 0, 0));
+	al_hold_bitmap_drawing(true);
+
+	// start far enough up and to the left to catch tiles spilling in
+	ALLEGRO_COLOR white = al_map_rgba_f(1, 1, 1, 1);
+	LAYER_SPANS *spans = layer->spans;
+	int mx, my, left = MAX(x1 - cache->overhang_x, 0);
+	for (my = MAX(y1 - cache->overhang_y, 0); my <= y2; my++) {
+		int cell = my * layer->width;
+		int s, end = spans->rows[my + 1];
+		for (s = find_row_span(spans, my, left); s < end && spans->spans[s * 2] <= x2; s++) {
+			int last = MIN(spans->spans[s * 2 + 1], x2);
+			for (mx = MAX(spans->spans[s * 2], left); mx <= last; mx++) {
+				int gid = get_layer_gid(layer, cell + mx);
+				if (gid) {
+					draw_cell(map, gid, get_layer_flip_code(layer, cell + mx), white, (mx - x1) * map->tile_width, (my - y1) * map->tile_height);
+				}
+			}
+		}
+	}
+
+	al_hold_bitmap_drawing(false);
+	al_restore_state(&state);
+
+	cache->dirty[column + row * cache->columns] = false;
+	return true;
+}
+
+/*
+ * Draws the given region of a tile layer out of its render cache,
+ * bringing any missing or dirty chunks in the region up to date first.
+ * Returns false if the layer can't be cached, in which case nothing
+ * was drawn and it should be drawn directly.
+ */
+bool draw_cached_tile_layer(ALLEGRO_MAP_LAYER *layer, ALLEGRO_MAP *map, ALLEGRO_COLOR color, float sx, float sy, float sw, float sh, float dx, float dy)
+{
+	if (layer->chunks || map->tile_width <= 0 || map->tile_height <= 0) {
+		return false;
+	}
+
+	if (!layer->render_cache) {
+		layer->render_cache = create_render_cache(map, layer);
+	}
+
+	RENDER_CACHE *cache = layer->render_cache;
+	int chunk_pixel_width = cache->chunk_width * map->tile_width;
+	int chunk_pixel_height = cache->chunk_height * map->tile_height;
+
+	int c1 = MAX((int)floorf(sx / chunk_pixel_width), 0);
+	int r1 = MAX((int)floorf(sy / chunk_pixel_height), 0);
+	int c2 = MIN((int)floorf((sx + sw) / chunk_pixel_width), cache->columns - 1);
+	int r2 = MIN((int)floorf((sy + sh) / chunk_pixel_height), cache->rows - 1);
+
+	// bitmaps can't be drawn into while drawing is held, so catch up first
+	int column, row;
+	for (row = r1; row <= r2; row++) {
+		for (column = c1; column <= c2; column++) {
+			int i = column + row * cache->columns;
+			if ((!cache->bitmaps[i] || cache->dirty[i]) && !render_chunk(cache, layer, map, column, row)) {
+				return false;
+			}
+		}
+	}
+
+	al_hold_bitmap_drawing(true);
+	for (row = r1; row <= r2; row++) {
+		for (column = c1; column <= c2; column++) {
+			al_draw_tinted_bitmap(cache->bitmaps[column + row * cache->columns], color,
+					column * chunk_pixel_width - sx + dx, row * chunk_pixel_height - sy + dy, 0);
+		}
+	}
+	al_hold_bitmap_drawing(false);
+
+	return true;
+}
+
+/*
+ * Marks the chunks a cell's tile can reach as needing a redraw.
+ */
+void invalidate_render_cache(ALLEGRO_MAP_LAYER *layer, int x, int y)
+{
+	RENDER_CACHE *cache = layer->render_cache;
+	if (!cache) {
+		return;
+	}
+
+	int c1 = x / cache->chunk_width, c2 = MIN((x + cache->overhang_x) / cache->chunk_width, cache->columns - 1);
+	int r1 = y / cache->chunk_height, r2 = MIN((y + cache->overhang_y) / cache->chunk_height, cache->rows - 1);
+
+	int column, row;
+	for (row = r1; row <= r2; row++) {
+		for (column = c1; column <= c2; column++) {
+			cache->dirty[column + row * cache->columns] = true;
+		}
+	}
+}
+
+/*
+ * Destroys a layer's render cache and its chunk bitmaps.
+ */
+void free_render_cache(ALLEGRO_MAP_LAYER *layer)
+{
+	RENDER_CACHE *cache = layer->render_cache;
+	if (!cache) {
+		return;
+	}
+
+	int i;
+	for (i = 0; i<cache->columns * cache->rows; i++) {
+		if (cache->bitmaps[i]) {
+			al_destroy_bitmap(cache->bitmaps[i]);
+		}
+	}
+
+	al_free(cache->bitmaps);
+	al_free(cache->dirty);
+	al_free(cache);
+	layer->render_cache = NULL;
+}
+
+/*
+ * Destroys every pre-rendered chunk of the map, e.g. before the display
+ * its bitmaps belong to goes away. They're drawn again as needed.
+ */
+void al_clear_map_render_cache(ALLEGRO_MAP *map)
+{
+	GSList *layers = map->tile_layers;
+	while (layers) {
+		ALLEGRO_MAP_LAYER *layer = (ALLEGRO_MAP_LAYER*)layers->data;
+		layers = g_slist_next(layers);
+		free_render_cache(layer);
+	}
+}
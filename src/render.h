@@ -0,0 +1,44 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ */
+
+#ifndef _RENDER_H
+#define _RENDER_H
+
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_tiled.h>
+#include <glib.h>
+#include "data.h"
+
+// Default size of a render cache chunk, in pixels
+#define RENDER_CHUNK_SIZE 512
+
+struct _RENDER_CACHE
+{
+	int chunk_width;            // width of each chunk, in tiles
+	int chunk_height;           // height of each chunk, in tiles
+	int columns, rows;          // size of the cache, in chunks
+	int overhang_x;             // cells to the left whose tiles can reach into a cell
+	int overhang_y;             // cells above whose tiles can reach into a cell
+	ALLEGRO_BITMAP **bitmaps;   // chunk bitmaps, row by row, NULL until first drawn
+	bool *dirty;                // chunks whose cells changed since they were drawn
+};
+
+bool draw_cached_tile_layer(ALLEGRO_MAP_LAYER *layer, ALLEGRO_MAP *map, ALLEGRO_COLOR color, float sx, float sy, float sw, float sh, float dx, float dy);
+void invalidate_render_cache(ALLEGRO_MAP_LAYER *layer, int x, int y);
+void free_render_cache(ALLEGRO_MAP_LAYER *layer);
+
+#endif
@@ -0,0 +1,416 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ *
+ *
+ *                               ---
+ *
+ * Scrolling surfaces.
+ *
+ * A camera that moves a few pixels a frame sees almost the same tiles
+ * as the frame before. A scroll surface keeps the map's tile layers
+ * drawn into a bitmap a little bigger than the view, treated as a ring:
+ * map pixel x,y is held at x,y modulo its size. When the view moves,
+ * the ring moves after it by whole tiles, and only the strips of map
+ * it takes in are drawn, into the columns and rows that fell out of it.
+ * The view is then copied out with at most four blits, one for each
+ * side of the wrap.
+ *
+ * Setting a tile, or an animated tile changing frame, only marks the
+ * pixels the cell's tile can reach, and they're redrawn on the next
+ * draw. Jumps further than the ring's size redraw it all. Chunks of
+ * infinite maps aren't tracked, so keep the chunks streamed in (see
+ * al_stream_map_chunks) covering the view and its margin.
+ */
+
+#include "scroll.h"
+#include "draw.h"
+#include "anim.h"
+
+/*
+ * Rounds a down to a multiple of step.
+ */
+static inline int floor_step(int a, int step)
+{
+	return (a >= 0 ? a / step : -((step - 1 - a) / step)) * step;
+}
+
+/*
+ * Gets where map pixel a is held along an axis of the ring.
+ */
+static inline int wrap_ring(int a, int size)
+{
+	int r = a % size;
+	return r < 0 ? r + size : r;
+}
+
+/*
+ * Creates a surface for drawing width by height pixel regions of the
+ * map's tile layers, with a ring that reaches margin pixels (at least a
+ * tile) further. Object layers aren't drawn into it. Free it with
+ * al_destroy_map_scroll_surface, or leave it to be freed along with the
+ * map.
+ */
+ALLEGRO_MAP_SCROLL_SURFACE *al_create_map_scroll_surface(ALLEGRO_MAP *map, int width, int height, int margin)
+{
+	if (width <= 0 || height <= 0 || map->tile_width <= 0 || map->tile_height <= 0) {
+		fprintf(stderr, "Error: can't create a %dx%d scroll surface\n", width, height);
+		return NULL;
+	}
+
+	ALLEGRO_MAP_SCROLL_SURFACE *surface = MALLOC(ALLEGRO_MAP_SCROLL_SURFACE);
+	surface->map = map;
+	surface->view_width = width;
+	surface->view_height = height;
+	surface->step_x = map->tile_width;
+	surface->step_y = map->tile_height;
+	get_tile_extent(map, &surface->extent_width, &surface->extent_height);
+
+	// a column and row more for views that start between pixels
+	surface->width = width + 1 + MAX(margin, surface->step_x);
+	surface->height = height + 1 + MAX(margin, surface->step_y);
+
+	// frame changes are only seen through the cells showing each tile
+	track_animated_cells(map);
+
+	map->scroll_surfaces = g_slist_prepend(map->scroll_surfaces, surface);
+	return surface;
+}
+
+/*
+ * Moves the ring along one axis by as few steps as it takes to hold
+ * start..start+length, going as far as it can in the direction it
+ * moved. Returns the new position of its contents.
+ */
+static int scroll_ring(int origin, int size, int start, int length, int step)
+{
+	if (start < origin) {
+		return -floor_step(size - start - length, step);
+	}
+	if (start + length > origin + size) {
+		return floor_step(start, step);
+	}
+	return origin;
+}
+
+/*
+ * Clears a piece of the ring that doesn't wrap, at rx,ry, and draws the
+ * tile layers into it from map pixel x,y.
+ */
+static void redraw_ring_piece(ALLEGRO_MAP_SCROLL_SURFACE *surface, int x, int y, int width, int height, int rx, int ry)
+{
+	ALLEGRO_MAP *map = surface->map;
+	al_set_clipping_rectangle(rx, ry, width, height);
+	al_clear_to_color(al_map_rgba(0, 0, 0, 0));
+
+	// orthogonal tiles are drawn from their cell's top left corner, so
+	// start far enough up and to the left to catch big ones spilling in
+	int overhang_x = 0, overhang_y = 0;
+	if (map->orientation_kind == ORIENTATION_ORTHOGONAL) {
+		overhang_x = surface->extent_width - map->tile_width;
+		overhang_y = surface->extent_height - map->tile_height;
+	}
+
+	draw_map_tile_layers(map, al_map_rgba_f(1, 1, 1, 1), x - overhang_x, y - overhang_y,
+			width + overhang_x, height + overhang_y, rx - overhang_x, ry - overhang_y);
+}
+
+/*
+ * Redraws a region of the map held by the ring, in up to four pieces
+ * split where the ring wraps. The ring must be the target bitmap.
+ */
+static void redraw_ring(ALLEGRO_MAP_SCROLL_SURFACE *surface, int x, int y, int width, int height)
+{
+	int x1 = MAX(x, surface->x), x2 = MIN(x + width, surface->x + surface->width);
+	int y1 = MAX(y, surface->y), y2 = MIN(y + height, surface->y + surface->height);
+	if (x1 >= x2 || y1 >= y2) {
+		return;
+	}
+
+	int rx = wrap_ring(x1, surface->width), ry = wrap_ring(y1, surface->height);
+	int w1 = MIN(x2 - x1, surface->width - rx), h1 = MIN(y2 - y1, surface->height - ry);
+	redraw_ring_piece(surface, x1, y1, w1, h1, rx, ry);
+	if (x1 + w1 < x2) {
+		redraw_ring_piece(surface, x1 + w1, y1, x2 - x1 - w1, h1, 0, ry);
+	}
+	if (y1 + h1 < y2) {
+		redraw_ring_piece(surface, x1, y1 + h1, w1, y2 - y1 - h1, rx, 0);
+		if (x1 + w1 < x2) {
+			redraw_ring_piece(surface, x1 + w1, y1 + h1, x2 - x1 - w1, y2 - y1 - h1, 0, 0);
+		}
+	}
+}
+
+/*
+ * Brings the ring up to date for a view of width by height pixels from
+ * map pixel x,y, moving it along if the view's left it.
+ */
+static void scroll_surface(ALLEGRO_MAP_SCROLL_SURFACE *surface, int x, int y, int width, int height)
+{
+	ALLEGRO_MAP *map = surface->map;
+	int nx = scroll_ring(surface->x, surface->width, x, width, surface->step_x);
+	int ny = scroll_ring(surface->y, surface->height, y, height, surface->step_y);
+	bool dirty = surface->dirty_x1 < surface->dirty_x2;
+	if (surface->valid && nx == surface->x && ny == surface->y && !dirty) {
+		return;
+	}
+
+	ALLEGRO_STATE state;
+	al_store_state(&state, ALLEGRO_STATE_TARGET_BITMAP | ALLEGRO_STATE_BLENDER);
+	al_set_target_bitmap(surface->bitmap);
+	al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_INVERSE_ALPHA);
+
+	// strips are drawn directly; a vertex window for each would be rebuilt
+	// every time
+	bool vertex_arrays = map->vertex_arrays;
+	map->vertex_arrays = false;
+
+	if (!surface->valid || abs(nx - surface->x) >= surface->width || abs(ny - surface->y) >= surface->height) {
+		// nothing left to keep
+		surface->x = nx;
+		surface->y = ny;
+		surface->valid = true;
+		redraw_ring(surface, nx, ny, surface->width, surface->height);
+	} else {
+		// the columns taken in, and then the rows at the new columns
+		int old = surface->x;
+		surface->x = nx;
+		if (nx > old) {
+			redraw_ring(surface, old + surface->width, surface->y, nx - old, surface->height);
+		} else if (nx < old) {
+			redraw_ring(surface, nx, surface->y, old - nx, surface->height);
+		}
+
+		old = surface->y;
+		surface->y = ny;
+		if (ny > old) {
+			redraw_ring(surface, surface->x, old + surface->height, surface->width, ny - old);
+		} else if (ny < old) {
+			redraw_ring(surface, surface->x, ny, surface->width, old - ny);
+		}
+
+		if (dirty) {
+			redraw_ring(surface, surface->dirty_x1, surface->dirty_y1,
+					surface->dirty_x2 - surface->dirty_x1, surface->dirty_y2 - surface->dirty_y1);
+		}
+	}
+
+	surface->dirty_x1 = surface->dirty_x2 = 0;
+	map->vertex_arrays = vertex_arrays;
+	al_reset_clipping_rectangle();
+	al_restore_state(&state);
+}
+
+/*
+ * Draws, tinted, the region of the tile layers at sx,sy the size of the
+ * surface's view, as al_draw_tinted_map_region would. The tint applies
+ * to the finished surface, after the layers are drawn over each other.
+ */
+void al_draw_tinted_map_scroll_surface(ALLEGRO_MAP_SCROLL_SURFACE *surface, ALLEGRO_COLOR tint, float sx, float sy, float dx, float dy)
+{
+	if (!surface->bitmap) {
+		// created with the new bitmap flags in effect, as render chunks are
+		surface->bitmap = al_create_bitmap(surface->width, surface->height);
+		if (!surface->bitmap) {
+			fprintf(stderr, "Error: failed to create %dx%d scroll surface bitmap\n", surface->width, surface->height);
+			return;
+		}
+		surface->valid = false;
+	}
+
+	// the ring holds whole pixels; a view between them takes one more
+	int x = floorf(sx), y = floorf(sy);
+	int width = (int)ceilf(sx + surface->view_width) - x;
+	int height = (int)ceilf(sy + surface->view_height) - y;
+	scroll_surface(surface, x, y, width, height);
+
+	float ox = dx - (sx - x), oy = dy - (sy - y);
+	int rx = wrap_ring(x, surface->width), ry = wrap_ring(y, surface->height);
+	int w1 = MIN(width, surface->width - rx), h1 = MIN(height, surface->height - ry);
+
+	al_hold_bitmap_drawing(true);
+	al_draw_tinted_bitmap_region(surface->bitmap, tint, rx, ry, w1, h1, ox, oy, 0);
+	if (w1 < width) {
+		al_draw_tinted_bitmap_region(surface->bitmap, tint, 0, ry, width - w1, h1, ox + w1, oy, 0);
+	}
+	if (h1 < height) {
+		al_draw_tinted_bitmap_region(surface->bitmap, tint, rx, 0, w1, height - h1, ox, oy + h1, 0);
+		if (w1 < width) {
+			al_draw_tinted_bitmap_region(surface->bitmap, tint, 0, 0, width - w1, height - h1, ox + w1, oy + h1, 0);
+		}
+	}
+	al_hold_bitmap_drawing(false);
+}
+
+/*
+ * Draws the region of the tile layers at sx,sy the size of the
+ * surface's view.
+ */
+void al_draw_map_scroll_surface(ALLEGRO_MAP_SCROLL_SURFACE *surface, float sx, float sy, float dx, float dy)
+{
+	al_draw_tinted_map_scroll_surface(surface, al_map_rgba_f(1, 1, 1, 1), sx, sy, dx, dy);
+}
+
+/*
+ * Gets the map pixels the tile of the cell at x,y can be drawn over,
+ * from x1,y1 up to but not including x2,y2.
+ */
+static void get_cell_reach(ALLEGRO_MAP_SCROLL_SURFACE *surface, int x, int y, int *x1, int *y1, int *x2, int *y2)
+{
+	ALLEGRO_MAP *map = surface->map;
+	STAGGER_GRID grid;
+	float left, bottom;
+
+	switch (map->orientation_kind) {
+		case ORIENTATION_ISOMETRIC:
+			left = (x - y - 1) * map->tile_width / 2.0f + map->height * map->tile_width / 2.0f;
+			bottom = (x + y) * map->tile_height / 2.0f + map->tile_height;
+			break;
+		case ORIENTATION_STAGGERED:
+		case ORIENTATION_HEXAGONAL:
+			get_stagger_grid(map, &grid);
+			get_staggered_cell_pos(&grid, x, y, &left, &bottom);
+			bottom += grid.tile_height;
+			break;
+		default:
+			// drawn down from the top left corner instead
+			left = x * map->tile_width;
+			bottom = y * map->tile_height + surface->extent_height;
+			break;
+	}
+
+	(*x1) = floorf(left);
+	(*y1) = floorf(bottom - surface->extent_height);
+	(*x2) = ceilf(left + surface->extent_width);
+	(*y2) = ceilf(bottom);
+}
+
+/*
+ * Marks the map pixels from x1,y1 up to but not including x2,y2 as
+ * needing a redraw on every scroll surface of the map holding them.
+ */
+static void invalidate_scroll_rect(ALLEGRO_MAP *map, int x1, int y1, int x2, int y2)
+{
+	GSList *surfaces = map->scroll_surfaces;
+	while (surfaces) {
+		ALLEGRO_MAP_SCROLL_SURFACE *surface = (ALLEGRO_MAP_SCROLL_SURFACE*)surfaces->data;
+		surfaces = g_slist_next(surfaces);
+		if (!surface->valid || x2 <= surface->x || x1 >= surface->x + surface->width
+				|| y2 <= surface->y || y1 >= surface->y + surface->height) {
+			continue;
+		}
+
+		if (surface->dirty_x1 < surface->dirty_x2) {
+			surface->dirty_x1 = MIN(surface->dirty_x1, x1);
+			surface->dirty_y1 = MIN(surface->dirty_y1, y1);
+			surface->dirty_x2 = MAX(surface->dirty_x2, x2);
+			surface->dirty_y2 = MAX(surface->dirty_y2, y2);
+		} else {
+			surface->dirty_x1 = x1;
+			surface->dirty_y1 = y1;
+			surface->dirty_x2 = x2;
+			surface->dirty_y2 = y2;
+		}
+	}
+}
+
+/*
+ * Marks the pixels the tile of the cell at x,y can reach as needing a
+ * redraw on every scroll surface of the map holding them.
+ */
+void invalidate_scroll_surfaces(ALLEGRO_MAP *map, int x, int y)
+{
+	if (!map->scroll_surfaces) {
+		return;
+	}
+
+	int x1, y1, x2, y2;
+	get_cell_reach((ALLEGRO_MAP_SCROLL_SURFACE*)map->scroll_surfaces->data, x, y, &x1, &y1, &x2, &y2);
+	invalidate_scroll_rect(map, x1, y1, x2, y2);
+}
+
+/*
+ * Marks the pixels the tiles of the cells x1..x2 by y1..y2 can reach as
+ * needing a redraw on every scroll surface of the map holding them. The
+ * outermost cells in every direction are on the range's edges, or one
+ * in from them where staggering shifts every other line by half a cell,
+ * so only those are measured.
+ */
+void invalidate_scroll_surface_cells(ALLEGRO_MAP *map, int x1, int y1, int x2, int y2)
+{
+	if (!map->scroll_surfaces || x2 < x1 || y2 < y1) {
+		return;
+	}
+
+	ALLEGRO_MAP_SCROLL_SURFACE *surface = (ALLEGRO_MAP_SCROLL_SURFACE*)map->scroll_surfaces->data;
+	int xs[4] = {x1, MIN(x1 + 1, x2), MAX(x2 - 1, x1), x2};
+	int ys[4] = {y1, MIN(y1 + 1, y2), MAX(y2 - 1, y1), y2};
+	int left = INT_MAX, top = INT_MAX, right = INT_MIN, bottom = INT_MIN;
+
+	int i, j;
+	for (j = 0; j < 4; j++) {
+		for (i = 0; i < 4; i++) {
+			int cx1, cy1, cx2, cy2;
+			get_cell_reach(surface, xs[i], ys[j], &cx1, &cy1, &cx2, &cy2);
+			left = MIN(left, cx1);
+			top = MIN(top, cy1);
+			right = MAX(right, cx2);
+			bottom = MAX(bottom, cy2);
+		}
+	}
+
+	invalidate_scroll_rect(map, left, top, right, bottom);
+}
+
+/*
+ * Has every scroll surface of the map redrawn in full when it's next
+ * drawn.
+ */
+void dirty_scroll_surfaces(ALLEGRO_MAP *map)
+{
+	GSList *surfaces = map->scroll_surfaces;
+	while (surfaces) {
+		ALLEGRO_MAP_SCROLL_SURFACE *surface = (ALLEGRO_MAP_SCROLL_SURFACE*)surfaces->data;
+		surfaces = g_slist_next(surfaces);
+		surface->valid = false;
+	}
+}
+
+/*
+ * Destroys a scroll surface and its bitmap.
+ */
+void al_destroy_map_scroll_surface(ALLEGRO_MAP_SCROLL_SURFACE *surface)
+{
+	if (!surface) {
+		return;
+	}
+
+	ALLEGRO_MAP *map = surface->map;
+	map->scroll_surfaces = g_slist_remove(map->scroll_surfaces, surface);
+	if (surface->bitmap) {
+		al_destroy_bitmap(surface->bitmap);
+	}
+	al_free(surface);
+}
+
+/*
+ * Destroys every scroll surface of the map.
+ */
+void free_scroll_surfaces(ALLEGRO_MAP *map)
+{
+	while (map->scroll_surfaces) {
+		al_destroy_map_scroll_surface((ALLEGRO_MAP_SCROLL_SURFACE*)map->scroll_surfaces->data);
+	}
+}
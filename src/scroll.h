@@ -0,0 +1,51 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ */
+
+#ifndef _SCROLL_H
+#define _SCROLL_H
+
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_tiled.h>
+#include <glib.h>
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include "data.h"
+#include "stagger.h"
+
+struct _ALLEGRO_MAP_SCROLL_SURFACE
+{
+	ALLEGRO_MAP *map;           // map whose tile layers are drawn
+	ALLEGRO_BITMAP *bitmap;     // the ring buffer, NULL until first drawn
+	int width, height;          // size of the ring buffer, the view plus a margin
+	int view_width;             // width of the region drawn from it
+	int view_height;            // height of the region drawn from it
+	int step_x, step_y;         // the ring moves by whole tiles
+	int extent_width;           // width of the largest tile image
+	int extent_height;          // height of the largest tile image
+	int x, y;                   // map pixel held at the top left of the ring's contents
+	bool valid;                 // the contents at x,y are drawn, else they're redrawn in full
+	int dirty_x1, dirty_y1;     // map pixels to redraw before the next draw, from x1,y1
+	int dirty_x2, dirty_y2;     // up to but not including x2,y2; none if x2 <= x1
+};
+
+void invalidate_scroll_surfaces(ALLEGRO_MAP *map, int x, int y);
+void invalidate_scroll_surface_cells(ALLEGRO_MAP *map, int x1, int y1, int x2, int y2);
+void dirty_scroll_surfaces(ALLEGRO_MAP *map);
+void free_scroll_surfaces(ALLEGRO_MAP *map);
+
+#endif
@@ -0,0 +1,151 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ *
+ *
+ *                               ---
+ *
+ * Run index of the occupied cells of tile layers.
+ *
+ * Decoration and collision layers are mostly empty, so walking every
+ * cell of the view to find their few tiles wastes most of the time it
+ * takes to draw them. Each layer keeps the runs of each row that hold
+ * tiles, found once when it's loaded, and the draw loops visit only
+ * those; a layer without a single run is skipped outright.
+ *
+ * Short gaps are bridged rather than starting a new run, so walkers
+ * still test cells for gid 0, but the index never takes more than a
+ * byte per cell however the tiles are scattered. Rows
+ * are indexed again one at a time as al_set_single_tile_id sets them.
+ */
+
+#include "span.h"
+
+/*
+ * Most spans a row of the given width can have.
+ */
+static inline int max_row_spans(int width)
+{
+	return (width + SPAN_GAP) / (SPAN_GAP + 1);
+}
+
+/*
+ * Makes room for at least the given number of spans.
+ */
+static void reserve_spans(LAYER_SPANS *spans, int count)
+{
+	if (count <= spans->capacity) {
+		return;
+	}
+
+	spans->capacity = MAX(count, spans->capacity * 2);
+	spans->spans = (int *)al_realloc(spans->spans, spans->capacity * 2 * sizeof(int));
+}
+
+/*
+ * Finds the spans of row y, writing their first and last columns to out.
+ * Returns the number of spans found.
+ */
+static int scan_row(ALLEGRO_MAP_LAYER *layer, int y, int *out)
+{
+	int x, count = 0, row = y * layer->width;
+	for (x = 0; x<layer->width; x++) {
+		if (!get_layer_gid(layer, row + x)) {
+			continue;
+		}
+
+		if (count && x - out[count * 2 - 1] <= SPAN_GAP) {
+			// close enough to carry on the last span
+			out[count * 2 - 1] = x;
+		} else {
+			out[count * 2] = out[count * 2 + 1] = x;
+			count++;
+		}
+	}
+
+	return count;
+}
+
+/*
+ * Indexes the occupied runs of every row of a tile layer.
+ */
+void index_layer_spans(ALLEGRO_MAP_LAYER *layer)
+{
+	free_layer_spans(layer);
+
+	LAYER_SPANS *spans = (LAYER_SPANS *)al_calloc(1, sizeof(LAYER_SPANS));
+	spans->rows = (int *)al_malloc((layer->height + 1) * sizeof(int));
+
+	int y;
+	for (y = 0; y<layer->height; y++) {
+		spans->rows[y] = spans->count;
+		reserve_spans(spans, spans->count + max_row_spans(layer->width));
+		spans->count += scan_row(layer, y, spans->spans + spans->count * 2);
+	}
+	spans->rows[layer->height] = spans->count;
+
+	// give back what the worst case reserved
+	spans->capacity = MAX(spans->count, 1);
+	spans->spans = (int *)al_realloc(spans->spans, spans->capacity * 2 * sizeof(int));
+
+	layer->spans = spans;
+}
+
+/*
+ * Indexes row y of a layer again after its cells were set.
+ */
+void update_layer_spans(ALLEGRO_MAP_LAYER *layer, int y)
+{
+	LAYER_SPANS *spans = layer->spans;
+	if (!spans) {
+		return;
+	}
+
+	int *found = (int *)al_malloc(max_row_spans(layer->width) * 2 * sizeof(int));
+	int count = scan_row(layer, y, found);
+
+	// shift the rows below over to fit the row's new spans
+	int first = spans->rows[y], next = spans->rows[y + 1];
+	int change = count - (next - first);
+	if (change) {
+		reserve_spans(spans, spans->count + change);
+		memmove(spans->spans + (next + change) * 2, spans->spans + next * 2, (spans->count - next) * 2 * sizeof(int));
+		spans->count += change;
+
+		int row;
+		for (row = y + 1; row <= layer->height; row++) {
+			spans->rows[row] += change;
+		}
+	}
+
+	memcpy(spans->spans + first * 2, found, count * 2 * sizeof(int));
+	al_free(found);
+}
+
+/*
+ * Frees a layer's span index.
+ */
+void free_layer_spans(ALLEGRO_MAP_LAYER *layer)
+{
+	LAYER_SPANS *spans = layer->spans;
+	if (!spans) {
+		return;
+	}
+
+	al_free(spans->rows);
+	al_free(spans->spans);
+	al_free(spans);
+	layer->spans = NULL;
+}
@@ -0,0 +1,68 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ */
+
+#ifndef _SPAN_H
+#define _SPAN_H
+
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_tiled.h>
+#include <glib.h>
+#include "data.h"
+#include "plane.h"
+
+// Runs of fewer empty cells than this are bridged rather than splitting a span
+#define SPAN_GAP 8
+
+struct _LAYER_SPANS
+{
+	int *rows;                  // index of the first span of each row, plus one past the last row
+	int *spans;                 // first and last column of each span, two ints apiece, row by row
+	int count;                  // number of spans
+	int capacity;               // number of spans there's room for
+};
+
+void index_layer_spans(ALLEGRO_MAP_LAYER *layer);
+void update_layer_spans(ALLEGRO_MAP_LAYER *layer, int y);
+void free_layer_spans(ALLEGRO_MAP_LAYER *layer);
+
+/*
+ * Returns true if the layer is known to have no tiles at all.
+ */
+static inline bool layer_is_empty(ALLEGRO_MAP_LAYER *layer)
+{
+	return layer->spans && !layer->spans->count;
+}
+
+/*
+ * Finds the first span of row y that ends at or after column x.
+ * Returns the index one past the row's last span if there's none.
+ */
+static inline int find_row_span(LAYER_SPANS *spans, int y, int x)
+{
+	int lo = spans->rows[y], hi = spans->rows[y + 1];
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (spans->spans[mid * 2 + 1] < x) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+#endif
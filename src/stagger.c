@@ -0,0 +1,113 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ *
+ *                               ---
+ *
+ * Geometry of staggered and hexagonal maps.
+ *
+ * Both lay their cells out in rows (or columns) where every other one
+ * is shifted by half a cell, so a cell's box overlaps its neighbours'.
+ * Picking the cell under a pixel finds the line of cells whose boxes
+ * start before it, and only where it falls on the line's slanted edges
+ * does it check which side of the edge it's on, so it takes the same
+ * handful of operations anywhere on the map.
+ */
+
+#include "stagger.h"
+
+/*
+ * Gets the size of a staggered or hexagonal map in pixels, as drawn.
+ */
+void get_staggered_map_size(ALLEGRO_MAP *map, int *width, int *height)
+{
+	STAGGER_GRID grid;
+	get_stagger_grid(map, &grid);
+
+	if (grid.stagger_x) {
+		(*width) = map->width * grid.column_width + grid.side_offset_x;
+		(*height) = map->height * (grid.tile_height + grid.side_length_y);
+		if (map->width > 1) {
+			(*height) += grid.row_height;
+		}
+	} else {
+		(*width) = map->width * (grid.tile_width + grid.side_length_x);
+		(*height) = map->height * grid.row_height + grid.side_offset_y;
+		if (map->height > 1) {
+			(*width) += grid.column_width;
+		}
+	}
+}
+
+/*
+ * Gets how far across the stagger axis a line of cells is shifted.
+ */
+static inline float get_line_shift(const STAGGER_GRID *grid, int line, int step)
+{
+	return is_staggered_cell(grid, line, line) ? step / 2.0f : 0;
+}
+
+/*
+ * Finds the cell of a staggered or hexagonal map under a pixel, whether
+ * or not it lies on the map.
+ */
+void find_staggered_cell(ALLEGRO_MAP *map, float px, float py, int *x, int *y)
+{
+	STAGGER_GRID grid;
+	get_stagger_grid(map, &grid);
+	if (grid.tile_width <= 0 || grid.tile_height <= 0) {
+		(*x) = 0;
+		(*y) = 0;
+		return;
+	}
+
+	// work along the stagger axis, where the lines of cells are spaced
+	// closer than the cells are wide, and across it, where each line
+	// repeats every step pixels and the shifted lines are half a step on
+	float along, across;
+	int spacing, side_offset, step;
+	if (grid.stagger_x) {
+		along = px;
+		across = py;
+		spacing = grid.column_width;
+		side_offset = grid.side_offset_x;
+		step = grid.tile_height + grid.side_length_y;
+	} else {
+		along = py;
+		across = px;
+		spacing = grid.row_height;
+		side_offset = grid.side_offset_y;
+		step = grid.tile_width + grid.side_length_x;
+	}
+
+	// the last line whose boxes start before the pixel
+	int line = (int)floorf(along / spacing);
+	float offset = along - line * spacing;
+	float shift = get_line_shift(&grid, line, step);
+	int cell = (int)floorf((across - shift) / step);
+
+	// the first side_offset pixels of a line are its cells' slanted edges,
+	// and towards the ends of a cell the line before's cells reach past them
+	if (offset < side_offset) {
+		float middle = fabsf(across - shift - cell * step - step / 2.0f);
+		if (offset * step < side_offset * middle * 2) {
+			line--;
+			cell = (int)floorf((across - get_line_shift(&grid, line, step)) / step);
+		}
+	}
+
+	(*x) = grid.stagger_x ? line : cell;
+	(*y) = grid.stagger_x ? cell : line;
+}
@@ -0,0 +1,91 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ */
+
+#ifndef _STAGGER_H
+#define _STAGGER_H
+
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_tiled.h>
+#include <glib.h>
+#include <math.h>
+#include "data.h"
+
+/*
+ * Layout of the cells of a staggered or hexagonal map. Every cell's
+ * tile sits in a box of tile_width by tile_height, and every other row
+ * (or column, when staggered along x) is shifted by half a cell.
+ */
+typedef struct {
+	int tile_width;             // width of a cell's box, rounded down to even
+	int tile_height;            // height of a cell's box, rounded down to even
+	int side_length_x;          // length of the flat top and bottom of a hexagon, if staggered along x
+	int side_length_y;          // length of the flat sides of a hexagon, if staggered along y
+	int side_offset_x;          // distance from the left of a cell's box to its top side
+	int side_offset_y;          // distance from the top of a cell's box to its left side
+	int column_width;           // distance between columns when staggered along x, else the shift
+	int row_height;             // distance between rows when staggered along y, else the shift
+	bool stagger_x;             // columns are staggered rather than rows
+	bool stagger_even;          // the even rows or columns are shifted rather than the odd ones
+} STAGGER_GRID;
+
+void get_staggered_map_size(ALLEGRO_MAP *map, int *width, int *height);
+void find_staggered_cell(ALLEGRO_MAP *map, float px, float py, int *x, int *y);
+
+/*
+ * Works out the layout of a staggered or hexagonal map's cells.
+ */
+static inline void get_stagger_grid(ALLEGRO_MAP *map, STAGGER_GRID *grid)
+{
+	int side_length = map->orientation_kind == ORIENTATION_HEXAGONAL ? map->hex_side_length : 0;
+
+	grid->tile_width = map->tile_width & ~1;
+	grid->tile_height = map->tile_height & ~1;
+	grid->stagger_x = map->stagger_x;
+	grid->stagger_even = map->stagger_even;
+	grid->side_length_x = grid->stagger_x ? side_length : 0;
+	grid->side_length_y = grid->stagger_x ? 0 : side_length;
+	grid->side_offset_x = (grid->tile_width - grid->side_length_x) / 2;
+	grid->side_offset_y = (grid->tile_height - grid->side_length_y) / 2;
+	grid->column_width = grid->side_offset_x + grid->side_length_x;
+	grid->row_height = grid->side_offset_y + grid->side_length_y;
+}
+
+/*
+ * Returns true if the cell at x,y is one of those shifted along the
+ * stagger axis.
+ */
+static inline bool is_staggered_cell(const STAGGER_GRID *grid, int x, int y)
+{
+	return ((grid->stagger_x ? x : y) & 1) ^ grid->stagger_even;
+}
+
+/*
+ * Gets the top left corner of the box of the cell at x,y, in map pixels.
+ */
+static inline void get_staggered_cell_pos(const STAGGER_GRID *grid, int x, int y, float *px, float *py)
+{
+	int shift = is_staggered_cell(grid, x, y);
+	if (grid->stagger_x) {
+		(*px) = x * grid->column_width;
+		(*py) = y * (grid->tile_height + grid->side_length_y) + shift * grid->row_height;
+	} else {
+		(*px) = x * (grid->tile_width + grid->side_length_x) + shift * grid->column_width;
+		(*py) = y * grid->row_height;
+	}
+}
+
+#endif
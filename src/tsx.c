@@ -0,0 +1,156 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ *
+ *                               ---
+ *
+ * External (.tsx) tilesets.
+ *
+ * A map can refer to a tileset kept in its own file with
+ * <tileset firstgid="..." source="file.tsx"/>. Parsed files are cached
+ * by resolved path for the life of the process, so every map after
+ * the first that uses one only copies its tiles out with its own
+ * firstgid. Names, tile properties and animations are shared rather than copied;
+ * each map holds a reference to the arena they live in. Each tileset
+ * keeps the path of its file, so compiled images can tell when it
+ * changes.
+ */
+
+#include "tsx.h"
+#include "parser.h"
+
+/*
+ * A parsed tileset file.
+ */
+typedef struct {
+	char *path;                     // resolved path, used as the cache key
+	time_t mtime;                   // the file's modification time when parsed
+	ALLEGRO_MAP_TILESET *tileset;   // its definition, with tile ids relative to it
+	ARENA *arena;                   // memory the definition lives in
+} TILESET_FILE;
+
+static GHashTable *tileset_files = NULL;
+
+/*
+ * Makes the definition's image path absolute, since it's relative
+ * to the .tsx file rather than to any map that uses it.
+ */
+static void resolve_image_source(ALLEGRO_MAP_TILESET *tileset, ARENA *arena, const char *path)
+{
+	if (!tileset->source) {
+		return;
+	}
+
+	ALLEGRO_PATH *head = al_create_path(path);
+	ALLEGRO_PATH *image = al_create_path(tileset->source);
+	al_rebase_path(head, image);
+
+	char *resolved = resolve_map_path(al_path_cstr(image, ALLEGRO_NATIVE_PATH_SEP));
+	tileset->source = arena_strdup(arena, resolved);
+	g_free(resolved);
+
+	al_destroy_path(image);
+	al_destroy_path(head);
+}
+
+/*
+ * Gets the parsed definition of a tileset file, reading it if it isn't
+ * cached or has changed since it was.
+ */
+static TILESET_FILE *get_tileset_file(const char *filename)
+{
+	if (!tileset_files) {
+		tileset_files = g_hash_table_new(&g_str_hash, &g_str_equal);
+	}
+
+	char *path = resolve_map_path(filename);
+	time_t mtime = get_file_mtime(path);
+
+	TILESET_FILE *file = (TILESET_FILE*)g_hash_table_lookup(tileset_files, path);
+	if (file && file->mtime == mtime) {
+		g_free(path);
+		return file;
+	}
+
+	ARENA *arena;
+	ALLEGRO_MAP_TILESET *tileset = parse_tileset_stream(path, &arena);
+	if (!tileset) {
+		g_free(path);
+		return NULL;
+	}
+
+	resolve_image_source(tileset, arena, path);
+
+	if (file) {
+		// maps built from the old definition hold their own references to its arena
+		unref_arena(file->arena);
+		g_free(path);
+	} else {
+		file = MALLOC(TILESET_FILE);
+		file->path = path;
+		g_hash_table_insert(tileset_files, file->path, file);
+	}
+
+	file->mtime = mtime;
+	file->tileset = tileset;
+	file->arena = arena;
+	return file;
+}
+
+/*
+ * Creates a map's tileset from a .tsx file, numbering its tiles from
+ * the given firstgid. The filename is relative to the current directory.
+ * Returns NULL if the file can't be read.
+ */
+ALLEGRO_MAP_TILESET *load_external_tileset(ALLEGRO_MAP *map, const char *filename, int firstgid)
+{
+	TILESET_FILE *file = get_tileset_file(filename);
+	if (!file) {
+		fprintf(stderr, "Error: failed to load tileset: %s\n", filename);
+		return NULL;
+	}
+
+	ALLEGRO_MAP_TILESET *def = file->tileset;
+	map->shared_arenas = arena_slist_prepend(map->arena, map->shared_arenas, ref_arena(file->arena));
+
+	ALLEGRO_MAP_TILESET *tileset = ARENA_NEW(map->arena, ALLEGRO_MAP_TILESET);
+	tileset->firstgid = firstgid;
+	tileset->tilewidth = def->tilewidth;
+	tileset->tileheight = def->tileheight;
+	tileset->width = def->width;
+	tileset->height = def->height;
+	tileset->name = def->name;
+	tileset->source = def->source;
+	tileset->file = file->path;
+	if (tileset->source) {
+		attach_tileset_image(tileset);
+	}
+
+	GSList *tiles = def->tiles;
+	while (tiles) {
+		ALLEGRO_MAP_TILE *def_tile = (ALLEGRO_MAP_TILE*)tiles->data;
+		tiles = g_slist_next(tiles);
+
+		ALLEGRO_MAP_TILE *tile = ARENA_NEW(map->arena, ALLEGRO_MAP_TILE);
+		tile->id = firstgid + def_tile->id;
+		tile->tileset = tileset;
+		tile->properties = def_tile->properties;
+		tile->frames = def_tile->frames;
+		tile->frame_count = def_tile->frame_count;
+		tileset->tiles = arena_slist_prepend(map->arena, tileset->tiles, tile);
+	}
+
+	return tileset;
+}
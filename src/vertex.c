@@ -0,0 +1,316 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ *
+ *
+ *                               ---
+ *
+ * Drawing tile layers as vertex arrays.
+ *
+ * Even held, every tile drawn with al_draw_tinted_bitmap is a call of
+ * its own, and diagonally flipped tiles take the slower rotated path.
+ * With ALLEGRO_MAP_VERTEX_ARRAYS, a layer is instead turned into two
+ * triangles per tile, one array per texture (tileset image or atlas),
+ * with every flip worked into the texture coordinates, and each array
+ * goes out in a single al_draw_prim call.
+ *
+ * The arrays cover the visible cells plus a margin and are positioned
+ * in layer pixels, so scrolling only moves the transform until the view
+ * leaves the covered cells. Setting a tile rewrites its own vertices
+ * when it stays on the same texture. Tiles that overlap their
+ * neighbours are stacked texture by texture rather than cell by cell.
+ * Callers must have initialized the primitives addon.
+ */
+
+#include "vertex.h"
+#include "draw.h"
+
+/*
+ * Finds the texture and texture coordinates of a gid, the first time
+ * it's drawn.
+ */
+static VERTEX_TILE *resolve_vertex_tile(ALLEGRO_MAP *map, int id)
+{
+	if (id <= 0 || id >= map->tiles_length) {
+		return NULL;
+	}
+
+	if (!map->vertex_tiles) {
+		map->vertex_tiles = (VERTEX_TILE *)al_calloc(map->tiles_length, sizeof(VERTEX_TILE));
+	}
+
+	VERTEX_TILE *vertex_tile = &map->vertex_tiles[id];
+	if (vertex_tile->resolved) {
+		return vertex_tile;
+	}
+	vertex_tile->resolved = true;
+
+	// animated tiles take the coordinates of the frame showing
+	int shown = get_shown_gid(map, id);
+	ALLEGRO_MAP_TILE *tile = al_get_tile_for_id(map, shown);
+	if (!tile || !tile->bitmap) {
+		vertex_tile->texture = NULL;
+		return vertex_tile;
+	}
+
+	ALLEGRO_MAP_TILESET *tileset = tile->tileset;
+	vertex_tile->width = tileset->tilewidth;
+	vertex_tile->height = tileset->tileheight;
+
+	if (map->atlas_tiles && map->atlas_tiles[shown] == tile->bitmap) {
+		vertex_tile->texture = al_get_parent_bitmap(tile->bitmap);
+		vertex_tile->u = map->atlas_origins[shown * 2];
+		vertex_tile->v = map->atlas_origins[shown * 2 + 1];
+	} else {
+		// cut from the tileset image the same way get_tileset_image_tile does
+		int index = shown - tileset->firstgid;
+		int columns = MAX(al_get_bitmap_width(tileset->bitmap) / tileset->tilewidth, 1);
+		vertex_tile->texture = tileset->bitmap;
+		vertex_tile->u = (index % columns) * tileset->tilewidth;
+		vertex_tile->v = (index / columns) * tileset->tileheight;
+	}
+
+	return vertex_tile;
+}
+
+/*
+ * Writes the two triangles of a tile at the given cell. Each corner of
+ * the cell takes the texture corner the tile's flips carry to it: the
+ * diagonal flip swaps the axes after the other two are applied.
+ */
+static void write_tile_vertices(ALLEGRO_VERTEX *vertices, VERTEX_TILE *vertex_tile, int raw, ALLEGRO_COLOR color, float x, float y)
+{
+	static const int corners[4][2] = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+	static const int order[TILE_VERTICES] = {0, 1, 2, 0, 2, 3};
+
+	bool diagonal = raw & FLIPPED_DIAGONALLY_FLAG;
+	float width = diagonal ? vertex_tile->height : vertex_tile->width;
+	float height = diagonal ? vertex_tile->width : vertex_tile->height;
+
+	int i;
+	for (i = 0; i<TILE_VERTICES; i++) {
+		int cx = corners[order[i]][0], cy = corners[order[i]][1];
+		int tx = (raw & FLIPPED_HORIZONTALLY_FLAG) ? 1 - cx : cx;
+		int ty = (raw & FLIPPED_VERTICALLY_FLAG) ? 1 - cy : cy;
+		if (diagonal) {
+			int swap = tx;
+			tx = ty;
+			ty = swap;
+		}
+
+		ALLEGRO_VERTEX *vertex = &vertices[i];
+		vertex->x = x + cx * width;
+		vertex->y = y + cy * height;
+		vertex->z = 0;
+		vertex->u = vertex_tile->u + tx * vertex_tile->width;
+		vertex->v = vertex_tile->v + ty * vertex_tile->height;
+		vertex->color = color;
+	}
+}
+
+/*
+ * Finds the batch for a texture, adding one if there isn't one yet.
+ */
+static int find_vertex_batch(VERTEX_CACHE *cache, ALLEGRO_BITMAP *texture)
+{
+	int i;
+	for (i = 0; i<cache->batch_count; i++) {
+		if (cache->batches[i].texture == texture) {
+			return i;
+		}
+	}
+
+	cache->batches = (VERTEX_BATCH *)al_realloc(cache->batches, (cache->batch_count + 1) * sizeof(VERTEX_BATCH));
+	VERTEX_BATCH *batch = &cache->batches[cache->batch_count];
+	batch->texture = texture;
+	batch->vertices = NULL;
+	batch->count = batch->capacity = 0;
+	return cache->batch_count++;
+}
+
+/*
+ * Rebuilds the batches of a layer to cover the given range of cells.
+ * Batches keep their vertex arrays from one build to the next.
+ */
+static void build_vertex_cache(VERTEX_CACHE *cache, ALLEGRO_MAP_LAYER *layer, ALLEGRO_MAP *map, ALLEGRO_COLOR color, int x1, int y1, int x2, int y2)
+{
+	int i;
+	for (i = 0; i<cache->batch_count; i++) {
+		cache->batches[i].count = 0;
+	}
+
+	cache->x1 = x1;
+	cache->y1 = y1;
+	cache->x2 = x2;
+	cache->y2 = y2;
+	cache->color = color;
+	cache->dirty = false;
+
+	int columns = x2 - x1 + 1, rows = y2 - y1 + 1;
+	al_free(cache->slots);
+	cache->slots = (int *)al_malloc(MAX(columns * rows, 1) * sizeof(int));
+
+	// every slot starts out empty; only the runs that hold tiles are walked
+	memset(cache->slots, 0xff, MAX(columns * rows, 1) * sizeof(int));
+
+	LAYER_SPANS *spans = layer->spans;
+	int mx, my;
+	for (my = y1; my <= y2; my++) {
+		int cell = my * layer->width;
+		int *slots = cache->slots + (my - y1) * columns - x1;
+		int s, end = spans->rows[my + 1];
+		for (s = find_row_span(spans, my, x1); s < end && spans->spans[s * 2] <= x2; s++) {
+			int last = MIN(spans->spans[s * 2 + 1], x2);
+			for (mx = MAX(spans->spans[s * 2], x1); mx <= last; mx++) {
+				int gid = get_layer_gid(layer, cell + mx);
+				VERTEX_TILE *vertex_tile = resolve_vertex_tile(map, gid);
+				if (!vertex_tile || !vertex_tile->texture) {
+					continue;
+				}
+
+				int b = find_vertex_batch(cache, vertex_tile->texture);
+				VERTEX_BATCH *batch = &cache->batches[b];
+				if (batch->count + TILE_VERTICES > batch->capacity) {
+					batch->capacity = MAX(batch->capacity * 2, 64 * TILE_VERTICES);
+					batch->vertices = (ALLEGRO_VERTEX *)al_realloc(batch->vertices, batch->capacity * sizeof(ALLEGRO_VERTEX));
+				}
+
+				slots[mx] = (b << 24) | (batch->count / TILE_VERTICES);
+				write_tile_vertices(batch->vertices + batch->count, vertex_tile,
+						gid | get_layer_flips(layer, cell + mx), color,
+						mx * map->tile_width, my * map->tile_height);
+				batch->count += TILE_VERTICES;
+			}
+		}
+	}
+}
+
+/*
+ * Returns true if two colors are the same.
+ */
+static bool same_color(ALLEGRO_COLOR a, ALLEGRO_COLOR b)
+{
+	return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
+
+/*
+ * Draws the given region of a tile layer as one al_draw_prim call per
+ * texture, rebuilding the vertex arrays first if the region has moved
+ * past the cells they cover.
+ * Returns false if the layer can't be drawn this way, in which case
+ * nothing was drawn.
+ */
+bool draw_vertex_tile_layer(ALLEGRO_MAP_LAYER *layer, ALLEGRO_MAP *map, ALLEGRO_COLOR color, float sx, float sy, float sw, float sh, float dx, float dy)
+{
+	if (layer->chunks) {
+		return false;
+	}
+
+	int ystart = MAX((int)floorf(sy / map->tile_height), 0);
+	int xstart = MAX((int)floorf(sx / map->tile_width), 0);
+	int yend = MIN((int)floorf((sy + sh) / map->tile_height), layer->height - 1);
+	int xend = MIN((int)floorf((sx + sw) / map->tile_width), layer->width - 1);
+	if (xstart > xend || ystart > yend) {
+		return true;
+	}
+
+	if (!layer->vertices) {
+		layer->vertices = (VERTEX_CACHE *)al_calloc(1, sizeof(VERTEX_CACHE));
+		layer->vertices->dirty = true;
+	}
+
+	VERTEX_CACHE *cache = layer->vertices;
+	if (cache->dirty || !same_color(cache->color, color)
+			|| xstart < cache->x1 || ystart < cache->y1 || xend > cache->x2 || yend > cache->y2) {
+		build_vertex_cache(cache, layer, map, color,
+				MAX(xstart - VERTEX_MARGIN, 0), MAX(ystart - VERTEX_MARGIN, 0),
+				MIN(xend + VERTEX_MARGIN, layer->width - 1), MIN(yend + VERTEX_MARGIN, layer->height - 1));
+	}
+
+	// the vertices are in layer pixels, so place them with the transform
+	ALLEGRO_TRANSFORM old, transform;
+	al_copy_transform(&old, al_get_current_transform());
+	al_identity_transform(&transform);
+	al_translate_transform(&transform, dx - sx, dy - sy);
+	al_compose_transform(&transform, &old);
+	al_use_transform(&transform);
+
+	int i;
+	for (i = 0; i<cache->batch_count; i++) {
+		VERTEX_BATCH *batch = &cache->batches[i];
+		if (batch->count) {
+			al_draw_prim(batch->vertices, NULL, batch->texture, 0, batch->count, ALLEGRO_PRIM_TRIANGLE_LIST);
+		}
+	}
+
+	al_use_transform(&old);
+	return true;
+}
+
+/*
+ * Brings a layer's vertex arrays up to date with a cell that was just
+ * set. The cell's vertices are rewritten in place if it had a tile from
+ * the same texture; otherwise the arrays are rebuilt on the next draw.
+ */
+void patch_vertex_cache(ALLEGRO_MAP *map, ALLEGRO_MAP_LAYER *layer, int x, int y)
+{
+	VERTEX_CACHE *cache = layer->vertices;
+	if (!cache || cache->dirty || x < cache->x1 || y < cache->y1 || x > cache->x2 || y > cache->y2) {
+		return;
+	}
+
+	int slot = cache->slots[(x - cache->x1) + (y - cache->y1) * (cache->x2 - cache->x1 + 1)];
+	int i = x + y * layer->width;
+	VERTEX_TILE *vertex_tile = resolve_vertex_tile(map, get_layer_gid(layer, i));
+	if (slot < 0 || !vertex_tile || vertex_tile->texture != cache->batches[slot >> 24].texture) {
+		cache->dirty = true;
+		return;
+	}
+
+	VERTEX_BATCH *batch = &cache->batches[slot >> 24];
+	write_tile_vertices(batch->vertices + (slot & 0xffffff) * TILE_VERTICES, vertex_tile,
+			get_layer_gid(layer, i) | get_layer_flips(layer, i), cache->color,
+			x * map->tile_width, y * map->tile_height);
+}
+
+/*
+ * Frees a layer's vertex arrays.
+ */
+void free_vertex_cache(ALLEGRO_MAP_LAYER *layer)
+{
+	VERTEX_CACHE *cache = layer->vertices;
+	if (!cache) {
+		return;
+	}
+
+	int i;
+	for (i = 0; i<cache->batch_count; i++) {
+		al_free(cache->batches[i].vertices);
+	}
+
+	al_free(cache->batches);
+	al_free(cache->slots);
+	al_free(cache);
+	layer->vertices = NULL;
+}
+
+/*
+ * Frees the map's table of tile texture coordinates.
+ */
+void free_vertex_tiles(ALLEGRO_MAP *map)
+{
+	al_free(map->vertex_tiles);
+	map->vertex_tiles = NULL;
+}
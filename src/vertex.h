@@ -0,0 +1,63 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ */
+
+#ifndef _VERTEX_H
+#define _VERTEX_H
+
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_primitives.h>
+#include <allegro5/allegro_tiled.h>
+#include <glib.h>
+#include "data.h"
+
+// Tiles built around the visible region, so small scrolls don't rebuild
+#define VERTEX_MARGIN 8
+
+// Vertices per tile: two triangles
+#define TILE_VERTICES 6
+
+struct _VERTEX_TILE
+{
+	ALLEGRO_BITMAP *texture;    // tileset image or atlas the tile is cut from, NULL if none
+	float u, v;                 // top left corner of the tile in the texture
+	float width, height;        // size of the tile in the texture
+	bool resolved;              // the fields above have been filled in
+};
+
+typedef struct {
+	ALLEGRO_BITMAP *texture;    // texture every tile in the batch is cut from
+	ALLEGRO_VERTEX *vertices;   // TILE_VERTICES per tile
+	int count;                  // number of vertices in use
+	int capacity;               // number of vertices allocated
+} VERTEX_BATCH;
+
+struct _VERTEX_CACHE
+{
+	int x1, y1, x2, y2;         // range of cells the batches cover
+	ALLEGRO_COLOR color;        // color the vertices were built with
+	bool dirty;                 // must be rebuilt before its next draw
+	VERTEX_BATCH *batches;      // one per texture, in order of first use
+	int batch_count;            // number of batches
+	int *slots;                 // batch << 24 | tile index of each covered cell, or -1
+};
+
+bool draw_vertex_tile_layer(ALLEGRO_MAP_LAYER *layer, ALLEGRO_MAP *map, ALLEGRO_COLOR color, float sx, float sy, float sw, float sh, float dx, float dy);
+void patch_vertex_cache(ALLEGRO_MAP *map, ALLEGRO_MAP_LAYER *layer, int x, int y);
+void free_vertex_cache(ALLEGRO_MAP_LAYER *layer);
+void free_vertex_tiles(ALLEGRO_MAP *map);
+
+#endif
@@ -32,7 +32,7 @@ GSList *get_children_for_name(xmlNode *parent, char *name)
 	if (!parent->children)
 		return list;
 
-	xmlNode *child = parent->children->next;
+	xmlNode *child = parent->children;
 	while (child) {
 		if (!strcmp((const char*)child->name, name)) {
 			list = g_slist_prepend(list, child);
@@ -57,7 +57,7 @@ GSList *get_children_for_either_name(xmlNode *parent, char *name1, char *name2)
 	if (!parent->children)
 		return list;
 
-	xmlNode *child = parent->children->next;
+	xmlNode *child = parent->children;
 	while (child) {
 		if (!strcmp((const char*)child->name, name1) || !strcmp((const char*)child->name, name2)) {
 			list = g_slist_prepend(list, child);
@@ -78,7 +78,7 @@ xmlNode *get_first_child_for_name(xmlNode *parent, char *name)
 	if (!parent->children)
 		return NULL;
 
-	xmlNode *child = parent->children->next;
+	xmlNode *child = parent->children;
 
 	while  (child != NULL) {
 		if (!strcmp((const char*)child->name, name)) {
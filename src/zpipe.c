@@ -16,68 +16,101 @@
  *
  *                               ---
  *
- * Small excerpt taken from zlib.net/zpipe.c, used for decompressing
- * gzip- and zlib-compressed data.
+ * Adapted from zlib.net/zpipe.c, used for decompressing gzip- and
+ * zlib-compressed data.
  */
 
 #include "zpipe.h"
 
-int inf(ALLEGRO_FILE *source, ALLEGRO_FILE *dest)
+/*
+ * Inflate a zlib- or gzip-compressed buffer straight into dest.
+ * The caller already knows how large the output must be, so the whole
+ * stream is inflated in one call; anything shorter or longer than
+ * destlen is treated as corrupt data.
+ */
+int inf(const unsigned char *source, size_t sourcelen, unsigned char *dest, size_t destlen)
 {
 	int ret;
-	unsigned have;
 	z_stream strm;
-	unsigned char in[CHUNK];
-	unsigned char out[CHUNK];
 
 	/* allocate inflate state */
 	strm.zalloc = Z_NULL;
 	strm.zfree = Z_NULL;
 	strm.opaque = Z_NULL;
-	strm.avail_in = 0;
-	strm.next_in = Z_NULL;
-	ret = inflateInit(&strm);
+	strm.avail_in = sourcelen;
+	strm.next_in = (Bytef *)source;
+	strm.avail_out = destlen;
+	strm.next_out = dest;
+
+	/* +32 lets zlib detect a zlib or gzip header on its own */
+	ret = inflateInit2(&strm, MAX_WBITS + 32);
 	if (ret != Z_OK)
 		return ret;
 
-	/* decompress until deflate stream ends or end of file */
-	do {
-		strm.avail_in = al_fread(source, in, CHUNK);
-		if (al_ferror(source)) {
-			(void)inflateEnd(&strm);
-			return Z_ERRNO;
-		}
-		if (strm.avail_in == 0)
-			break;
-		strm.next_in = in;
-
-		/* run inflate() on input until output buffer not full */
-		do {
-			strm.avail_out = CHUNK;
-			strm.next_out = out;
-			ret = inflate(&strm, Z_NO_FLUSH);
-			assert(ret != Z_STREAM_ERROR);  /* state not clobbered */
-			switch (ret) {
-				case Z_NEED_DICT:
-					ret = Z_DATA_ERROR;     /* and fall through */
-				case Z_DATA_ERROR:
-				case Z_MEM_ERROR:
-					(void)inflateEnd(&strm);
-					return ret;
-			}
-			have = CHUNK - strm.avail_out;
-			if (al_fwrite(dest, out, have) != have || al_ferror(dest)) {
-				(void)inflateEnd(&strm);
-				return Z_ERRNO;
-			}
-		} while (strm.avail_out == 0);
-
-		/* done when inflate() says it's done */
-	} while (ret != Z_STREAM_END);
+	ret = inflate(&strm, Z_FINISH);
+	assert(ret != Z_STREAM_ERROR);  /* state not clobbered */
+	if (ret == Z_STREAM_END && strm.avail_out != 0)
+		ret = Z_DATA_ERROR;         /* stream ended early */
 
 	/* clean up and return */
 	(void)inflateEnd(&strm);
-	return ret == Z_STREAM_END ? Z_OK : Z_DATA_ERROR;
+	switch (ret) {
+		case Z_STREAM_END:
+			return Z_OK;
+		case Z_MEM_ERROR:
+			return ret;
+		default:
+			/* Z_NEED_DICT, or Z_BUF_ERROR from truncated input or too much output */
+			return Z_DATA_ERROR;
+	}
+}
+
+/*
+ * Deflate a small buffer into a newly allocated zlib stream, favouring
+ * speed over ratio. The result must be freed with al_free; its size is
+ * stored in destlen.
+ * Returns NULL if the buffer couldn't be compressed.
+ */
+unsigned char *def(const unsigned char *source, size_t sourcelen, size_t *destlen)
+{
+	int ret;
+	z_stream strm;
+
+	/* a small window and hash keep setup cheap; the default state
+	 * costs far more to initialize than a chunk of tile ids does to
+	 * compress */
+	strm.zalloc = Z_NULL;
+	strm.zfree = Z_NULL;
+	strm.opaque = Z_NULL;
+	ret = deflateInit2(&strm, Z_BEST_SPEED, Z_DEFLATED, DEF_WINDOW_BITS, DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY);
+	if (ret != Z_OK) {
+		zerr(ret);
+		return NULL;
+	}
+
+	size_t len = deflateBound(&strm, sourcelen);
+	unsigned char *dest = (unsigned char *)al_malloc(len);
+	if (!dest) {
+		(void)deflateEnd(&strm);
+		return NULL;
+	}
+
+	strm.avail_in = sourcelen;
+	strm.next_in = (Bytef *)source;
+	strm.avail_out = len;
+	strm.next_out = dest;
+	ret = deflate(&strm, Z_FINISH);
+	assert(ret != Z_STREAM_ERROR);  /* state not clobbered */
+
+	*destlen = len - strm.avail_out;
+	(void)deflateEnd(&strm);
+	if (ret != Z_STREAM_END) {
+		zerr(ret);
+		al_free(dest);
+		return NULL;
+	}
+
+	return dest;
 }
 
 /* report a zlib or i/o error */
@@ -85,12 +118,6 @@ void zerr(int ret)
 {
 	fputs("zpipe: ", stderr);
 	switch (ret) {
-		case Z_ERRNO:
-			if (ferror(stdin))
-				fputs("error reading stdin\n", stderr);
-			if (ferror(stdout))
-				fputs("error writing stdout\n", stderr);
-			break;
 		case Z_STREAM_ERROR:
 			fputs("invalid compression level\n", stderr);
 			break;
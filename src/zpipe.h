@@ -24,19 +24,12 @@
 #include <string.h>
 #include <zlib.h>
 
-// Hack to make it work on Windows
-// ???: Is this actually needed?
-#if defined(MSDOS) || defined(OS2) || defined(WIN32) || defined(__CYGWIN__)
-#  include <fcntl.h>
-#  include <io.h>
-#  define SET_BINARY_MODE(file) setmode(fileno(file), O_BINARY)
-#else
-#  define SET_BINARY_MODE(file)
-#endif
-
-#define CHUNK 16384
+// Window and hash sizes used by def(), sized for small buffers
+#define DEF_WINDOW_BITS 10
+#define DEF_MEM_LEVEL 2
 
-int inf(ALLEGRO_FILE *source, ALLEGRO_FILE *dest);
+int inf(const unsigned char *source, size_t sourcelen, unsigned char *dest, size_t destlen);
+unsigned char *def(const unsigned char *source, size_t sourcelen, size_t *destlen);
 void zerr(int ret);
 
 #endif
@@ -0,0 +1,264 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ *
+ *                               ---
+ *
+ * Checks the frames al_update_map shows against the frame each tile's
+ * animation is on at the map's time.
+ *
+ * Two tilesets hold animated tiles with random frames, some lasting no
+ * time at all, next to one whose frames all last no time and two with
+ * frames that can't be shown, which never animate. The map is moved on
+ * in small steps and large jumps, all whole 64ths of a second so the
+ * times add up exactly. After every step the gid each tile shows must
+ * be the frame it's on, and the queue of tiles must still be a heap.
+ * Run with `make check`.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+#include "parser.h"
+
+#define FRAMES 6
+
+static int failures = 0;
+
+#define CHECK(cond, ...) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__); \
+			fprintf(stderr, __VA_ARGS__); \
+			fprintf(stderr, "\n"); \
+			failures++; \
+		} \
+	} while (0)
+
+/*
+ * A tile's animation as written to the map.
+ */
+typedef struct {
+	int frame_count;
+	int tile_ids[FRAMES];
+	int durations[FRAMES];
+	int cycle;                  // 0 if the tile never changes frame
+} ANIMATION;
+
+// tilesets: first gid and tile count
+static const int tilesets[][2] = {{1, 32}, {33, 16}};
+
+// animations by gid, with no frames where the tile isn't animated
+static ANIMATION animations[49];
+
+/*
+ * Loads a map from its text through a temporary file, and finishes it
+ * the way al_open_map does.
+ */
+static ALLEGRO_MAP *load_map(const char *xml)
+{
+	char *filename = NULL;
+	int fd = g_file_open_tmp("anim_test_XXXXXX.tmx", &filename, NULL);
+	CHECK(fd != -1, "couldn't create a temporary map");
+	if (fd == -1) {
+		return NULL;
+	}
+	close(fd);
+	g_file_set_contents(filename, xml, -1, NULL);
+
+	ALLEGRO_MAP *map = parse_map_stream(filename, 1);
+	CHECK(map, "map didn't load");
+	if (map) {
+		finish_map(map);
+	}
+
+	g_remove(filename);
+	g_free(filename);
+	return map;
+}
+
+/*
+ * Writes a tileset and the animations of its tiles.
+ */
+static void append_tileset(GString *xml, int firstgid, int count)
+{
+	g_string_append_printf(xml, " <tileset firstgid=\"%d\" name=\"T%d\" tilewidth=\"16\" tileheight=\"16\">\n"
+			"  <image source=\"missing.png\" width=\"128\" height=\"%d\"/>\n", firstgid, firstgid, count / 8 * 16);
+
+	int id, i;
+	for (id = 0; id<count; id++) {
+		ANIMATION *animation = &animations[firstgid + id];
+		if (!animation->frame_count) {
+			continue;
+		}
+
+		g_string_append_printf(xml, "  <tile id=\"%d\">\n   <animation>\n", id);
+		for (i = 0; i<animation->frame_count; i++) {
+			g_string_append_printf(xml, "    <frame tileid=\"%d\" duration=\"%d\"/>\n",
+					animation->tile_ids[i], animation->durations[i]);
+		}
+		g_string_append(xml, "   </animation>\n  </tile>\n");
+	}
+
+	g_string_append(xml, " </tileset>\n");
+}
+
+/*
+ * Gets the gid a tile should show at the given map time, in milliseconds.
+ */
+static int get_expected_gid(int gid, double time)
+{
+	ANIMATION *animation = &animations[gid];
+	if (!animation->cycle) {
+		return gid;
+	}
+
+	int firstgid = gid < tilesets[1][0] ? tilesets[0][0] : tilesets[1][0];
+	double into = fmod(time, animation->cycle);
+	int i, end = 0;
+	for (i = 0; i<animation->frame_count; i++) {
+		end += animation->durations[i];
+		if (end > into) {
+			break;
+		}
+	}
+
+	return firstgid + animation->tile_ids[i];
+}
+
+/*
+ * Checks every tile's frame, and the order of the queue of tiles.
+ */
+static void check_frames(ALLEGRO_MAP *map, double time, const char *when)
+{
+	MAP_ANIMATIONS *queue = map->animations;
+	CHECK(queue->time == time, "%s: the map's at %gms, expected %gms", when, queue->time, time);
+
+	int gid;
+	for (gid = 1; gid<map->tiles_length; gid++) {
+		int expected = get_expected_gid(gid, time);
+		int shown = get_shown_gid(map, gid);
+		CHECK(shown == expected, "%s: at %gms tile %d shows %d, expected %d", when, time, gid, shown, expected);
+	}
+
+	int i;
+	for (i = 1; i<queue->count; i++) {
+		ANIMATED_TILE *parent = &queue->tiles[queue->queue[(i - 1) / 2]];
+		ANIMATED_TILE *child = &queue->tiles[queue->queue[i]];
+		CHECK(parent->next_change <= child->next_change, "%s: at %gms queue entry %d is due before its parent",
+				when, time, i);
+		CHECK(child->next_change > time, "%s: at %gms tile %d was left behind", when, time, child->gid);
+	}
+	CHECK(queue->tiles[queue->queue[0]].next_change > time, "%s: at %gms the first tile was left behind", when, time);
+}
+
+int main(void)
+{
+	srand(24);
+
+	// the first twenty tiles of each tileset animate
+	int t, id, i, animated = 0;
+	for (t = 0; t<2; t++) {
+		for (id = 0; id<20 && id<tilesets[t][1]; id++) {
+			ANIMATION *animation = &animations[tilesets[t][0] + id];
+			animation->frame_count = 1 + rand() % FRAMES;
+			for (i = 0; i<animation->frame_count; i++) {
+				animation->tile_ids[i] = rand() % tilesets[t][1];
+				animation->durations[i] = rand() % 5 ? 1 + rand() % 700 : 0;
+				animation->cycle += animation->durations[i];
+			}
+			animated += animation->cycle > 0;
+		}
+	}
+
+	// every frame lasting no time
+	ANIMATION *animation = &animations[21];
+	animation->frame_count = 3;
+	animation->cycle = 0;
+	for (i = 0; i<3; i++) {
+		animation->tile_ids[i] = i;
+		animation->durations[i] = 0;
+	}
+
+	// a frame past the last tile, and one lasting less than no time
+	animation = &animations[22];
+	animation->frame_count = 2;
+	animation->tile_ids[1] = 1000;
+	animation->durations[0] = animation->durations[1] = 100;
+	animation = &animations[23];
+	animation->frame_count = 2;
+	animation->tile_ids[1] = 2;
+	animation->durations[0] = 100;
+	animation->durations[1] = -50;
+
+	GString *xml = g_string_new("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+			"<map version=\"1.0\" orientation=\"orthogonal\" width=\"8\" height=\"8\" tilewidth=\"16\" tileheight=\"16\">\n");
+	for (t = 0; t<2; t++) {
+		append_tileset(xml, tilesets[t][0], tilesets[t][1]);
+	}
+	g_string_append(xml, " <layer name=\"ground\" width=\"8\" height=\"8\">\n  <data encoding=\"csv\">\n");
+	for (i = 0; i<64; i++) {
+		g_string_append_printf(xml, "%d%s", 1 + i % 48, i < 63 ? "," : "\n");
+	}
+	g_string_append(xml, "  </data>\n </layer>\n</map>\n");
+
+	ALLEGRO_MAP *map = load_map(xml->str);
+	g_string_free(xml, TRUE);
+	if (!map) {
+		return 1;
+	}
+
+	CHECK(map->animations && map->animations->count == animated, "map has %d animated tiles, expected %d",
+			map->animations ? map->animations->count : 0, animated);
+	if (!map->animations) {
+		return 1;
+	}
+	check_frames(map, 0, "loaded");
+
+	// steps of up to a quarter second, which land on frame changes often
+	double time = 0;
+	int step;
+	for (step = 0; step<3000; step++) {
+		int sixtyfourths = 1 + rand() % 16;
+		al_update_map(map, sixtyfourths / 64.0);
+		time += sixtyfourths * 1000 / 64.0;
+		check_frames(map, time, "stepped");
+	}
+
+	// jumps over many passes of every animation
+	for (step = 0; step<200; step++) {
+		int sixtyfourths = rand() % 64 + 64 * (1 + rand() % 1000);
+		al_update_map(map, sixtyfourths / 64.0);
+		time += sixtyfourths * 1000 / 64.0;
+		check_frames(map, time, "jumped");
+	}
+
+	// time standing still or going back does nothing
+	al_update_map(map, 0);
+	check_frames(map, time, "not moved");
+	al_update_map(map, -2.5);
+	check_frames(map, time, "moved back");
+
+	al_free_map(map);
+
+	if (failures) {
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+
+	printf("All animation checks passed\n");
+	return 0;
+}
@@ -0,0 +1,596 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ *
+ *                               ---
+ *
+ * Round-trips tile ids through every layer data encoding.
+ *
+ * Ids (flip bits included) are encoded the way Tiled writes them, as
+ * csv and as base64 with no compression, zlib or gzip, then decoded
+ * with decode_gids and compared. The csv runs are long enough to take
+ * the SSE2 path where it's built, with ids of every length up to ten
+ * digits. Compressed data must inflate to the same bytes it did when
+ * it went through temp files. The same data, plus unencoded <tile>
+ * nodes, is then read back through both parsers, as plain and chunked
+ * layers, on one thread and on several, and maps with cells laid out
+ * wrongly must fail to load. Tileset tiles whose ids fall outside the
+ * image are dropped.
+ * Run with `make check`.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <glib/gstdio.h>
+#include "decode.h"
+#include "reader.h"
+#include "parser.h"
+#include "chunk.h"
+
+#define WIDTH 37
+#define HEIGHT 11
+#define COUNT (WIDTH * HEIGHT)
+
+static int failures = 0;
+
+#define CHECK(cond, ...) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__); \
+			fprintf(stderr, __VA_ARGS__); \
+			fprintf(stderr, "\n"); \
+			failures++; \
+		} \
+	} while (0)
+
+/*
+ * Fills ids with a spread of values: empty cells, small gids, gids of
+ * every digit count, and all the flip bits up to 0xFFFFFFFF.
+ */
+static void make_ids(guint32 *ids, int count)
+{
+	guint32 seed = 12345;
+	int i;
+	for (i = 0; i<count; i++) {
+		seed = seed * 1103515245 + 12345;
+		switch (i % 6) {
+			case 0: ids[i] = 0; break;
+			case 1: ids[i] = 1 + (seed >> 24); break;
+			case 2: ids[i] = seed >> (seed % 32); break;
+			case 3: ids[i] = (seed & 0xE0000000u) | ((seed >> 8) & 0xFFFF); break;
+			case 4: ids[i] = 0xFFFFFFFFu - (seed & 3); break;
+			default: ids[i] = seed; break;
+		}
+	}
+}
+
+/*
+ * Writes the ids as csv text, wrapped into rows like Tiled does.
+ */
+static char *encode_csv(const guint32 *ids, int count, int row)
+{
+	GString *text = g_string_new("\n");
+	int i;
+	for (i = 0; i<count; i++) {
+		g_string_append_printf(text, "%u", ids[i]);
+		if (i < count - 1) {
+			g_string_append_c(text, ',');
+		}
+		if ((i + 1) % row == 0) {
+			g_string_append_c(text, '\n');
+		}
+	}
+	return g_string_free(text, FALSE);
+}
+
+/*
+ * Writes the ids as unencoded <tile> nodes, leaving out the gid of
+ * empty cells like Tiled does.
+ */
+static char *encode_xml(const guint32 *ids, int count)
+{
+	GString *text = g_string_new("\n");
+	int i;
+	for (i = 0; i<count; i++) {
+		if (ids[i]) {
+			g_string_append_printf(text, "<tile gid=\"%u\"/>\n", ids[i]);
+		} else {
+			g_string_append(text, "<tile/>\n");
+		}
+	}
+	return g_string_free(text, FALSE);
+}
+
+/*
+ * Gets the little-endian bytes of the ids, compressed with "zlib" or
+ * "gzip", or not at all if compression is NULL. The result must be
+ * freed with g_free; its size is stored in len.
+ */
+static Bytef *pack_ids(const guint32 *ids, int count, const char *compression, uLong *len)
+{
+	guint32 *raw = g_new(guint32, count);
+	int i;
+	for (i = 0; i<count; i++) {
+		raw[i] = GUINT32_TO_LE(ids[i]);
+	}
+
+	uLong rawlen = count * sizeof(guint32);
+	if (!compression) {
+		*len = rawlen;
+		return (Bytef *)raw;
+	}
+
+	z_stream stream;
+	memset(&stream, 0, sizeof(stream));
+	// 16 more window bits ask zlib for a gzip wrapper
+	int window = !strcmp(compression, "gzip") ? 15 + 16 : 15;
+	deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, window, 8, Z_DEFAULT_STRATEGY);
+	uLong packedlen = deflateBound(&stream, rawlen);
+	Bytef *packed = g_malloc(packedlen);
+	stream.next_in = (Bytef *)raw;
+	stream.avail_in = rawlen;
+	stream.next_out = packed;
+	stream.avail_out = packedlen;
+	deflate(&stream, Z_FINISH);
+	*len = stream.total_out;
+	deflateEnd(&stream);
+	g_free(raw);
+	return packed;
+}
+
+/*
+ * Writes the ids as base64 text of their little-endian bytes, compressed
+ * first with "zlib" or "gzip", or not at all if compression is NULL.
+ */
+static char *encode_base64(const guint32 *ids, int count, const char *compression)
+{
+	uLong len;
+	Bytef *packed = pack_ids(ids, count, compression, &len);
+	gchar *text = g_base64_encode(packed, len);
+	g_free(packed);
+	return text;
+}
+
+/*
+ * Encodes the ids one way, as in a <data encoding=".." compression="..">
+ * node's text. "xml" stands for <data> with no encoding.
+ */
+static char *encode_ids(const guint32 *ids, int count, const char *encoding, const char *compression)
+{
+	if (!strcmp(encoding, "xml")) {
+		return encode_xml(ids, count);
+	}
+	if (!strcmp(encoding, "csv")) {
+		return encode_csv(ids, count, WIDTH);
+	}
+	return encode_base64(ids, count, compression);
+}
+
+/*
+ * Checks that the decoded ids match the ones that were encoded.
+ */
+static void check_ids(const char *what, const guint32 *ids, const int *data, int count)
+{
+	int i;
+	for (i = 0; i<count; i++) {
+		if ((guint32)data[i] != ids[i]) {
+			CHECK(false, "%s: id %d is %u, expected %u", what, i, (guint32)data[i], ids[i]);
+			return;
+		}
+	}
+}
+
+static const char *encodings[][2] = {
+	{ "xml", NULL },
+	{ "csv", NULL },
+	{ "base64", NULL },
+	{ "base64", "zlib" },
+	{ "base64", "gzip" }
+};
+#define ENCODINGS (sizeof(encodings) / sizeof(encodings[0]))
+
+/*
+ * Decodes every encoding of the ids directly.
+ */
+static void test_decode_gids(const guint32 *ids)
+{
+	int data[COUNT];
+	unsigned i;
+	for (i = 0; i<ENCODINGS; i++) {
+		if (!strcmp(encodings[i][0], "xml")) {
+			// <tile> nodes are read by the parsers themselves
+			continue;
+		}
+		char *text = encode_ids(ids, COUNT, encodings[i][0], encodings[i][1]);
+		memset(data, 0, sizeof(data));
+		CHECK(decode_gids("test", data, COUNT, encodings[i][0], encodings[i][1], text),
+				"%s %s didn't decode", encodings[i][0], encodings[i][1] ? encodings[i][1] : "");
+		check_ids(encodings[i][0], ids, data, COUNT);
+		g_free(text);
+	}
+}
+
+/*
+ * Checks that malformed text is rejected rather than misread. Each one
+ * is long enough for the SSE2 path to look at it 16 bytes at a time.
+ */
+static void test_malformed(void)
+{
+	static const char *bad_csv[] = {
+		"x1234567890123456789",
+		",1234567890123456789",
+		"1,2,3,4,x,6,7,8,9,10,11,12",
+		"1,2,3,4,5,6,7,8,9,10,11,4294967296",
+		"1,2,3,4,5,6,7,8,9,10,11,99999999999999999999"
+	};
+	int data[12];
+	unsigned i;
+	for (i = 0; i<sizeof(bad_csv) / sizeof(bad_csv[0]); i++) {
+		char *text = g_strdup(bad_csv[i]);
+		CHECK(!decode_gids("test", data, 12, "csv", NULL, text), "accepted csv \"%s\"", bad_csv[i]);
+		g_free(text);
+	}
+
+	// a gid too few or too many
+	char few[] = "1,2,3,4,5,6,7,8,9,10,11";
+	CHECK(!decode_gids("test", data, 12, "csv", NULL, few), "accepted 11 csv ids for 12");
+	char many[] = "1,2,3,4,5,6,7,8,9,10,11,12,13";
+	CHECK(!decode_gids("test", data, 12, "csv", NULL, many), "accepted 13 csv ids for 12");
+
+	char bad_base64[] = "AAAA!AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA";
+	CHECK(!decode_gids("test", data, 12, "base64", NULL, bad_base64), "accepted bad base64");
+	char bad_zlib[] = "AAAAAAAAAAAAAAAAAAAA";
+	CHECK(!decode_gids("test", data, 12, "base64", "zlib", bad_zlib), "accepted bad zlib");
+	char bad_gzip[] = "AAAAAAAAAAAAAAAAAAAA";
+	CHECK(!decode_gids("test", data, 12, "base64", "gzip", bad_gzip), "accepted bad gzip");
+}
+
+/*
+ * Inflates a buffer the way layers used to be read, before inf() worked
+ * in memory: the compressed bytes are written to a temp file, inflated
+ * a chunk at a time into another, and read back. Unlike the old code
+ * this accepts gzip as well as zlib. The result must be freed with
+ * g_free; its size is stored in len. Returns NULL if inflating failed.
+ */
+static unsigned char *inflate_through_files(const Bytef *source, uLong sourcelen, size_t *len)
+{
+	FILE *src = tmpfile();
+	FILE *dest = tmpfile();
+	CHECK(src && dest, "couldn't create temporary files");
+	if (!src || !dest) {
+		return NULL;
+	}
+	fwrite(source, 1, sourcelen, src);
+	rewind(src);
+
+	z_stream stream;
+	memset(&stream, 0, sizeof(stream));
+	inflateInit2(&stream, MAX_WBITS + 32);
+	unsigned char in[256], out[256];
+	int ret = Z_OK;
+	do {
+		stream.avail_in = fread(in, 1, sizeof(in), src);
+		if (stream.avail_in == 0) {
+			break;
+		}
+		stream.next_in = in;
+		do {
+			stream.avail_out = sizeof(out);
+			stream.next_out = out;
+			ret = inflate(&stream, Z_NO_FLUSH);
+			if (ret == Z_NEED_DICT || ret == Z_DATA_ERROR || ret == Z_MEM_ERROR) {
+				break;
+			}
+			fwrite(out, 1, sizeof(out) - stream.avail_out, dest);
+		} while (stream.avail_out == 0);
+	} while (ret == Z_OK || ret == Z_BUF_ERROR);
+	inflateEnd(&stream);
+
+	unsigned char *data = NULL;
+	if (ret == Z_STREAM_END) {
+		*len = ftell(dest);
+		data = g_malloc(*len + 1);
+		rewind(dest);
+		CHECK(fread(data, 1, *len, dest) == *len, "couldn't read back the inflated data");
+	}
+	fclose(src);
+	fclose(dest);
+	return data;
+}
+
+/*
+ * Checks that inf() inflates zlib and gzip data to the same bytes as
+ * the old temp file path, and that both reject truncated data.
+ */
+static void test_inflate(const guint32 *ids)
+{
+	static const char *compressions[] = { "zlib", "gzip" };
+	size_t rawlen = COUNT * sizeof(guint32);
+	unsigned char *out = g_malloc(rawlen + 4);
+	unsigned i;
+	for (i = 0; i<sizeof(compressions) / sizeof(compressions[0]); i++) {
+		uLong packedlen;
+		Bytef *packed = pack_ids(ids, COUNT, compressions[i], &packedlen);
+
+		size_t filelen = 0;
+		unsigned char *old = inflate_through_files(packed, packedlen, &filelen);
+		CHECK(old && filelen == rawlen, "%s: temp file path gave %u bytes, expected %u",
+				compressions[i], (unsigned)filelen, (unsigned)rawlen);
+		CHECK(inf(packed, packedlen, out, rawlen) == Z_OK, "%s: inf() failed", compressions[i]);
+		CHECK(old && !memcmp(old, out, rawlen), "%s: inf() and the temp file path differ", compressions[i]);
+		g_free(old);
+
+		// the size is known up front, so more or less output is an error
+		CHECK(inf(packed, packedlen, out, rawlen - 4) != Z_OK, "%s: inf() accepted too much data", compressions[i]);
+		CHECK(inf(packed, packedlen, out, rawlen + 4) != Z_OK, "%s: inf() accepted too little data", compressions[i]);
+
+		old = inflate_through_files(packed, packedlen / 2, &filelen);
+		CHECK(!old, "%s: temp file path accepted truncated data", compressions[i]);
+		CHECK(inf(packed, packedlen / 2, out, rawlen) != Z_OK, "%s: inf() accepted truncated data", compressions[i]);
+		g_free(old);
+		g_free(packed);
+	}
+	g_free(out);
+}
+
+/*
+ * Writes the text of a map to a temporary file, and returns its name.
+ */
+static char *write_temp_map(const char *xml)
+{
+	char *filename = NULL;
+	int fd = g_file_open_tmp("decode_test_XXXXXX.tmx", &filename, NULL);
+	CHECK(fd != -1, "couldn't create a temporary map");
+	if (fd != -1) {
+		close(fd);
+		g_file_set_contents(filename, xml, -1, NULL);
+	}
+	return filename;
+}
+
+/*
+ * Writes a map holding the ids in a layer of every encoding, or in
+ * chunked layers if infinite, to a temporary file. If corrupt is
+ * non-negative, that layer's text is cut short.
+ */
+static char *write_map(const guint32 *ids, bool infinite, int corrupt)
+{
+	GString *xml = g_string_new(NULL);
+	g_string_append_printf(xml, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+			"<map version=\"1.0\" orientation=\"orthogonal\" width=\"%d\" height=\"%d\""
+			" tilewidth=\"16\" tileheight=\"16\" infinite=\"%d\">\n", WIDTH, HEIGHT, infinite);
+
+	unsigned i;
+	for (i = 0; i<ENCODINGS; i++) {
+		g_string_append_printf(xml, " <layer name=\"L%u\" width=\"%d\" height=\"%d\">\n", i, WIDTH, HEIGHT);
+		g_string_append(xml, "  <data");
+		if (strcmp(encodings[i][0], "xml")) {
+			g_string_append_printf(xml, " encoding=\"%s\"", encodings[i][0]);
+		}
+		if (encodings[i][1]) {
+			g_string_append_printf(xml, " compression=\"%s\"", encodings[i][1]);
+		}
+		g_string_append(xml, ">");
+		char *text = encode_ids(ids, COUNT, encodings[i][0], encodings[i][1]);
+		if ((int)i == corrupt) {
+			// unencoded data loses whole <tile> nodes, so it's still XML
+			char *cut = text + strlen(text) / 2;
+			if (!strcmp(encodings[i][0], "xml")) {
+				cut = strstr(cut, "<tile");
+			}
+			*cut = '\0';
+		}
+		if (infinite) {
+			g_string_append_printf(xml, "<chunk x=\"0\" y=\"0\" width=\"%d\" height=\"%d\">%s</chunk>", WIDTH, HEIGHT, text);
+		} else {
+			g_string_append(xml, text);
+		}
+		g_free(text);
+		g_string_append(xml, "</data>\n </layer>\n");
+	}
+	g_string_append(xml, "</map>\n");
+
+	char *filename = write_temp_map(xml->str);
+	g_string_free(xml, TRUE);
+	return filename;
+}
+
+/*
+ * Reads a map with the streaming reader, or the DOM parser if dom is set.
+ */
+static ALLEGRO_MAP *parse_map(const char *filename, int threads, bool dom)
+{
+	return dom ? parse_map_dom(filename, threads) : parse_map_stream(filename, threads);
+}
+
+/*
+ * Reads the maps back with one of the parsers and checks every layer.
+ */
+static void test_reader(const guint32 *ids, bool infinite, int threads, bool dom)
+{
+	const char *parser = dom ? "DOM" : "stream";
+	char *filename = write_map(ids, infinite, -1);
+	ALLEGRO_MAP *map = parse_map(filename, threads, dom);
+	CHECK(map, "%s %s map didn't load on %d threads", parser, infinite ? "infinite" : "finite", threads);
+
+	GSList *layers = map ? map->tile_layers : NULL;
+	unsigned i = 0;
+	if (infinite && map) {
+		al_stream_map_chunks(map, 0, 0, WIDTH * 16, HEIGHT * 16);
+	}
+	for (; layers; layers = g_slist_next(layers), i++) {
+		ALLEGRO_MAP_LAYER *layer = (ALLEGRO_MAP_LAYER*)layers->data;
+		const int *data = layer->data;
+		if (infinite) {
+			int index;
+			LAYER_CHUNK *chunk = find_resident_chunk(layer->chunks, 0, 0, &index);
+			CHECK(chunk, "%s: chunk isn't resident", layer->name);
+			if (!chunk) {
+				continue;
+			}
+			data = chunk->data;
+		}
+		check_ids(layer->name, ids, data, COUNT);
+	}
+	CHECK(i == ENCODINGS, "read %u layers, expected %u", i, (unsigned)ENCODINGS);
+	al_free_map(map);
+	g_remove(filename);
+	g_free(filename);
+
+	// a layer that can't be decoded fails the whole map
+	for (i = 0; i<ENCODINGS; i++) {
+		filename = write_map(ids, infinite, i);
+		map = parse_map(filename, threads, dom);
+		CHECK(!map, "%s %s map with bad %s %s data loaded", parser, infinite ? "infinite" : "finite",
+				encodings[i][0], encodings[i][1] ? encodings[i][1] : "");
+		if (map) {
+			al_free_map(map);
+		}
+		g_remove(filename);
+		g_free(filename);
+	}
+}
+
+/*
+ * Layer data laid out wrongly, and whether a map holding it should load.
+ * The cells go in a 2x2 layer, or in 2x2 chunks if the map is infinite.
+ */
+static const struct {
+	bool infinite;
+	bool loads;
+	const char *data;
+} layouts[] = {
+	{ false, true, "<data><tile gid=\"1\"/><tile/><tile gid=\"2\"/><tile gid=\"3\"/></data>" },
+	{ false, false, "<data><tile gid=\"1\"/><tile gid=\"2\"/><tile gid=\"3\"/></data>" },
+	{ false, false, "<data><tile gid=\"1\"/><tile gid=\"2\"/><tile gid=\"3\"/><tile gid=\"4\"/><tile gid=\"5\"/></data>" },
+	{ false, false, "<data><tile gid=\"1\"/><tile gid=\"x\"/><tile gid=\"3\"/><tile gid=\"4\"/></data>" },
+	{ false, false, "<data><tile gid=\"1\"/><tile gid=\"4294967296\"/><tile gid=\"3\"/><tile gid=\"4\"/></data>" },
+	{ false, false, "<data encoding=\"csv\"/>" },
+	// a layer with no <data> is just empty
+	{ false, true, "" },
+	{ true, true, "" },
+	{ true, true, "<data><chunk x=\"0\" y=\"0\" width=\"2\" height=\"2\"><tile gid=\"1\"/><tile/><tile/><tile gid=\"4\"/></chunk></data>" },
+	// a <tile> outside any chunk has nowhere to go, so it's skipped
+	{ true, true, "<data><tile gid=\"1\"/><chunk x=\"0\" y=\"0\" width=\"2\" height=\"2\"><tile/><tile/><tile/><tile/></chunk><tile gid=\"2\"/></data>" },
+	{ true, false, "<data><chunk x=\"0\" y=\"0\" width=\"0\" height=\"2\"><tile gid=\"1\"/><tile gid=\"2\"/></chunk></data>" },
+	{ true, false, "<data><chunk x=\"0\" y=\"0\" width=\"2\" height=\"-1\"/></data>" },
+	{ true, false, "<data encoding=\"csv\"><chunk x=\"0\" y=\"0\" width=\"0\" height=\"0\">1,2,3,4</chunk></data>" },
+	{ true, false, "<data encoding=\"csv\"><chunk x=\"0\" y=\"0\" width=\"2\" height=\"2\">1,2,3,4</chunk>"
+			"<chunk x=\"2\" y=\"0\" width=\"0\" height=\"2\"></chunk></data>" },
+	{ true, false, "<data><chunk x=\"0\" y=\"0\" width=\"2\" height=\"2\"><tile gid=\"1\"/><tile/><tile/></chunk></data>" },
+	{ true, false, "<data><chunk x=\"0\" y=\"0\" width=\"2\" height=\"2\"><tile/><tile/><tile gid=\"-1\"/><tile/></chunk></data>" },
+	{ true, false, "<data encoding=\"base64\"><chunk x=\"0\" y=\"0\" width=\"2\" height=\"2\"/></data>" }
+};
+
+/*
+ * Reads maps whose layer data is laid out wrongly, checking that both
+ * parsers reject them rather than misreading them or crashing.
+ */
+static void test_layouts(void)
+{
+	unsigned i;
+	for (i = 0; i<sizeof(layouts) / sizeof(layouts[0]); i++) {
+		char *xml = g_strdup_printf("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+				"<map version=\"1.0\" orientation=\"orthogonal\" width=\"2\" height=\"2\""
+				" tilewidth=\"16\" tileheight=\"16\" infinite=\"%d\">\n"
+				" <layer name=\"L\" width=\"2\" height=\"2\">%s</layer>\n</map>\n",
+				layouts[i].infinite, layouts[i].data);
+		char *filename = write_temp_map(xml);
+		ALLEGRO_MAP *map = parse_map_stream(filename, 1);
+		CHECK(!map == !layouts[i].loads, "map %s: %s", layouts[i].loads ? "didn't load" : "loaded", layouts[i].data);
+		if (map) {
+			al_free_map(map);
+		}
+
+		map = parse_map_dom(filename, 1);
+		CHECK(!map == !layouts[i].loads, "DOM map %s: %s", layouts[i].loads ? "didn't load" : "loaded", layouts[i].data);
+		if (map) {
+			al_free_map(map);
+		}
+		g_remove(filename);
+		g_free(filename);
+		g_free(xml);
+	}
+}
+
+/*
+ * Reads a tileset whose <tile> ids run off both ends of its image,
+ * checking that both parsers drop those tiles rather than sizing the
+ * map's tile list by them.
+ */
+static void test_tile_ids(void)
+{
+	// a 4x2 image of 16x16 tiles, so local ids 0 to 7
+	const char *xml = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+			"<map version=\"1.0\" orientation=\"orthogonal\" width=\"2\" height=\"2\" tilewidth=\"16\" tileheight=\"16\">\n"
+			" <tileset firstgid=\"1\" name=\"T\" tilewidth=\"16\" tileheight=\"16\">\n"
+			"  <image source=\"missing.png\" width=\"64\" height=\"32\"/>\n"
+			"  <tile id=\"-1\"/>\n  <tile id=\"0\"/>\n  <tile id=\"7\"/>\n  <tile id=\"8\"/>\n"
+			"  <tile id=\"2000000000\"/>\n"
+			" </tileset>\n"
+			" <layer name=\"L\" width=\"2\" height=\"2\"><data encoding=\"csv\">1,8,9,0</data></layer>\n"
+			"</map>\n";
+	char *filename = write_temp_map(xml);
+
+	int i;
+	for (i = 0; i<2; i++) {
+		ALLEGRO_MAP *map = i ? parse_map_dom(filename, 1) : parse_map_stream(filename, 1);
+		CHECK(map, "%s map with stray tile ids didn't load", i ? "DOM" : "stream");
+		if (!map) {
+			continue;
+		}
+
+		ALLEGRO_MAP_TILESET *tileset = (ALLEGRO_MAP_TILESET*)map->tilesets->data;
+		CHECK(g_slist_length(tileset->tiles) == 2, "%s: kept %u tiles, expected 2",
+				i ? "DOM" : "stream", g_slist_length(tileset->tiles));
+		finish_map(map);
+		CHECK(map->tiles_length == 9, "%s: tile list has %d entries, expected 9",
+				i ? "DOM" : "stream", (int)map->tiles_length);
+		CHECK(!al_get_tile_for_id(map, 9), "%s: got a tile past the end of the tileset", i ? "DOM" : "stream");
+		al_free_map(map);
+	}
+
+	g_remove(filename);
+	g_free(filename);
+}
+
+int main(void)
+{
+	guint32 ids[COUNT];
+	make_ids(ids, COUNT);
+
+	test_decode_gids(ids);
+	test_malformed();
+	test_inflate(ids);
+	test_reader(ids, false, 1, false);
+	test_reader(ids, false, 4, false);
+	test_reader(ids, true, 1, false);
+	test_reader(ids, true, 4, false);
+	test_reader(ids, false, 1, true);
+	test_reader(ids, false, 4, true);
+	test_reader(ids, true, 1, true);
+	test_reader(ids, true, 4, true);
+	test_layouts();
+	test_tile_ids();
+
+	if (failures) {
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+
+	printf("All decode checks passed\n");
+	return 0;
+}
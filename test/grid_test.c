@@ -0,0 +1,229 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ *
+ *                               ---
+ *
+ * Checks searches of the object grid against testing every object.
+ *
+ * An object layer with small, large and tile objects, some of them off
+ * the map, is searched over random rectangles with al_get_objects_in_rect,
+ * and the objects found must be exactly those whose bounds overlap the
+ * rectangle, in layer order. The objects are then moved around with
+ * al_set_object_pos, near and far, and searched again.
+ * Run with `make check`.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+#include "parser.h"
+
+#define WIDTH 100
+#define HEIGHT 60
+#define TILE 32
+#define OBJECTS 1500
+
+static int failures = 0;
+
+#define CHECK(cond, ...) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__); \
+			fprintf(stderr, __VA_ARGS__); \
+			fprintf(stderr, "\n"); \
+			failures++; \
+		} \
+	} while (0)
+
+/*
+ * Loads a map from its text through a temporary file, and finishes it
+ * the way al_open_map does.
+ */
+static ALLEGRO_MAP *load_map(const char *xml)
+{
+	char *filename = NULL;
+	int fd = g_file_open_tmp("grid_test_XXXXXX.tmx", &filename, NULL);
+	CHECK(fd != -1, "couldn't create a temporary map");
+	if (fd == -1) {
+		return NULL;
+	}
+	close(fd);
+	g_file_set_contents(filename, xml, -1, NULL);
+
+	ALLEGRO_MAP *map = parse_map_stream(filename, 1);
+	CHECK(map, "map didn't load");
+	if (map) {
+		finish_map(map);
+	}
+
+	g_remove(filename);
+	g_free(filename);
+	return map;
+}
+
+/*
+ * Gets a random position around the map, sometimes well off it.
+ */
+static int random_pos(int size)
+{
+	return rand() % 10 ? rand() % (size + 400) - 200 : rand() % (size * 6) - size * 3;
+}
+
+/*
+ * Finds the objects overlapping the rectangle by testing every one,
+ * in layer order. Tile objects hang up from their position.
+ * Returns the number found.
+ */
+static int find_objects(ALLEGRO_MAP_OBJECT **objects, int count, float x, float y, float w, float h, ALLEGRO_MAP_OBJECT **found)
+{
+	int i, n = 0;
+	for (i = 0; i<count; i++) {
+		ALLEGRO_MAP_OBJECT *object = objects[i];
+		int top = object->gid ? object->y - object->height : object->y;
+		if (object->x + object->width >= x && object->x <= x + w && top + object->height >= y && top <= y + h) {
+			found[n++] = object;
+		}
+	}
+	return n;
+}
+
+/*
+ * Searches random rectangles, comparing the grid with testing every object.
+ */
+static void check_searches(ALLEGRO_MAP_LAYER *layer, int searches, const char *when)
+{
+	int count;
+	ALLEGRO_MAP_OBJECT **objects = al_get_objects(layer, &count);
+	ALLEGRO_MAP_OBJECT **expected = g_new(ALLEGRO_MAP_OBJECT*, count + 1);
+	ALLEGRO_MAP_OBJECT **found = g_new(ALLEGRO_MAP_OBJECT*, count + 1);
+
+	int i;
+	for (i = 0; i<searches; i++) {
+		float x = random_pos(WIDTH * TILE), y = random_pos(HEIGHT * TILE);
+		float w = rand() % 4 ? rand() % 600 : rand() % (WIDTH * TILE * 2);
+		float h = rand() % 4 ? rand() % 400 : rand() % (HEIGHT * TILE * 2);
+		if (i % 3 == 0) {
+			// fractional edges
+			x += 0.5f;
+			w += 0.25f;
+		}
+
+		int n = find_objects(objects, count, x, y, w, h, expected);
+		int got = al_get_objects_in_rect(layer, x, y, w, h, found, count + 1);
+		CHECK(got == n, "%s: found %d objects in %g,%g %gx%g, expected %d", when, got, x, y, w, h, n);
+		if (got == n) {
+			CHECK(!memcmp(found, expected, n * sizeof(ALLEGRO_MAP_OBJECT*)),
+					"%s: objects in %g,%g %gx%g differ or are out of order", when, x, y, w, h);
+		}
+
+		// a short results array still gets the count, and the first ones
+		if (n > 2) {
+			memset(found, 0, (count + 1) * sizeof(ALLEGRO_MAP_OBJECT*));
+			CHECK(al_get_objects_in_rect(layer, x, y, w, h, found, 2) == n && found[0] == expected[0]
+					&& found[1] == expected[1] && !found[2], "%s: search with room for 2 objects went wrong", when);
+		}
+	}
+
+	g_free(expected);
+	g_free(found);
+	al_free(objects);
+}
+
+int main(void)
+{
+	srand(21);
+
+	GString *xml = g_string_new(NULL);
+	g_string_append_printf(xml, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+			"<map version=\"1.0\" orientation=\"orthogonal\" width=\"%d\" height=\"%d\" tilewidth=\"%d\" tileheight=\"%d\">\n"
+			" <objectgroup name=\"objects\">\n", WIDTH, HEIGHT, TILE, TILE);
+	int i;
+	for (i = 0; i<OBJECTS; i++) {
+		int w, h;
+		switch (i % 10) {
+			case 0:
+				// larger than a cell of the grid
+				w = OBJECT_CELL_SIZE + rand() % 1000;
+				h = rand() % 600;
+				break;
+			case 1:
+				// a point
+				w = h = 0;
+				break;
+			default:
+				w = rand() % 100;
+				h = rand() % 100;
+				break;
+		}
+		g_string_append_printf(xml, "  <object id=\"%d\" x=\"%d\" y=\"%d\" width=\"%d\" height=\"%d\"%s/>\n",
+				i + 1, random_pos(WIDTH * TILE), random_pos(HEIGHT * TILE), w, h, i % 4 == 3 ? " gid=\"1\"" : "");
+	}
+	g_string_append(xml, " </objectgroup>\n</map>\n");
+
+	ALLEGRO_MAP *map = load_map(xml->str);
+	g_string_free(xml, TRUE);
+	if (!map) {
+		return 1;
+	}
+
+	ALLEGRO_MAP_LAYER *layer = al_get_map_layer(map, "objects");
+	CHECK(layer && layer->object_grid, "the object layer has no grid");
+	if (!layer || !layer->object_grid) {
+		return 1;
+	}
+	check_searches(layer, 400, "loaded");
+
+	int count;
+	ALLEGRO_MAP_OBJECT **objects = al_get_objects(layer, &count);
+	CHECK(count == OBJECTS, "layer has %d objects, expected %d", count, OBJECTS);
+
+	int round;
+	for (round = 0; round<30; round++) {
+		int moves = 1 + rand() % 200;
+		for (i = 0; i<moves; i++) {
+			ALLEGRO_MAP_OBJECT *object = objects[rand() % count];
+			if (rand() % 3) {
+				// a step, which usually stays in the same cell
+				al_set_object_pos(object, object->x + rand() % 41 - 20, object->y + rand() % 41 - 20);
+			} else {
+				al_set_object_pos(object, random_pos(WIDTH * TILE), random_pos(HEIGHT * TILE));
+			}
+		}
+		check_searches(layer, 50, "moved");
+	}
+
+	// everything piled into one spot, then spread out again
+	for (i = 0; i<count; i++) {
+		al_set_object_pos(objects[i], 100, 100);
+	}
+	check_searches(layer, 50, "piled up");
+	for (i = 0; i<count; i++) {
+		al_set_object_pos(objects[i], random_pos(WIDTH * TILE), random_pos(HEIGHT * TILE));
+	}
+	check_searches(layer, 50, "spread out");
+
+	al_free(objects);
+	al_free_map(map);
+
+	if (failures) {
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+
+	printf("All object grid checks passed\n");
+	return 0;
+}
@@ -0,0 +1,299 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ *
+ *                               ---
+ *
+ * Checks compiled tile queries against the tiles' properties.
+ *
+ * Two tilesets give their tiles "solid" and "water" properties of every
+ * kind: booleans, numbers and strings that are neither. Queries for
+ * both must match every gid, with and without flip flags, and every
+ * cell of the layers, before and after the layers are indexed. The
+ * cells are then edited at random with al_set_single_tile_id, and one
+ * query destroyed half way, and the other must keep up.
+ * Run with `make check`.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+#include "parser.h"
+
+#define WIDTH 70
+#define HEIGHT 45
+#define TILES 12
+#define FLAGS 0xe0000000u
+
+static int failures = 0;
+
+#define CHECK(cond, ...) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__); \
+			fprintf(stderr, __VA_ARGS__); \
+			fprintf(stderr, "\n"); \
+			failures++; \
+		} \
+	} while (0)
+
+/*
+ * Property values, and whether a query for them should match.
+ */
+static const struct {
+	const char *value;
+	bool matches;
+} values[] = {
+	{"true", true}, {"false", false}, {"1", true}, {"0", false}, {"2.5", true},
+	{"-3", true}, {"0.0", false}, {"yes", false}, {"", false}
+};
+
+#define VALUES (int)(sizeof(values) / sizeof(values[0]))
+
+// the value of each gid's properties, or -1 where it has none
+static int solid[TILES + 1];
+static int water[TILES + 1];
+
+// the raw ids each layer's cells should hold
+static guint32 cells[2][WIDTH * HEIGHT];
+
+/*
+ * Loads a map from its text through a temporary file, and finishes it
+ * the way al_open_map does.
+ */
+static ALLEGRO_MAP *load_map(const char *xml)
+{
+	char *filename = NULL;
+	int fd = g_file_open_tmp("query_test_XXXXXX.tmx", &filename, NULL);
+	CHECK(fd != -1, "couldn't create a temporary map");
+	if (fd == -1) {
+		return NULL;
+	}
+	close(fd);
+	g_file_set_contents(filename, xml, -1, NULL);
+
+	ALLEGRO_MAP *map = parse_map_stream(filename, 1);
+	CHECK(map, "map didn't load");
+	if (map) {
+		finish_map(map);
+	}
+
+	g_remove(filename);
+	g_free(filename);
+	return map;
+}
+
+/*
+ * Gets a random raw id: empty, a tile with or without flip flags, or
+ * a tile with every flag set.
+ */
+static guint32 random_id(void)
+{
+	switch (rand() % 6) {
+		case 0:
+			return 0;
+		case 1:
+			return (1 + rand() % TILES) | FLAGS;
+		default:
+			return (1 + rand() % TILES) | ((guint32)(rand() % 8) << 29);
+	}
+}
+
+/*
+ * Writes a tileset of count tiles whose properties are taken from the
+ * tables, starting at firstgid.
+ */
+static void append_tileset(GString *xml, int firstgid, int count)
+{
+	g_string_append_printf(xml, " <tileset firstgid=\"%d\" name=\"T%d\" tilewidth=\"16\" tileheight=\"16\">\n"
+			"  <image source=\"missing.png\" width=\"%d\" height=\"16\"/>\n", firstgid, firstgid, count * 16);
+
+	int id;
+	for (id = 0; id<count; id++) {
+		int gid = firstgid + id;
+		if (solid[gid] < 0 && water[gid] < 0) {
+			continue;
+		}
+
+		g_string_append_printf(xml, "  <tile id=\"%d\">\n   <properties>\n", id);
+		if (solid[gid] >= 0) {
+			g_string_append_printf(xml, "    <property name=\"solid\" value=\"%s\"/>\n", values[solid[gid]].value);
+		}
+		if (water[gid] >= 0) {
+			g_string_append_printf(xml, "    <property name=\"water\" value=\"%s\"/>\n", values[water[gid]].value);
+		}
+		g_string_append(xml, "   </properties>\n  </tile>\n");
+	}
+
+	g_string_append(xml, " </tileset>\n");
+}
+
+/*
+ * Returns true if a raw id should match a query for the property whose
+ * values are in the table.
+ */
+static bool id_matches(const int *table, guint32 id)
+{
+	guint32 gid = id & ~FLAGS;
+	return gid >= 1 && gid <= TILES && table[gid] >= 0 && values[table[gid]].matches;
+}
+
+/*
+ * Checks a query against every id and every cell, and a ring of
+ * cells around each layer.
+ */
+static void check_query(ALLEGRO_MAP *map, ALLEGRO_MAP_TILE_QUERY *query, const int *table, const char *when)
+{
+	guint32 id;
+	for (id = 0; id <= TILES + 3; id++) {
+		bool expected = id_matches(table, id);
+		CHECK(al_query_tile_id(query, id) == expected, "%s: id %u should%s match", when, id, expected ? "" : "n't");
+		CHECK(al_query_tile_id(query, (int)(id | FLAGS)) == expected, "%s: flipped id %u should%s match",
+				when, id, expected ? "" : "n't");
+		CHECK(al_query_tile_id(query, (int)(id | (1u << 29))) == expected, "%s: diagonally flipped id %u should%s match",
+				when, id, expected ? "" : "n't");
+
+		// the library's own reading of the property agrees
+		ALLEGRO_MAP_TILE *tile = al_get_tile_for_id(map, id);
+		CHECK(al_get_tile_property_bool(tile, table == solid ? "solid" : "water", false) == expected,
+				"%s: tile %u's property reads differently", when, id);
+	}
+
+	int l, x, y;
+	for (l = 0; l<2; l++) {
+		ALLEGRO_MAP_LAYER *layer = al_get_map_layer(map, l ? "top" : "ground");
+		for (y = -1; y <= HEIGHT; y++) {
+			for (x = -1; x <= WIDTH; x++) {
+				bool expected = x >= 0 && y >= 0 && x < WIDTH && y < HEIGHT && id_matches(table, cells[l][x + y * WIDTH]);
+				CHECK(al_query_tile(query, layer, x, y) == expected, "%s: cell %d,%d of \"%s\" should%s match",
+						when, x, y, layer->name, expected ? "" : "n't");
+			}
+		}
+	}
+
+	CHECK(!al_query_tile(query, al_get_map_layer(map, "objects"), 0, 0), "%s: an object layer matched", when);
+}
+
+/*
+ * Sets random cells of the layers, including a few ids past the last
+ * tileset, which must be refused and leave the cell alone.
+ */
+static void edit_layers(ALLEGRO_MAP *map, int edits)
+{
+	int i;
+	for (i = 0; i<edits; i++) {
+		int l = rand() % 2;
+		ALLEGRO_MAP_LAYER *layer = al_get_map_layer(map, l ? "top" : "ground");
+		int x = rand() % WIDTH, y = rand() % HEIGHT;
+
+		if (rand() % 50 == 0) {
+			int id = TILES + 1 + rand() % 4;
+			CHECK(!al_set_single_tile_id(map, layer, x, y, id), "set %d,%d to id %d past the last tileset", x, y, id);
+			continue;
+		}
+
+		guint32 id = random_id();
+		CHECK(al_set_single_tile_id(map, layer, x, y, (int)id), "couldn't set %d,%d to id %u", x, y, id);
+		cells[l][x + y * WIDTH] = id;
+	}
+}
+
+int main(void)
+{
+	srand(23);
+
+	// a few tiles of each tileset have no properties at all, and the
+	// value tables come round so every value shows up for both names
+	int gid;
+	for (gid = 0; gid <= TILES; gid++) {
+		solid[gid] = gid == 0 || gid % 5 == 4 ? -1 : gid % VALUES;
+		water[gid] = gid == 0 || gid % 3 == 0 ? -1 : (gid * 4) % VALUES;
+	}
+
+	GString *xml = g_string_new(NULL);
+	g_string_append_printf(xml, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+			"<map version=\"1.0\" orientation=\"orthogonal\" width=\"%d\" height=\"%d\" tilewidth=\"16\" tileheight=\"16\">\n",
+			WIDTH, HEIGHT);
+	append_tileset(xml, 1, 7);
+	append_tileset(xml, 8, TILES - 7);
+
+	int l, i;
+	for (l = 0; l<2; l++) {
+		g_string_append_printf(xml, " <layer name=\"%s\" width=\"%d\" height=\"%d\">\n  <data encoding=\"csv\">\n",
+				l ? "top" : "ground", WIDTH, HEIGHT);
+		for (i = 0; i<WIDTH * HEIGHT; i++) {
+			cells[l][i] = l && rand() % 3 ? 0 : random_id();
+			g_string_append_printf(xml, "%u%s", cells[l][i], i < WIDTH * HEIGHT - 1 ? "," : "\n");
+		}
+		g_string_append(xml, "  </data>\n </layer>\n");
+	}
+	g_string_append(xml, " <objectgroup name=\"objects\"/>\n</map>\n");
+
+	ALLEGRO_MAP *map = load_map(xml->str);
+	g_string_free(xml, TRUE);
+	if (!map) {
+		return 1;
+	}
+
+	ALLEGRO_MAP_TILE_QUERY *solid_query = al_create_tile_query(map, "solid");
+	ALLEGRO_MAP_TILE_QUERY *water_query = al_create_tile_query(map, "water");
+	check_query(map, solid_query, solid, "unindexed");
+	check_query(map, water_query, water, "unindexed");
+
+	// edits before indexing only touch the cells
+	edit_layers(map, 300);
+	check_query(map, solid_query, solid, "edited unindexed");
+
+	CHECK(al_index_tile_query(solid_query, al_get_map_layer(map, "ground")), "couldn't index the ground");
+	CHECK(al_index_tile_query(solid_query, al_get_map_layer(map, "top")), "couldn't index the top");
+	CHECK(al_index_tile_query(water_query, al_get_map_layer(map, "top")), "couldn't index the top");
+	CHECK(!al_index_tile_query(water_query, al_get_map_layer(map, "objects")), "indexed an object layer");
+	check_query(map, solid_query, solid, "indexed");
+	check_query(map, water_query, water, "partly indexed");
+
+	int round;
+	for (round = 0; round<20; round++) {
+		edit_layers(map, 1 + rand() % 400);
+		check_query(map, solid_query, solid, "edited");
+		if (water_query) {
+			check_query(map, water_query, water, "edited");
+		}
+
+		if (round == 8) {
+			al_destroy_tile_query(water_query);
+			water_query = NULL;
+		}
+	}
+
+	// indexing a layer again starts its grid afresh from the cells
+	CHECK(al_index_tile_query(solid_query, al_get_map_layer(map, "ground")), "couldn't index the ground again");
+	check_query(map, solid_query, solid, "indexed again");
+
+	// a query made after the edits starts out right, and the map frees it
+	water_query = al_create_tile_query(map, "water");
+	CHECK(al_index_tile_query(water_query, al_get_map_layer(map, "ground")), "couldn't index the ground");
+	check_query(map, water_query, water, "recreated");
+
+	al_free_map(map);
+
+	if (failures) {
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+
+	printf("All tile query checks passed\n");
+	return 0;
+}
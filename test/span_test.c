@@ -0,0 +1,237 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ *
+ *                               ---
+ *
+ * Checks the span index of tile layers against the cells it indexes.
+ *
+ * Layers from dense to empty are loaded, then edited cell by cell and
+ * run by run with al_set_single_tile_id. After each batch of edits the
+ * spans that update_layer_spans kept up to date must match the ones
+ * index_layer_spans builds from scratch, cover every tile, start and
+ * end on tiles, and be split only by gaps wider than SPAN_GAP.
+ * Run with `make check`.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+#include "parser.h"
+
+#define WIDTH 150
+#define HEIGHT 40
+
+static int failures = 0;
+
+#define CHECK(cond, ...) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__); \
+			fprintf(stderr, __VA_ARGS__); \
+			fprintf(stderr, "\n"); \
+			failures++; \
+		} \
+	} while (0)
+
+/*
+ * Loads a map from its text through a temporary file, and finishes it
+ * the way al_open_map does.
+ */
+static ALLEGRO_MAP *load_map(const char *xml)
+{
+	char *filename = NULL;
+	int fd = g_file_open_tmp("span_test_XXXXXX.tmx", &filename, NULL);
+	CHECK(fd != -1, "couldn't create a temporary map");
+	if (fd == -1) {
+		return NULL;
+	}
+	close(fd);
+	g_file_set_contents(filename, xml, -1, NULL);
+
+	ALLEGRO_MAP *map = parse_map_stream(filename, 1);
+	CHECK(map, "map didn't load");
+	if (map) {
+		finish_map(map);
+	}
+
+	g_remove(filename);
+	g_free(filename);
+	return map;
+}
+
+/*
+ * Writes a layer whose cells hold a tile one time in every fill,
+ * in runs of up to run cells.
+ */
+static void append_layer(GString *xml, const char *name, int fill, int run)
+{
+	g_string_append_printf(xml, " <layer name=\"%s\" width=\"%d\" height=\"%d\">\n  <data encoding=\"csv\">\n",
+			name, WIDTH, HEIGHT);
+	int i, left = 0;
+	for (i = 0; i<WIDTH * HEIGHT; i++) {
+		if (!left && fill && rand() % fill == 0) {
+			left = 1 + rand() % run;
+		}
+		g_string_append_printf(xml, "%d%s", left ? 1 + rand() % 8 : 0, i < WIDTH * HEIGHT - 1 ? "," : "\n");
+		if (left) {
+			left--;
+		}
+	}
+	g_string_append(xml, "  </data>\n </layer>\n");
+}
+
+/*
+ * Checks a layer's spans against its cells, and against the spans
+ * indexing it again from scratch gives. Leaves the fresh spans in place.
+ */
+static void check_spans(ALLEGRO_MAP_LAYER *layer, const char *when)
+{
+	LAYER_SPANS *spans = layer->spans;
+	CHECK(spans, "%s: layer \"%s\" has no spans", when, layer->name);
+	if (!spans) {
+		return;
+	}
+
+	int y, x, k;
+	for (y = 0; y<layer->height; y++) {
+		for (k = spans->rows[y]; k < spans->rows[y + 1]; k++) {
+			int first = spans->spans[k * 2], last = spans->spans[k * 2 + 1];
+			CHECK(first <= last && get_layer_gid(layer, first + y * layer->width) && get_layer_gid(layer, last + y * layer->width),
+					"%s: \"%s\" row %d span %d-%d doesn't start and end on tiles", when, layer->name, y, first, last);
+			if (k > spans->rows[y]) {
+				CHECK(first - spans->spans[k * 2 - 1] > SPAN_GAP, "%s: \"%s\" row %d spans split by a gap of %d",
+						when, layer->name, y, first - spans->spans[k * 2 - 1]);
+			}
+		}
+
+		for (x = 0; x<layer->width; x++) {
+			if (!get_layer_gid(layer, x + y * layer->width)) {
+				continue;
+			}
+			k = find_row_span(spans, y, x);
+			CHECK(k < spans->rows[y + 1] && spans->spans[k * 2] <= x,
+					"%s: \"%s\" tile at %d,%d isn't in a span", when, layer->name, x, y);
+		}
+	}
+
+	int count = spans->count;
+	int *rows = g_new(int, layer->height + 1);
+	int *found = g_new(int, MAX(count, 1) * 2);
+	memcpy(rows, spans->rows, (layer->height + 1) * sizeof(int));
+	memcpy(found, spans->spans, count * 2 * sizeof(int));
+
+	index_layer_spans(layer);
+	spans = layer->spans;
+	CHECK(spans->count == count, "%s: \"%s\" kept %d spans, a fresh index has %d", when, layer->name, count, spans->count);
+	CHECK(!memcmp(rows, spans->rows, (layer->height + 1) * sizeof(int)), "%s: \"%s\" row starts differ from a fresh index",
+			when, layer->name);
+	CHECK(spans->count != count || !memcmp(found, spans->spans, count * 2 * sizeof(int)),
+			"%s: \"%s\" spans differ from a fresh index", when, layer->name);
+
+	g_free(rows);
+	g_free(found);
+}
+
+/*
+ * Makes random edits to a layer: single cells, runs, and whole rows
+ * cleared or filled, with and without flip flags.
+ */
+static void edit_layer(ALLEGRO_MAP *map, ALLEGRO_MAP_LAYER *layer, int edits)
+{
+	int i;
+	for (i = 0; i<edits; i++) {
+		int x = rand() % layer->width, y = rand() % layer->height;
+		int id = rand() % 3 ? 0 : (int)((1 + rand() % 8) | ((guint32)(rand() % 8) << 29));
+		int length = 1, k;
+		switch (rand() % 8) {
+			case 0:
+				// a run, which may bridge or split spans
+				length = 1 + rand() % (SPAN_GAP * 3);
+				break;
+			case 1:
+				// the whole row
+				x = 0;
+				length = layer->width;
+				break;
+		}
+
+		for (k = 0; k<length && x + k < layer->width; k++) {
+			CHECK(al_set_single_tile_id(map, layer, x + k, y, id), "couldn't set %d,%d of \"%s\"", x + k, y, layer->name);
+		}
+	}
+}
+
+int main(void)
+{
+	srand(20);
+
+	GString *xml = g_string_new(NULL);
+	g_string_append_printf(xml, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+			"<map version=\"1.0\" orientation=\"orthogonal\" width=\"%d\" height=\"%d\" tilewidth=\"16\" tileheight=\"16\">\n"
+			" <tileset firstgid=\"1\" name=\"T\" tilewidth=\"16\" tileheight=\"16\">\n"
+			"  <image source=\"missing.png\" width=\"64\" height=\"32\"/>\n"
+			" </tileset>\n", WIDTH, HEIGHT);
+	append_layer(xml, "dense", 1, 1);
+	append_layer(xml, "scattered", 12, 3);
+	append_layer(xml, "sparse", 400, 20);
+	append_layer(xml, "empty", 0, 1);
+	g_string_append(xml, "</map>\n");
+
+	ALLEGRO_MAP *map = load_map(xml->str);
+	g_string_free(xml, TRUE);
+	if (!map) {
+		return 1;
+	}
+
+	CHECK(layer_is_empty(al_get_map_layer(map, "empty")), "the empty layer isn't empty");
+	CHECK(!layer_is_empty(al_get_map_layer(map, "sparse")), "the sparse layer is empty");
+
+	GSList *layers;
+	for (layers = map->tile_layers; layers; layers = g_slist_next(layers)) {
+		check_spans((ALLEGRO_MAP_LAYER*)layers->data, "loaded");
+	}
+
+	int round;
+	for (round = 0; round<40; round++) {
+		for (layers = map->tile_layers; layers; layers = g_slist_next(layers)) {
+			ALLEGRO_MAP_LAYER *layer = (ALLEGRO_MAP_LAYER*)layers->data;
+			edit_layer(map, layer, 1 + rand() % 60);
+			check_spans(layer, "edited");
+		}
+	}
+
+	// clearing every cell leaves a layer that's skipped outright
+	ALLEGRO_MAP_LAYER *layer = al_get_map_layer(map, "dense");
+	int x, y;
+	for (y = 0; y<layer->height; y++) {
+		for (x = 0; x<layer->width; x++) {
+			al_set_single_tile_id(map, layer, x, y, 0);
+		}
+	}
+	CHECK(layer_is_empty(layer), "the cleared layer isn't empty");
+	check_spans(layer, "cleared");
+
+	al_free_map(map);
+
+	if (failures) {
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+
+	printf("All span checks passed\n");
+	return 0;
+}
@@ -0,0 +1,291 @@
+/*
+ * This addon adds Tiled map support to the Allegro game library.
+ * Copyright (c) 2012 Damien Radtke - www.damienradtke.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * For more information, visit http://www.gnu.org/copyleft
+ *
+ *                               ---
+ *
+ * Checks picking cells on staggered and hexagonal maps against the
+ * shapes Tiled draws them as.
+ *
+ * Maps staggered along either axis, shifting odd or even lines, with
+ * odd and even tile and side sizes, are probed at random pixels on and
+ * off the map. The cell al_map_pixel_to_cell and al_map_pixel_to_tile
+ * pick must be the one whose diamond or hexagon holds the pixel, worked
+ * out here by testing the pixel against the outlines of the cells
+ * around it, or either one where two outlines overlap; pixels too
+ * close to an outline to tell are skipped. The centre of every cell
+ * must pick that cell back.
+ * Run with `make check`.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include <glib/gstdio.h>
+#include "parser.h"
+
+#define WIDTH 13
+#define HEIGHT 9
+#define PROBES 4000
+
+static int failures = 0;
+
+#define CHECK(cond, ...) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__); \
+			fprintf(stderr, __VA_ARGS__); \
+			fprintf(stderr, "\n"); \
+			failures++; \
+		} \
+	} while (0)
+
+/*
+ * The outline of a cell as Tiled draws it.
+ */
+typedef struct {
+	bool stagger_x, stagger_even;
+	int tile_width, tile_height;
+	int side_offset_x, side_offset_y;
+	int column_step, row_step;      // distance between neighbouring columns and rows
+	int column_shift, row_shift;    // how far the shifted lines move
+} CELL_SHAPE;
+
+/*
+ * Loads a map from its text through a temporary file, and finishes it
+ * the way al_open_map does.
+ */
+static ALLEGRO_MAP *load_map(const char *xml)
+{
+	char *filename = NULL;
+	int fd = g_file_open_tmp("stagger_test_XXXXXX.tmx", &filename, NULL);
+	CHECK(fd != -1, "couldn't create a temporary map");
+	if (fd == -1) {
+		return NULL;
+	}
+	close(fd);
+	g_file_set_contents(filename, xml, -1, NULL);
+
+	ALLEGRO_MAP *map = parse_map_stream(filename, 1);
+	CHECK(map, "map didn't load");
+	if (map) {
+		finish_map(map);
+	}
+
+	g_remove(filename);
+	g_free(filename);
+	return map;
+}
+
+/*
+ * Works out the cells' outlines the way Tiled's hexagonal renderer
+ * does, which draws staggered maps as hexagons without sides.
+ */
+static void get_cell_shape(bool stagger_x, bool stagger_even, int tile_width, int tile_height, int side_length, CELL_SHAPE *shape)
+{
+	shape->stagger_x = stagger_x;
+	shape->stagger_even = stagger_even;
+	shape->tile_width = tile_width & ~1;
+	shape->tile_height = tile_height & ~1;
+
+	int side_length_x = stagger_x ? side_length : 0;
+	int side_length_y = stagger_x ? 0 : side_length;
+	shape->side_offset_x = (shape->tile_width - side_length_x) / 2;
+	shape->side_offset_y = (shape->tile_height - side_length_y) / 2;
+	if (stagger_x) {
+		shape->column_step = shape->side_offset_x + side_length_x;
+		shape->row_step = shape->tile_height;
+		shape->column_shift = 0;
+		shape->row_shift = shape->tile_height / 2;
+	} else {
+		shape->column_step = shape->tile_width;
+		shape->row_step = shape->side_offset_y + side_length_y;
+		shape->column_shift = shape->tile_width / 2;
+		shape->row_shift = 0;
+	}
+}
+
+/*
+ * Gets the top left corner of a cell's box.
+ */
+static void get_cell_corner(const CELL_SHAPE *shape, int x, int y, float *px, float *py)
+{
+	int shifted = ((shape->stagger_x ? x : y) & 1) != shape->stagger_even;
+	(*px) = x * shape->column_step + (shifted ? shape->column_shift : 0);
+	(*py) = y * shape->row_step + (shifted ? shape->row_shift : 0);
+}
+
+/*
+ * Measures how far inside a cell's outline a pixel is: the distance to
+ * the nearest edge, negative if the pixel's outside it.
+ */
+static double get_cell_depth(const CELL_SHAPE *shape, int x, int y, double px, double py)
+{
+	float left, top;
+	get_cell_corner(shape, x, y, &left, &top);
+
+	int w = shape->tile_width, h = shape->tile_height;
+	int ox = shape->side_offset_x, oy = shape->side_offset_y;
+	double points[8][2] = {
+		{0, h - oy}, {0, oy}, {ox, 0}, {w - ox, 0},
+		{w, oy}, {w, h - oy}, {w - ox, h}, {ox, h}
+	};
+
+	double depth = INFINITY;
+	int i;
+	for (i = 0; i<8; i++) {
+		double *a = points[i], *b = points[(i + 1) % 8];
+		double ex = b[0] - a[0], ey = b[1] - a[1];
+		double length = sqrt(ex * ex + ey * ey);
+		if (length == 0) {
+			continue;
+		}
+		// the outline runs clockwise on screen, so the inside is to the right
+		double distance = (ex * (py - top - a[1]) - ey * (px - left - a[0])) / length;
+		depth = MIN(depth, distance);
+	}
+
+	return depth;
+}
+
+/*
+ * Finds the cells whose outlines hold a pixel by testing the cells
+ * around it. Outlines only overlap, by a pixel, where the sides of a
+ * hexagon leave an odd length for its slanted edges to span.
+ * Returns how many there are, or 0 if the pixel is too close to an
+ * outline to tell.
+ */
+static int find_cells(const CELL_SHAPE *shape, double px, double py, int cells[2][2])
+{
+	int x0 = (int)floor(px / shape->column_step), y0 = (int)floor(py / shape->row_step);
+	int found = 0, x, y;
+	for (y = y0 - 2; y <= y0 + 2; y++) {
+		for (x = x0 - 2; x <= x0 + 2; x++) {
+			double depth = get_cell_depth(shape, x, y, px, py);
+			if (fabs(depth) < 0.01) {
+				return 0;
+			}
+			if (depth > 0 && found < 2) {
+				cells[found][0] = x;
+				cells[found][1] = y;
+			}
+			found += depth > 0;
+		}
+	}
+
+	CHECK(found == 1 || found == 2, "pixel %g,%g is in %d outlines", px, py, found);
+	return MIN(found, 2);
+}
+
+/*
+ * Probes one map layout.
+ */
+static void check_layout(const char *orientation, bool stagger_x, bool stagger_even, int tile_width, int tile_height,
+		int side_length, bool infinite)
+{
+	char *xml = g_strdup_printf("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+			"<map version=\"1.0\" orientation=\"%s\" width=\"%d\" height=\"%d\" tilewidth=\"%d\" tileheight=\"%d\""
+			" hexsidelength=\"%d\" staggeraxis=\"%s\" staggerindex=\"%s\" infinite=\"%d\">\n"
+			"</map>\n", orientation, WIDTH, HEIGHT, tile_width, tile_height, side_length,
+			stagger_x ? "x" : "y", stagger_even ? "even" : "odd", infinite);
+	ALLEGRO_MAP *map = load_map(xml);
+	g_free(xml);
+	if (!map) {
+		return;
+	}
+
+	char *name = g_strdup_printf("%s %dx%d side %d along %s, %s shifted%s", orientation, tile_width, tile_height,
+			side_length, stagger_x ? "x" : "y", stagger_even ? "even" : "odd", infinite ? ", infinite" : "");
+	CELL_SHAPE shape;
+	get_cell_shape(stagger_x, stagger_even, tile_width, tile_height, !strcmp(orientation, "hexagonal") ? side_length : 0, &shape);
+
+	int map_width = WIDTH * tile_width, map_height = HEIGHT * tile_height;
+	int i, checked = 0;
+	for (i = 0; i<PROBES; i++) {
+		// pixels over the map and a way past its edges, at fractional positions
+		float px = rand() % (map_width * 2) - map_width / 2 + (rand() % 256) / 256.0f;
+		float py = rand() % (map_height * 2) - map_height / 2 + (rand() % 256) / 256.0f;
+		int cells[2][2];
+		int found = find_cells(&shape, px, py, cells);
+		if (!found) {
+			continue;
+		}
+		checked++;
+
+		int x, y;
+		bool in = al_map_pixel_to_cell(map, px, py, &x, &y);
+		int k = found == 2 && x == cells[1][0] && y == cells[1][1];
+		int cx = cells[k][0], cy = cells[k][1];
+		CHECK(x == cx && y == cy, "%s: pixel %g,%g picked cell %d,%d, expected %d,%d", name, px, py, x, y, cx, cy);
+		bool expected = infinite || (cx >= 0 && cx < WIDTH && cy >= 0 && cy < HEIGHT);
+		CHECK(in == expected, "%s: cell %d,%d is %s the map", name, cx, cy, expected ? "on" : "off");
+
+		float tx, ty;
+		al_map_pixel_to_tile(map, px, py, &tx, &ty);
+		CHECK(tx == x && ty == y, "%s: pixel %g,%g is tile %g,%g, but cell %d,%d", name, px, py, tx, ty, x, y);
+	}
+	CHECK(checked > PROBES / 2, "%s: only %d of %d pixels were clear of outlines", name, checked, PROBES);
+
+	// the centre of each cell's box, and the corner the map gives for it
+	int x, y;
+	for (y = -2; y<HEIGHT + 2; y++) {
+		for (x = -2; x<WIDTH + 2; x++) {
+			float left, top, px, py;
+			get_cell_corner(&shape, x, y, &left, &top);
+			al_map_tile_to_pixel(map, x, y, &px, &py);
+			CHECK(px == left && py == top, "%s: cell %d,%d is at %g,%g, expected %g,%g", name, x, y, px, py, left, top);
+
+			int cx, cy;
+			al_map_pixel_to_cell(map, left + shape.tile_width / 2.0f, top + shape.tile_height / 2.0f, &cx, &cy);
+			CHECK(cx == x && cy == y, "%s: centre of cell %d,%d picked %d,%d", name, x, y, cx, cy);
+		}
+	}
+
+	g_free(name);
+	al_free_map(map);
+}
+
+int main(void)
+{
+	srand(22);
+
+	const char *orientations[] = {"staggered", "hexagonal"};
+	int sizes[][3] = {
+		// tile width, height and hexagon side
+		{64, 32, 0}, {32, 32, 16}, {31, 27, 9}, {28, 33, 14}, {30, 26, 7}, {16, 16, 0}
+	};
+
+	int o, s, axis, even;
+	for (o = 0; o<2; o++) {
+		for (s = 0; s<(int)(sizeof(sizes) / sizeof(sizes[0])); s++) {
+			for (axis = 0; axis<2; axis++) {
+				for (even = 0; even<2; even++) {
+					check_layout(orientations[o], axis, even, sizes[s][0], sizes[s][1], sizes[s][2], false);
+				}
+			}
+		}
+	}
+	check_layout("hexagonal", false, false, 32, 28, 12, true);
+	check_layout("staggered", true, true, 40, 20, 0, true);
+
+	if (failures) {
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+
+	printf("All stagger checks passed\n");
+	return 0;
+}